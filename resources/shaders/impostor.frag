@@ -0,0 +1,152 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec3 fragPosWorld;
+layout (location = 1) in vec2 fragFrameUv;
+layout (location = 2) flat in vec2 fragFrame;
+layout (location = 3) flat in mat3 fragAxes;
+layout (location = 6) flat in float fragFade;
+
+layout (location = 0) out vec4 outColor;
+
+struct PointLight {
+  vec4 position; // w is range
+  vec4 color; // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+  mat4 projection;
+  mat4 view;
+  mat4 invView;
+  vec4 ambientLightColor; // w is intensity
+  uvec4 clusterGrid; // xyz: clusters per axis, w: light count
+  mat4 sunTileMatrices[9]; // world -> light clip, per shadow atlas tile
+  mat4 sunDynamicMatrix; // all zero when there are no dynamic casters
+  vec4 sunTileRect; // xy: world xz of tile 0's corner, zw: tile size
+  vec4 impostorFade; // xy: hedge -> impostor fade band, zw: world xz of the grid corner
+  vec2 clusterDepth; // slice = log(view depth) * x + y
+  int sunLightIndex; // -1 for no sun shadows
+} ubo;
+
+layout(set = 0, binding = 1) readonly buffer Lights {
+  PointLight lights[];
+};
+layout(set = 0, binding = 2) readonly buffer Clusters {
+  uvec2 clusters[]; // first index, count
+};
+layout(set = 0, binding = 3) readonly buffer LightIndices {
+  uint lightIndices[];
+};
+
+layout(set = 0, binding = 4) uniform sampler2DShadow sunShadowAtlas;
+layout(set = 0, binding = 5) uniform sampler2DShadow sunDynamicShadow;
+
+// The atlas is textures[push.atlasId] (see ImpostorSystem)
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform Push {
+  vec4 color;
+  int atlasId;
+  int framesPerSide;
+} push;
+
+uint clusterIndex(vec3 posWorld) {
+  vec4 posView = ubo.view * vec4(posWorld, 1.0);
+  vec4 posClip = ubo.projection * posView;
+  vec2 ndc = posClip.xy / posClip.w;
+  vec2 grid = vec2(ubo.clusterGrid.xy);
+  uvec2 tile = uvec2(clamp((ndc * 0.5 + 0.5) * grid, vec2(0.0), grid - 1.0));
+  float slice = log(max(-posView.z, 1e-4)) * ubo.clusterDepth.x + ubo.clusterDepth.y;
+  uint z = uint(clamp(slice, 0.0, float(ubo.clusterGrid.z - 1)));
+  return (z * ubo.clusterGrid.y + tile.y) * ubo.clusterGrid.x + tile.x;
+}
+
+const float SUN_TILES_PER_SIDE = 3.0;
+
+float sampleShadow(sampler2DShadow map, mat4 lightMatrix, vec3 posWorld, vec2 tile, float scale) {
+  vec4 posClip = lightMatrix * vec4(posWorld, 1.0);
+  if (posClip.w <= 0.0) {
+    return 1.0;
+  }
+  vec3 ndc = posClip.xyz / posClip.w;
+  vec2 uv = ndc.xy * 0.5 + 0.5;
+  if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))) || ndc.z > 1.0) {
+    return 1.0;
+  }
+  return texture(map, vec3((tile + uv) * scale, ndc.z));
+}
+
+float sunShadow(vec3 posWorld) {
+  vec2 tile = clamp(
+      floor((posWorld.xz - ubo.sunTileRect.xy) / ubo.sunTileRect.zw),
+      vec2(0.0), vec2(SUN_TILES_PER_SIDE - 1.0));
+  int tileIndex = int(tile.y * SUN_TILES_PER_SIDE + tile.x);
+  float shadow = sampleShadow(
+      sunShadowAtlas, ubo.sunTileMatrices[tileIndex], posWorld, tile, 1.0 / SUN_TILES_PER_SIDE);
+  if (ubo.sunDynamicMatrix[3][3] != 0.0 || ubo.sunDynamicMatrix[2][3] != 0.0) {
+    shadow = min(shadow, sampleShadow(sunDynamicShadow, ubo.sunDynamicMatrix, posWorld, vec2(0.0), 1.0));
+  }
+  return shadow;
+}
+
+// Same pattern as simple_shader.frag; the hedge keeps the other half
+float ditherThreshold() {
+  const float BAYER[16] = float[](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+  ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+  return (BAYER[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+
+vec4 nlerp(vec4 a, vec4 b, float t) {
+    float easeFactor;
+    if (t < 0.5) {
+        return a;
+    } else {
+        t = (t - 0.5)*2;
+        easeFactor = (t == 0) ? 0 : pow(2, 10 * t - 10);
+        return a + easeFactor*(b-a);
+    }
+}
+
+void main() {
+  if (ditherThreshold() >= fragFade) {
+    discard;
+  }
+
+  // Half a texel in from the frame's edges so filtering never reads the
+  // neighbouring frame
+  float n = float(push.framesPerSide);
+  vec2 halfTexel = 0.5 / vec2(textureSize(textures[push.atlasId], 0)) * n;
+  vec2 uv = clamp(fragFrameUv, halfTexel, 1.0 - halfTexel);
+  vec4 texel = texture(textures[push.atlasId], (fragFrame + uv) / n);
+  if (texel.a < 0.5) {
+    discard;
+  }
+
+  vec3 surfaceNormal = normalize(fragAxes * (texel.rgb * 2.0 - 1.0));
+  vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+
+  // Diffuse only: the baked normals are too coarse for the hedge's highlight
+  uvec2 cluster = clusters[clusterIndex(fragPosWorld)];
+  for (uint i = 0; i < cluster.y; i++) {
+    uint lightIndex = lightIndices[cluster.x + i];
+    PointLight light = lights[lightIndex];
+    vec3 directionToLight = light.position.xyz - fragPosWorld;
+    float distanceSquared = dot(directionToLight, directionToLight);
+    float falloff = distanceSquared / (light.position.w * light.position.w);
+    float window = clamp(1.0 - falloff * falloff, 0.0, 1.0);
+    float attenuation = window * window / distanceSquared;
+    if (int(lightIndex) == ubo.sunLightIndex) {
+      attenuation *= sunShadow(fragPosWorld);
+    }
+    directionToLight = normalize(directionToLight);
+
+    float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
+    diffuseLight += light.color.xyz * light.color.w * attenuation * cosAngIncidence;
+  }
+
+  outColor = vec4(diffuseLight * push.color.rgb, 1.0);
+
+  vec3 camPos = ubo.invView[3].xyz;
+  float dist = clamp(distance(camPos, fragPosWorld) / 20.f, 0.f, 1.f);
+  outColor = nlerp(outColor, vec4(255.f, 255.f, 255.f, 255) / 255.f, dist);
+}
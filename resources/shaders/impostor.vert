@@ -0,0 +1,88 @@
+#version 450
+
+const vec2 OFFSETS[6] = vec2[](
+  vec2(-1.0, -1.0),
+  vec2(-1.0, 1.0),
+  vec2(1.0, -1.0),
+  vec2(1.0, -1.0),
+  vec2(-1.0, 1.0),
+  vec2(1.0, 1.0)
+);
+
+// ImpostorSystem::Instance, one per hedge
+layout (location = 0) in vec4 axisX; // xyz: world direction of the mesh's +x
+layout (location = 1) in vec4 axisY;
+layout (location = 2) in vec4 axisZ;
+layout (location = 3) in vec4 center; // xyz: bounding sphere centre, w: radius
+
+layout (location = 0) out vec3 fragPosWorld;
+layout (location = 1) out vec2 fragFrameUv;
+layout (location = 2) flat out vec2 fragFrame;
+layout (location = 3) flat out mat3 fragAxes;
+layout (location = 6) flat out float fragFade;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+  mat4 projection;
+  mat4 view;
+  mat4 invView;
+  vec4 ambientLightColor; // w is intensity
+  uvec4 clusterGrid; // xyz: clusters per axis, w: light count
+  mat4 sunTileMatrices[9]; // world -> light clip, per shadow atlas tile
+  mat4 sunDynamicMatrix; // all zero when there are no dynamic casters
+  vec4 sunTileRect; // xy: world xz of tile 0's corner, zw: tile size
+  vec4 impostorFade; // xy: hedge -> impostor fade band, zw: world xz of the grid corner
+  vec2 clusterDepth; // slice = log(view depth) * x + y
+  int sunLightIndex; // -1 for no sun shadows
+} ubo;
+
+layout(push_constant) uniform Push {
+  vec4 color;
+  int atlasId;
+  int framesPerSide;
+} push;
+
+// Must match mesh/impostor_atlas.cpp
+vec2 hemiOctEncode(vec3 direction) {
+  vec2 p = direction.xz / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+  return vec2(p.x + p.y, p.x - p.y);
+}
+
+vec3 hemiOctDecode(vec2 encoded) {
+  vec2 t = 0.5 * vec2(encoded.x + encoded.y, encoded.x - encoded.y);
+  return normalize(vec3(t.x, 1.0 - abs(t.x) - abs(t.y), t.y));
+}
+
+void main() {
+  mat3 axes = mat3(axisX.xyz, axisY.xyz, axisZ.xyz);
+  vec3 cameraPosWorld = ubo.invView[3].xyz;
+
+  // Direction to the camera in mesh space; views from below the horizon
+  // use the lowest frames
+  vec3 toCamera = transpose(axes) * (cameraPosWorld - center.xyz);
+  toCamera.y = max(toCamera.y, 0.0);
+  if (dot(toCamera, toCamera) < 1e-8) {
+    toCamera = vec3(0.0, 1.0, 0.0);
+  }
+  float n = float(push.framesPerSide);
+  vec2 frame = clamp(floor((hemiOctEncode(normalize(toCamera)) * 0.5 + 0.5) * n), vec2(0.0), vec2(n - 1.0));
+
+  // The quad is the plane the frame was baked on, so the frame maps onto it
+  // exactly
+  vec3 direction = hemiOctDecode((frame + 0.5) / n * 2.0 - 1.0);
+  vec3 reference = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+  vec3 right = normalize(cross(reference, direction));
+  vec3 up = cross(direction, right);
+
+  vec2 offset = OFFSETS[gl_VertexIndex];
+  fragPosWorld = center.xyz + center.w * (axes * (offset.x * right + offset.y * up));
+  fragFrameUv = vec2(0.5 + 0.5 * offset.x, 0.5 - 0.5 * offset.y);
+  fragFrame = frame;
+  fragAxes = axes;
+
+  // Same as impostorBlend in simple_shader.frag, for the hedge's cell
+  vec2 cell = floor(center.xz - ubo.impostorFade.zw) + ubo.impostorFade.zw + 0.5;
+  float dist = distance(cell, cameraPosWorld.xz);
+  fragFade = clamp((dist - ubo.impostorFade.x) / max(ubo.impostorFade.y - ubo.impostorFade.x, 1e-4), 0.0, 1.0);
+
+  gl_Position = ubo.projection * ubo.view * vec4(fragPosWorld, 1.0);
+}
@@ -1,28 +1,23 @@
 #version 450
 
 layout (location = 0) in vec2 fragOffset;
+layout (location = 1) in vec4 fragColor;
 layout (location = 0) out vec4 outColor;
 
-struct PointLight {
-  vec4 position; // ignore w
-  vec4 color; // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   mat4 invView;
   vec4 ambientLightColor; // w is intensity
-  PointLight pointLights[10];
-  int numLights;
+  uvec4 clusterGrid; // xyz: clusters per axis, w: light count
+  mat4 sunTileMatrices[9]; // world -> light clip, per shadow atlas tile
+  mat4 sunDynamicMatrix; // all zero when there are no dynamic casters
+  vec4 sunTileRect; // xy: world xz of tile 0's corner, zw: tile size
+  vec4 impostorFade; // xy: hedge -> impostor fade band, zw: world xz of the grid corner
+  vec2 clusterDepth; // slice = log(view depth) * x + y
+  int sunLightIndex; // -1 for no sun shadows
 } ubo;
 
-layout(push_constant) uniform Push {
-  vec4 position;
-  vec4 color;
-  float radius;
-} push;
-
 const float M_PI = 3.1415926538;
 
 void main() {
@@ -32,5 +27,5 @@ void main() {
   }
 
   float cosDis = 0.5 * (cos(dis * M_PI) + 1.0); // ranges from 1 -> 0
-  outColor = vec4(push.color.xyz + 0.5 * cosDis, cosDis);
+  outColor = vec4(fragColor.xyz + 0.5 * cosDis, cosDis);
 }
@@ -9,37 +9,37 @@ const vec2 OFFSETS[6] = vec2[](
   vec2(1.0, 1.0)
 );
 
-layout (location = 0) out vec2 fragOffset;
+// PointLightSystem::Billboard, one per instance
+layout (location = 0) in vec4 lightPosition; // w is radius
+layout (location = 1) in vec4 lightColor; // w is intensity
 
-struct PointLight {
-  vec4 position; // ignore w
-  vec4 color; // w is intensity
-};
+layout (location = 0) out vec2 fragOffset;
+layout (location = 1) out vec4 fragColor;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   mat4 invView;
   vec4 ambientLightColor; // w is intensity
-  PointLight pointLights[10];
-  int numLights;
+  uvec4 clusterGrid; // xyz: clusters per axis, w: light count
+  mat4 sunTileMatrices[9]; // world -> light clip, per shadow atlas tile
+  mat4 sunDynamicMatrix; // all zero when there are no dynamic casters
+  vec4 sunTileRect; // xy: world xz of tile 0's corner, zw: tile size
+  vec4 impostorFade; // xy: hedge -> impostor fade band, zw: world xz of the grid corner
+  vec2 clusterDepth; // slice = log(view depth) * x + y
+  int sunLightIndex; // -1 for no sun shadows
 } ubo;
 
-layout(push_constant) uniform Push {
-  vec4 position;
-  vec4 color;
-  float radius;
-} push;
-
 
 void main() {
   fragOffset = OFFSETS[gl_VertexIndex];
+  fragColor = lightColor;
   vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
   vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-  vec3 positionWorld = push.position.xyz
-    + push.radius * fragOffset.x * cameraRightWorld
-    + push.radius * fragOffset.y * cameraUpWorld;
+  vec3 positionWorld = lightPosition.xyz
+    + lightPosition.w * fragOffset.x * cameraRightWorld
+    + lightPosition.w * fragOffset.y * cameraUpWorld;
 
   gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
@@ -0,0 +1,5 @@
+#version 450
+
+// Depth only; the render pass has no color attachment
+void main() {
+}
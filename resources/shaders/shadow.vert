@@ -0,0 +1,13 @@
+#version 450
+
+// VKModel::CompactVertex; only the position matters for depth
+layout(location = 0) in vec4 position; // unorm16 within the mesh AABB
+
+// Light view-projection * model * dequantization (see SunShadowSystem)
+layout(push_constant) uniform Push {
+  mat4 lightModelMatrix;
+} push;
+
+void main() {
+  gl_Position = push.lightModelMatrix * vec4(position.xyz, 1.0);
+}
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout (location = 0) in vec3 fragColor;
 layout (location = 1) in vec3 fragPosWorld;
@@ -8,7 +9,7 @@ layout (location = 3) in vec2 fragUV;
 layout (location = 0) out vec4 outColor;
 
 struct PointLight {
-  vec4 position; // ignore w
+  vec4 position; // w is range
   vec4 color; // w is intensity
 };
 
@@ -17,48 +18,104 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 view;
   mat4 invView;
   vec4 ambientLightColor; // w is intensity
-  PointLight pointLights[10];
-  int numLights;
+  uvec4 clusterGrid; // xyz: clusters per axis, w: light count
+  mat4 sunTileMatrices[9]; // world -> light clip, per shadow atlas tile
+  mat4 sunDynamicMatrix; // all zero when there are no dynamic casters
+  vec4 sunTileRect; // xy: world xz of tile 0's corner, zw: tile size
+  vec4 impostorFade; // xy: hedge -> impostor fade band, zw: world xz of the grid corner
+  vec2 clusterDepth; // slice = log(view depth) * x + y
+  int sunLightIndex; // -1 for no sun shadows
 } ubo;
 
-// JANKTEX
+// Written by LightClusterSystem every frame
+layout(set = 0, binding = 1) readonly buffer Lights {
+  PointLight lights[];
+};
+layout(set = 0, binding = 2) readonly buffer Clusters {
+  uvec2 clusters[]; // first index, count
+};
+layout(set = 0, binding = 3) readonly buffer LightIndices {
+  uint lightIndices[];
+};
 
-layout(set = 0, binding = 1) uniform sampler2D texSampler0;
-layout(set = 0, binding = 2) uniform sampler2D texSampler1;
-layout(set = 0, binding = 3) uniform sampler2D texSampler2;
-layout(set = 0, binding = 4) uniform sampler2D texSampler3;
-layout(set = 0, binding = 5) uniform sampler2D texSampler4;
-// layout(set = 0, binding = 6) uniform sampler2D texSampler5;
-// layout(set = 0, binding = 7) uniform sampler2D texSampler6;
-// layout(set = 0, binding = 8) uniform sampler2D texSampler7;
+// Written by SunShadowSystem: the cached per-block atlas and this frame's
+// map for dynamic casters
+layout(set = 0, binding = 4) uniform sampler2DShadow sunShadowAtlas;
+layout(set = 0, binding = 5) uniform sampler2DShadow sunDynamicShadow;
 
+// Bindless: every texture, indexed by push.tex_id (see VKTextureRegistry)
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 layout(push_constant) uniform Push {
   mat4 modelMatrix;
-  mat4 normalMatrix;
+  vec4 normalMatrix[3];
   int tex_id;
 } push;
 
+// Set for SimpleRenderSystem's hedge pipeline only, so every other draw
+// keeps a shader without discard
+layout(constant_id = 0) const bool IMPOSTOR_FADE = false;
+
 
 vec3 read_tex_clr() {
-    if (push.tex_id == 0) {
-        return vec3(texture(texSampler0, fragUV));
-    } else if (push.tex_id == 1) {
-        return vec3(texture(texSampler1, fragUV));
-    } else if (push.tex_id == 2) {
-        return vec3(texture(texSampler2, fragUV));
-    } else if (push.tex_id == 3) {
-        return vec3(texture(texSampler3, fragUV));
-    } else if (push.tex_id == 4) {
-        return vec3(texture(texSampler4, fragUV));
-    }/* else if (push.tex_id == 5) {
-        return vec3(texture(texSampler5, fragUV));
-    } else if (push.tex_id == 6) {
-        return vec3(texture(texSampler6, fragUV));
-    } else if (push.tex_id == 7) {
-        return vec3(texture(texSampler7, fragUV));
-    }*/
-    return vec3(1.f, 1.f, 1.f);
+    // tex_id is a push constant, so it is dynamically uniform across the draw
+    return vec3(texture(textures[push.tex_id], fragUV));
+}
+
+uint clusterIndex(vec3 posWorld) {
+  vec4 posView = ubo.view * vec4(posWorld, 1.0);
+  vec4 posClip = ubo.projection * posView;
+  vec2 ndc = posClip.xy / posClip.w;
+  vec2 grid = vec2(ubo.clusterGrid.xy);
+  uvec2 tile = uvec2(clamp((ndc * 0.5 + 0.5) * grid, vec2(0.0), grid - 1.0));
+  float slice = log(max(-posView.z, 1e-4)) * ubo.clusterDepth.x + ubo.clusterDepth.y;
+  uint z = uint(clamp(slice, 0.0, float(ubo.clusterGrid.z - 1)));
+  return (z * ubo.clusterGrid.y + tile.y) * ubo.clusterGrid.x + tile.x;
+}
+
+const float SUN_TILES_PER_SIDE = 3.0;
+
+// 1 when lit; outside a map's frustum counts as lit
+float sampleShadow(sampler2DShadow map, mat4 lightMatrix, vec3 posWorld, vec2 tile, float scale) {
+  vec4 posClip = lightMatrix * vec4(posWorld, 1.0);
+  if (posClip.w <= 0.0) {
+    return 1.0;
+  }
+  vec3 ndc = posClip.xyz / posClip.w;
+  vec2 uv = ndc.xy * 0.5 + 0.5;
+  if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))) || ndc.z > 1.0) {
+    return 1.0;
+  }
+  return texture(map, vec3((tile + uv) * scale, ndc.z));
+}
+
+float sunShadow(vec3 posWorld) {
+  vec2 tile = clamp(
+      floor((posWorld.xz - ubo.sunTileRect.xy) / ubo.sunTileRect.zw),
+      vec2(0.0), vec2(SUN_TILES_PER_SIDE - 1.0));
+  int tileIndex = int(tile.y * SUN_TILES_PER_SIDE + tile.x);
+  float shadow = sampleShadow(
+      sunShadowAtlas, ubo.sunTileMatrices[tileIndex], posWorld, tile, 1.0 / SUN_TILES_PER_SIDE);
+  if (ubo.sunDynamicMatrix[3][3] != 0.0 || ubo.sunDynamicMatrix[2][3] != 0.0) {
+    shadow = min(shadow, sampleShadow(sunDynamicShadow, ubo.sunDynamicMatrix, posWorld, vec2(0.0), 1.0));
+  }
+  return shadow;
+}
+
+// Ordered dither threshold in (0, 1); impostor.frag keeps exactly the
+// pixels this discards
+float ditherThreshold() {
+  const float BAYER[16] = float[](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+  ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+  return (BAYER[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+
+// 0 inside the fade band's start, 1 past its end; measured from the centre of
+// the grid cell the fragment is in, so a whole hedge fades together
+float impostorBlend(vec3 posWorld, vec3 cameraPosWorld) {
+  vec2 cell = floor(posWorld.xz - ubo.impostorFade.zw) + ubo.impostorFade.zw + 0.5;
+  float dist = distance(cell, cameraPosWorld.xz);
+  return clamp((dist - ubo.impostorFade.x) / max(ubo.impostorFade.y - ubo.impostorFade.x, 1e-4), 0.0, 1.0);
 }
 
 vec4 nlerp(vec4 a, vec4 b, float t) {
@@ -73,6 +130,11 @@ vec4 nlerp(vec4 a, vec4 b, float t) {
 }
 
 void main() {
+  if (IMPOSTOR_FADE && ubo.impostorFade.y > 0.0 &&
+      ditherThreshold() < impostorBlend(fragPosWorld, ubo.invView[3].xyz)) {
+    discard;
+  }
+
   vec3 tex_clr = read_tex_clr();
 
   vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
@@ -82,10 +144,20 @@ void main() {
   vec3 cameraPosWorld = ubo.invView[3].xyz;
   vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-  for (int i = 0; i < ubo.numLights; i++) {
-    PointLight light = ubo.pointLights[i];
+  // Only the lights binned into this fragment's cluster
+  uvec2 cluster = clusters[clusterIndex(fragPosWorld)];
+  for (uint i = 0; i < cluster.y; i++) {
+    uint lightIndex = lightIndices[cluster.x + i];
+    PointLight light = lights[lightIndex];
     vec3 directionToLight = light.position.xyz - fragPosWorld;
-    float attenuation = 1.0 / dot(directionToLight, directionToLight); // distance squared
+    float distanceSquared = dot(directionToLight, directionToLight);
+    // fade to zero at the culling range so cluster edges don't show
+    float falloff = distanceSquared / (light.position.w * light.position.w);
+    float window = clamp(1.0 - falloff * falloff, 0.0, 1.0);
+    float attenuation = window * window / distanceSquared;
+    if (int(lightIndex) == ubo.sunLightIndex) {
+      attenuation *= sunShadow(fragPosWorld);
+    }
     directionToLight = normalize(directionToLight);
 
     float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
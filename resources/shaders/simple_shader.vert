@@ -1,39 +1,50 @@
 #version 450
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
-layout(location = 3) in vec2 uv;
+// VKModel::CompactVertex
+layout(location = 0) in vec4 position; // unorm16 within the mesh AABB
+layout(location = 1) in vec2 octNormal; // octahedral, snorm16
+layout(location = 2) in vec2 uv; // half floats
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 layout(location = 3) out vec2 fragUV;
 
-struct PointLight {
-  vec4 position; // ignore w
-  vec4 color; // w is intensity
-};
-
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projection;
   mat4 view;
   mat4 invView;
   vec4 ambientLightColor; // w is intensity
-  PointLight pointLights[10];
-  int numLights;
+  uvec4 clusterGrid; // xyz: clusters per axis, w: light count
+  mat4 sunTileMatrices[9]; // world -> light clip, per shadow atlas tile
+  mat4 sunDynamicMatrix; // all zero when there are no dynamic casters
+  vec4 sunTileRect; // xy: world xz of tile 0's corner, zw: tile size
+  vec4 impostorFade; // xy: hedge -> impostor fade band, zw: world xz of the grid corner
+  vec2 clusterDepth; // slice = log(view depth) * x + y
+  int sunLightIndex; // -1 for no sun shadows
 } ubo;
 
 layout(push_constant) uniform Push {
-  mat4 modelMatrix;
-  mat4 normalMatrix;
+  mat4 modelMatrix; // includes the AABB dequantization
+  vec4 normalMatrix[3]; // xyz: normal matrix columns, w: model color
+  int tex_id;
 } push;
 
+vec3 octDecode(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
 void main() {
-  vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+  vec4 positionWorld = push.modelMatrix * vec4(position.xyz, 1.0);
   gl_Position = ubo.projection * ubo.view * positionWorld;
-  fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+
+  mat3 normalMatrix = mat3(push.normalMatrix[0].xyz, push.normalMatrix[1].xyz, push.normalMatrix[2].xyz);
+  fragNormalWorld = normalize(normalMatrix * octDecode(octNormal));
   fragPosWorld = positionWorld.xyz;
-  fragColor = color;
+  fragColor = vec3(push.normalMatrix[0].w, push.normalMatrix[1].w, push.normalMatrix[2].w);
   fragUV = uv;
 }
@@ -0,0 +1,18 @@
+#version 450
+
+layout (location = 0) in vec2 fragUv;
+layout (location = 0) out vec4 outColor;
+
+// VKSceneTarget's color image for this frame
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+
+// UpscaleSystem's UpscalePushConstants
+layout(push_constant) uniform Push {
+  vec2 uvScale; // drawn size / image size
+  vec2 uvMax; // keeps the bilinear footprint inside the drawn region
+} push;
+
+void main() {
+  vec2 uv = min(fragUv * push.uvScale, push.uvMax);
+  outColor = vec4(texture(sceneColor, uv).rgb, 1.0);
+}
@@ -5,6 +5,8 @@
 #include "renderer/camera.h"
 #include "systems/point_light_system.hpp"
 #include "systems/simple_render_system.hpp"
+#include "systems/sun_shadow_system.hpp"
+#include "systems/transform_system.hpp"
 #include "utils/utils.h"
 
 // libs
@@ -27,7 +29,9 @@ BallTest::BallTest()
   globalPool =
       VK_DP_Mgr::Builder(m_device)
           .setMaxSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3 * VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * VKSwapChain::MAX_FRAMES_IN_FLIGHT)
           .build();
   loadGameObjects();
 }
@@ -35,27 +39,39 @@ BallTest::BallTest()
 BallTest::~BallTest() {}
 
 void BallTest::run() {
-  std::vector<std::unique_ptr<VKBufferMgr>> uboBuffers(VKSwapChain::MAX_FRAMES_IN_FLIGHT);
-  for (int i = 0; i < uboBuffers.size(); i++) {
-    uboBuffers[i] = std::make_unique<VKBufferMgr>(
-        m_device,
-        sizeof(GlobalUbo),
-        1,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    uboBuffers[i]->map();
-  }
-
   auto globalSetLayout =
       VK_DSL_Mgr::Builder(m_device)
-          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+          // Same dynamic bindings as the game; the systems bind the set
+          // with FrameInfo::globalOffsets
+          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          // sun shadows, see SunShadowSystem
+          .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
           .build();
 
+  // There is no sun here, so the maps stay cleared to lit; they only have
+  // to exist because simple_shader.frag declares them
+  SunShadowSystem sunShadowSystem{m_device, glm::vec4(-1.f, -1.f, 2.f, 2.f)};
+
   std::vector<VkDescriptorSet> globalDescriptorSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT);
   for (int i = 0; i < globalDescriptorSets.size(); i++) {
-    auto bufferInfo = uboBuffers[i]->descriptorInfo();
+    VKFrameAllocator& frameAllocator = m_renderer.frameAllocator();
+    auto bufferInfo = frameAllocator.descriptorInfo(i, sizeof(GlobalUbo));
+    auto lightInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::LIGHT_BUFFER_SIZE);
+    auto clusterInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::CLUSTER_BUFFER_SIZE);
+    auto indexInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::INDEX_BUFFER_SIZE);
+    auto shadowAtlasInfo = sunShadowSystem.staticMapInfo();
+    auto dynamicShadowInfo = sunShadowSystem.dynamicMapInfo(i);
     VKDescriptorWriter(*globalSetLayout, *globalPool)
         .writeBuffer(0, &bufferInfo)
+        .writeBuffer(1, &lightInfo)
+        .writeBuffer(2, &clusterInfo)
+        .writeBuffer(3, &indexInfo)
+        .writeImage(4, &shadowAtlasInfo)
+        .writeImage(5, &dynamicShadowInfo)
         .build(globalDescriptorSets[i]);
   }
 
@@ -70,6 +86,12 @@ void BallTest::run() {
       m_renderer.getSwapChainRenderPass(),
       globalSetLayout->getDescriptorSetLayout()
   };
+  m_device.pipelineCache().printReport();
+
+  // Only things that move every frame go through the transform system;
+  // everything else computed its matrices at load time
+  TransformSystem transformSystem{};
+  transformSystem.registerDynamic(0);
 
   // Create camera
   SceneCameraData scd{
@@ -106,6 +128,8 @@ void BallTest::run() {
         gameObjects.at(0)
     );
 
+    transformSystem.update(gameObjects);
+
     //camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
 
     if (auto commandBuffer = m_renderer.beginFrame()) {
@@ -116,7 +140,8 @@ void BallTest::run() {
           commandBuffer,
           camera,
           globalDescriptorSets[frameIndex],
-          gameObjects};
+          gameObjects,
+          m_renderer.frameAllocator()};
 
       // update
       GlobalUbo ubo{};
@@ -124,8 +149,9 @@ void BallTest::run() {
       ubo.view = camera.view_mat;
       ubo.inverseView = camera.view_mat_inv;
       pointLightSystem.update(frameInfo, ubo);
-      uboBuffers[frameIndex]->writeToBuffer(&ubo);
-      uboBuffers[frameIndex]->flush();
+      sunShadowSystem.render(frameInfo, ubo);
+      frameInfo.globalOffsets[0] =
+          frameInfo.frameAllocator.push(&ubo, sizeof(GlobalUbo)).dynamicOffset();
 
       // render
       m_renderer.beginSwapChainRenderPass(commandBuffer);
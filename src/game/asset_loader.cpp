@@ -0,0 +1,89 @@
+#include "asset_loader.hpp"
+
+#include "vulkan/vulkan-textures.hpp"
+
+// std
+#include <cstdio>
+#include <iostream>
+
+AssetLoader::AssetLoader(VKDeviceManager& device, uint32_t threadCount)
+    : m_device(device), m_start(std::chrono::steady_clock::now()), m_pool(threadCount) {}
+
+std::string AssetLoader::modelKey(const std::string& filepath, bool override_color, glm::vec3 color) {
+  if (!override_color) {
+    return filepath;
+  }
+  char suffix[64];
+  std::snprintf(suffix, sizeof(suffix), "#%g,%g,%g", color.r, color.g, color.b);
+  return filepath + suffix;
+}
+
+void AssetLoader::requestModel(const std::string& filepath, bool override_color, glm::vec3 color) {
+  std::string key = modelKey(filepath, override_color, color);
+  if (m_models.count(key)) {
+    return;
+  }
+  m_models.emplace(key, m_pool.submit([this, filepath, override_color, color] {
+    auto start = std::chrono::steady_clock::now();
+    VKModel::Builder builder = VKModel::loadBuilderFromFile(filepath, override_color, color);
+    m_decodeMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    m_modelCount++;
+    // Only known once the material file has been read
+    requestTexture(VKModel::texturePath(builder));
+    return builder;
+  }).share());
+}
+
+void AssetLoader::requestTexture(const std::string& filepath) {
+  std::lock_guard<std::mutex> lock(m_texturesMutex);
+  if (m_textures.count(filepath)) {
+    return;
+  }
+  m_textures.emplace(filepath, m_pool.submit([this, filepath] {
+    auto start = std::chrono::steady_clock::now();
+    TextureMips mips = VKTextureRegistry::decodeTexture(filepath);
+    m_decodeMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    m_textureCount++;
+    return mips;
+  }).share());
+}
+
+const VKModel::Builder& AssetLoader::getBuilder(
+    const std::string& filepath,
+    bool override_color,
+    glm::vec3 color
+) {
+  requestModel(filepath, override_color, color);
+  // get() rethrows anything the worker threw
+  return m_models.at(modelKey(filepath, override_color, color)).get();
+}
+
+std::shared_ptr<VKModel> AssetLoader::createModel(
+    const std::string& filepath,
+    bool override_color,
+    glm::vec3 color
+) {
+  const VKModel::Builder& builder = getBuilder(filepath, override_color, color);
+  getTexture(VKModel::texturePath(builder));
+  return std::make_shared<VKModel>(m_device, builder);
+}
+
+uint32_t AssetLoader::getTexture(const std::string& filepath) {
+  requestTexture(filepath);
+  std::shared_future<TextureMips> mips;
+  {
+    std::lock_guard<std::mutex> lock(m_texturesMutex);
+    mips = m_textures.at(filepath);
+  }
+  return m_device.textures().addTexture(filepath, mips.get());
+}
+
+void AssetLoader::printReport() const {
+  double wallMs = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - m_start).count();
+  std::cout << "assets: " << m_modelCount << " models and " << m_textureCount
+            << " textures on " << m_pool.getThreadCount() << " threads, "
+            << wallMs << " ms (" << m_decodeMicros / 1000.0 << " ms of decoding)" << std::endl;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "utils/thread_pool.h"
+#include "vulkan/vulkan-device.hpp"
+#include "vulkan/vulkan-model.hpp"
+#include "vulkan/vulkan-texture-cache.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Startup asset loading, split into a parallel CPU half and a serial GPU
+// half.
+//
+// requestModel queues the OBJ parse (with optimize and the LOD chain) on a
+// worker, which then queues its texture's decode on another; everything the
+// game needs is requested up front so the decodes overlap. createModel and
+// getTexture wait for their request and create the Vulkan objects on the
+// calling thread, since the texture registry, geometry pool and upload
+// manager aren't thread-safe. Those uploads all land in the upload
+// manager's current batch, which goes out in one submission with the first
+// frame.
+class AssetLoader {
+ public:
+  // 0 threads means one per hardware thread
+  explicit AssetLoader(VKDeviceManager& device, uint32_t threadCount = 0);
+  ~AssetLoader() = default;
+
+  AssetLoader(const AssetLoader &) = delete;
+  AssetLoader &operator=(const AssetLoader &) = delete;
+
+  // Requesting the same file with the same colour again is free
+  void requestModel(
+      const std::string& filepath,
+      bool override_color = false,
+      glm::vec3 color = glm::vec3(0.f, 0.f, 0.f));
+
+  // These request the model first if nobody did
+  const VKModel::Builder& getBuilder(
+      const std::string& filepath,
+      bool override_color = false,
+      glm::vec3 color = glm::vec3(0.f, 0.f, 0.f));
+  std::shared_ptr<VKModel> createModel(
+      const std::string& filepath,
+      bool override_color = false,
+      glm::vec3 color = glm::vec3(0.f, 0.f, 0.f));
+  // Registers filepath's decoded texels with the device's textures, which
+  // is where VKModel's constructor will look them up
+  uint32_t getTexture(const std::string& filepath);
+
+  // Wall time since construction against the summed decode time, i.e.
+  // roughly what loading used to take on one thread
+  void printReport() const;
+
+ private:
+  static std::string modelKey(const std::string& filepath, bool override_color, glm::vec3 color);
+  void requestTexture(const std::string& filepath);
+
+  VKDeviceManager& m_device;
+  std::chrono::steady_clock::time_point m_start;
+
+  std::unordered_map<std::string, std::shared_future<VKModel::Builder>> m_models;
+  // Workers add to it once they know their model's texture
+  std::unordered_map<std::string, std::shared_future<TextureMips>> m_textures;
+  std::mutex m_texturesMutex;
+
+  std::atomic<int64_t> m_decodeMicros{0};
+  std::atomic<uint32_t> m_modelCount{0};
+  std::atomic<uint32_t> m_textureCount{0};
+
+  // Last, so its destructor finishes the jobs before the maps go away
+  ThreadPool m_pool;
+};
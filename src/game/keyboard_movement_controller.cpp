@@ -5,7 +5,7 @@
 #include <limits>
 #include <vector>
 
-void KeyboardMovementController::moveInPlaneXZ(
+bool KeyboardMovementController::moveInPlaneXZ(
     GLFWwindow* window,
     float dt,
     LveGameObject& gameObject,
@@ -18,6 +18,7 @@ void KeyboardMovementController::moveInPlaneXZ(
         speed_multiplier = 2.f;
     }
 
+    bool moved = false;
     glm::vec3 rotate{0};
 
     if (glfwGetKey(window, keys.lookRight) == GLFW_PRESS) rotate.y += 1.f;
@@ -28,6 +29,8 @@ void KeyboardMovementController::moveInPlaneXZ(
     if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon()) {
       gameObject.transform.rotation +=
             speed_multiplier * lookSpeed * dt * glm::normalize(rotate);
+      gameObject.transform.markDirty();
+      moved = true;
     }
 
     float yaw = gameObject.transform.rotation.y;
@@ -50,9 +53,11 @@ void KeyboardMovementController::moveInPlaneXZ(
         gameObject.apply_force(speed_multiplier * moveSpeed * glm::normalize(moveDir), dt);
     }
 
-    gameObject.update_physics(dt, maze);
-
-    gameObject.transform.update_matrices();
+    if (gameObject.update_physics(dt, maze)) {
+        gameObject.transform.markDirty();
+        moved = true;
+    }
+    return moved;
 }
 
 bool KeyboardMovementController::moveCamera(
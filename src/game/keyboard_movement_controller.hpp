@@ -22,7 +22,8 @@ public:
         int rightShift = GLFW_KEY_RIGHT_SHIFT;
     };
 
-    void moveInPlaneXZ(GLFWwindow* window,
+    // Returns whether gameObject rotated or moved
+    bool moveInPlaneXZ(GLFWwindow* window,
                        float dt,
                        LveGameObject& gameObject,
                        GameMaze* maze = nullptr);
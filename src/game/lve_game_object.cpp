@@ -17,17 +17,48 @@
 //     normalMatrix = glm::inverse(glm::mat3(tform));
 // }
 
-void TransformComponent::update_matrices() {
-    glm::mat4 tform(1.f);
-    glm::mat4 scale_mat = glm::scale(scale);
-    glm::mat4 rot_x = glm::rotate(rotation.x, x_axis);
-    glm::mat4 rot_y = glm::rotate(rotation.y, y_axis);
-    glm::mat4 rot_z = glm::rotate(rotation.z, z_axis);
+// Rodrigues' formula for a rotation of angle about axis, given sin/cos of the
+// angle. Same result as glm::rotate (axis gets normalized) without building
+// and multiplying full 4x4s.
+static glm::mat3 axis_angle_mat3(const glm::vec3& axis, float s, float c) {
+    glm::vec3 k = glm::normalize(axis);
+    glm::vec3 t = (1.f - c) * k;
+    return glm::mat3(
+        c + t.x * k.x,       t.x * k.y + s * k.z, t.x * k.z - s * k.y,
+        t.y * k.x - s * k.z, c + t.y * k.y,       t.y * k.z + s * k.x,
+        t.z * k.x + s * k.y, t.z * k.y - s * k.x, c + t.z * k.z
+    );
+}
 
-    glm::mat4 trans_mat = glm::translate(translation);
+void TransformComponent::compose_matrices(const glm::vec3& sin_rot, const glm::vec3& cos_rot) {
+    // Zero angles are by far the common case (walls only spin about y, the
+    // ball only about x), so skip those rotations entirely
+    glm::mat3 rot(1.f);
+    if (rotation.z != 0.f) rot = axis_angle_mat3(z_axis, sin_rot.z, cos_rot.z);
+    if (rotation.y != 0.f) rot = rot * axis_angle_mat3(y_axis, sin_rot.y, cos_rot.y);
+    if (rotation.x != 0.f) rot = rot * axis_angle_mat3(x_axis, sin_rot.x, cos_rot.x);
+
+    mat4[0] = glm::vec4(rot[0] * scale.x, 0.f);
+    mat4[1] = glm::vec4(rot[1] * scale.y, 0.f);
+    mat4[2] = glm::vec4(rot[2] * scale.z, 0.f);
+    mat4[3] = glm::vec4(translation, 1.f);
+
+    // inverse(transpose(R * S)) == R * inverse(S) since R is orthonormal
+    if (scale.x == scale.y && scale.x == scale.z) {
+        normalMatrix = rot * (1.f / scale.x);
+    } else {
+        normalMatrix[0] = rot[0] / scale.x;
+        normalMatrix[1] = rot[1] / scale.y;
+        normalMatrix[2] = rot[2] / scale.z;
+    }
 
-    mat4 = trans_mat * rot_z * rot_y * rot_x * scale_mat;
-    normalMatrix = glm::inverse(glm::transpose(glm::mat3(mat4)));
+    dirty = false;
+}
+
+void TransformComponent::update_matrices() {
+    compose_matrices(
+        glm::vec3(std::sin(rotation.x), std::sin(rotation.y), std::sin(rotation.z)),
+        glm::vec3(std::cos(rotation.x), std::cos(rotation.y), std::cos(rotation.z)));
 }
 
 
@@ -68,7 +99,8 @@ static std::pair<bool, glm::vec3> collide(
     const glm::mat4& ctm = wall.transform.mat4;
 
     float ball_rad = ball.phys.radius;
-    glm::vec3 ball_center = ball.transform.mat4 * zero_pt;
+    // mat4 may be stale mid-frame (see TransformComponent::dirty)
+    const glm::vec3& ball_center = ball.transform.translation;
 
     glm::vec3 Bmin = ctm * glm::vec4(-radius, -radius, -radius, 1);
     glm::vec3 Bmax = ctm * glm::vec4(radius, radius, radius, 1);
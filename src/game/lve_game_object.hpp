@@ -18,13 +18,24 @@ struct TransformComponent {
   glm::vec3 y_axis{0.f, 1.f, 0.f};
   glm::vec3 z_axis{1.f, 0.f, 1.f};
 
-  // Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
-  // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
+  // Matrix corrsponds to Translate * Rz * Ry * Rx * Scale, where each rotation
+  // is about its (not necessarily unit) axis above
   // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
   glm::mat4 mat4;
   glm::mat3 normalMatrix;
 
+  // Set whenever translation/scale/rotation/axes change; the matrices above are
+  // stale until update_matrices() (or TransformSystem::update) runs
+  bool dirty = true;
+
+  void markDirty() { dirty = true; }
+
+  // Recomputes the matrices immediately. Meant for one-off/static objects;
+  // per-frame movers should markDirty() and let TransformSystem batch them.
   void update_matrices();
+
+  // Closed-form T * R * S from precomputed sin/cos of rotation.{x,y,z}
+  void compose_matrices(const glm::vec3& sin_rot, const glm::vec3& cos_rot);
 };
 
 struct PhysicalProperties {
@@ -67,6 +78,8 @@ class LveGameObject {
 
   // Optional pointer components
   std::shared_ptr<VKModel> model{};
+  // LOD drawn last frame; SimpleRenderSystem uses it for hysteresis
+  uint32_t lodLevel = 0;
   std::unique_ptr<PointLightComponent> pointLight = nullptr;
 
   bool apply_force(glm::vec3 force, float delta_time);
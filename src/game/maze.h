@@ -1,15 +1,19 @@
 #ifndef MAZE_H
 #define MAZE_H
 
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 #include <glm/glm.hpp>
 #include <random>
 
+#include "maze/mazeblock.h"
 #include "vulkan/vulkan-model.hpp"
 #include "vulkan/vulkan-device.hpp"
 #include "utils/utils.h"
+#include "asset_loader.hpp"
 #include "lve_game_object.hpp"
+#include "maze_batcher.hpp"
 
 // struct pair_hash {
 //     template <class T1, class T2>
@@ -33,6 +37,21 @@ public:
     std::vector<LveGameObject> wall_blocks;
    // std::unordered_map<std::pair<int32_t, int32_t>, LveGameObject*, pair_hash> wall_spatial_map;
     std::vector<std::vector<int32_t>> spatial_map;
+    // Objects added by exportMazeVisibleGeometry: one hedge batch and one
+    // dirt-base batch per maze block, see MazeBatcher
+    std::vector<LveGameObject::id_t> visible_ids;
+    // Grid cell (x, y) of each wall block
+    std::vector<std::pair<int32_t, int32_t>> wall_block_cells;
+    // Quarter turns of each wall's hedge, rolled once so rebuilt batches
+    // look the same
+    std::vector<int32_t> wall_rotations;
+    // Cells each exported object covers: x0, y0, x1, y1 (inclusive)
+    std::unordered_map<LveGameObject::id_t, glm::ivec4> object_regions;
+    MazeBatcher batcher;
+
+    // Maze's 3x3 grid of MazeBlocks
+    static constexpr int32_t BLOCKS_PER_SIDE = 3;
+
     GameMaze() : maze_valid(false) {}
     ~GameMaze(void) {}
 
@@ -49,12 +68,56 @@ public:
 
         return {x_int, y_int};
     }
+    // World xz rectangle covered by the cells: xy = min corner, zw = size
+    glm::vec4 getFootprint() const {
+        return {-map_half_width - 0.5f, -map_half_height - 0.5f, map_width, map_height};
+    }
+
+    // Cells of maze block (block_x, block_y): x0, y0, x1, y1 (inclusive).
+    // Maze::toBoolVector puts one undensification row/column between
+    // blocks; it goes with the block before it.
+    glm::ivec4 getBlockCells(int32_t block_x, int32_t block_y) const {
+        const int32_t width = static_cast<int32_t>(map_width);
+        const int32_t height = static_cast<int32_t>(map_height);
+        const int32_t block_width = (width + BLOCKS_PER_SIDE - 1) / BLOCKS_PER_SIDE;
+        const int32_t block_height = (height + BLOCKS_PER_SIDE - 1) / BLOCKS_PER_SIDE;
+        return {
+            block_x * block_width,
+            block_y * block_height,
+            std::min((block_x + 1) * block_width, width) - 1,
+            std::min((block_y + 1) * block_height, height) - 1};
+    }
+
+    TransformComponent hedgeTransform(size_t wall) const {
+        TransformComponent transform = wall_blocks[wall].transform;
+        transform.scale = {0.85f, -0.85f, 0.85f};
+        transform.translation.y += 0.9f;
+        transform.rotation = {0, glm::radians(90.f * wall_rotations[wall]), 0};
+        transform.update_matrices();
+        return transform;
+    }
+
+    // A litle patch of dirt below each hedge
+    TransformComponent baseTransform(size_t wall) const {
+        TransformComponent transform = wall_blocks[wall].transform;
+        transform.scale.y /= 10.f;
+        transform.translation.y += 1.f;
+        transform.update_matrices();
+        return transform;
+    }
+
+    // Starts decoding every model the maze uses; see AssetLoader
+    static void requestAssets(AssetLoader& assets) {
+        assets.requestModel("resources/models/cube.obj");
+        MazeBatcher::requestSources(assets);
+    }
+
     void generateMazeFromBoolVec(
-        VKDeviceManager& device,
+        AssetLoader& assets,
         std::vector<std::vector<bool>>& map
     ) {
         std::shared_ptr<VKModel> maze_wall_model =
-            VKModel::createModelFromFile(device, "resources/models/cube.obj");
+            assets.createModel("resources/models/cube.obj");
 
         map_height = float(map.size());
         map_width = float(map[0].size()); // Assuming all rows are the same size
@@ -76,6 +139,7 @@ public:
                     wall.transform.scale = {0.5f, 1.f, 0.5f};
                     wall.transform.update_matrices();
                     wall_blocks.emplace_back(std::move(wall));
+                    wall_block_cells.push_back({x, y});
 
                     // // Coordinates are simply "floor(coord)"
                     // std::pair<int32_t, int32_t> map_coords = {
@@ -96,60 +160,38 @@ public:
 
     void exportMazeVisibleGeometry(
         VKDeviceManager& device,
+        AssetLoader& assets,
         LveGameObject::Map& obj_map
     ) {
         // Only allowed if maze has already been generated
         if (!maze_valid) {
             throw std::runtime_error("exporteMazeVisibleGeometry called without a valid maze!");
         }
-        std::shared_ptr<VKModel> maze_wall_model =
-            VKModel::createModelFromFile(device, "resources/models/hedge2.obj", true, glm::vec3(0.3f, 0.8f, 0.2f));
-        std::shared_ptr<VKModel> maze_wall_base_model =
-            VKModel::createModelFromFile(device, "resources/models/cube.obj", true, glm::vec3(0.6f, 0.4f, 0.2f));
-
-        // std::for_each(
-        //     wall_spatial_map.begin(),
-        //     wall_spatial_map.end(),
-        //       [&obj_map, maze_wall_model](
-        //         std::pair<const std::pair<int32_t, int32_t>, LveGameObject*> p
-        //     )
-
-        std::random_device rd;
-        std::mt19937 gen(rd());
+        std::mt19937& gen = mazeRandomEngine();
         std::uniform_int_distribution<> distribution(0, 3);
+        wall_rotations.resize(wall_blocks.size());
+        for (size_t i = 0; i < wall_blocks.size(); i++) {
+            wall_rotations[i] = distribution(gen);
+        }
+
+        batcher.build(device, assets, *this, obj_map);
+        for (int32_t block_y = 0; block_y < BLOCKS_PER_SIDE; block_y++) {
+            for (int32_t block_x = 0; block_x < BLOCKS_PER_SIDE; block_x++) {
+                for (uint32_t material = 0; material < MazeBatcher::MATERIAL_COUNT; material++) {
+                    LveGameObject::id_t id = batcher.getObjectId(
+                        block_x, block_y, static_cast<MazeBatcher::Material>(material));
+                    visible_ids.push_back(id);
+                    object_regions[id] = getBlockCells(block_x, block_y);
+                }
+            }
+        }
+    }
 
-        for (const auto& wall : wall_blocks) {
-            LveGameObject&& geom_wall = LveGameObject::createGameObject();
-            geom_wall.model = maze_wall_model;
-            geom_wall.transform = wall.transform;
-
-            geom_wall.transform.scale = {0.85f, -0.85f, 0.85f};
-            geom_wall.transform.translation = {geom_wall.transform.translation.x,
-                                               geom_wall.transform.translation.y + 0.9f,
-                                               geom_wall.transform.translation.z};
-            int randomRot = distribution(gen);
-            geom_wall.transform.rotation = {0, glm::radians(90.f * randomRot), 0};
-
-            geom_wall.transform.update_matrices();
-            obj_map.emplace(geom_wall.getId(), std::move(geom_wall));
-
-            // Add a litle patch of dirt below
-            LveGameObject&& geom_base = LveGameObject::createGameObject();
-            geom_base.model = maze_wall_base_model;
-            geom_base.transform = wall.transform;
-
-            geom_base.transform.scale = {geom_base.transform.scale.x,
-                                         geom_base.transform.scale.y / 10.f,
-                                         geom_base.transform.scale.z};
-            geom_base.transform.translation = {geom_base.transform.translation.x,
-                                               geom_base.transform.translation.y + 1.f,
-                                               geom_base.transform.translation.z};
-
-            geom_base.transform.update_matrices();
-            obj_map.emplace(geom_base.getId(), std::move(geom_base));
-       }
-
-        //);
+    // Re-merges a block's batches in the background once Maze::shift's
+    // replacement has been written into wall_blocks, spatial_map and
+    // wall_rotations; MazeBatcher::poll swaps them in
+    void rebuildBlock(int32_t block_x, int32_t block_y) {
+        batcher.rebuildBlock(*this, block_x, block_y);
     }
 };
 
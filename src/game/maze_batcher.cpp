@@ -0,0 +1,156 @@
+#include "maze_batcher.hpp"
+
+#include "game/maze.h"
+
+// std
+#include <cassert>
+#include <chrono>
+#include <utility>
+
+static const glm::vec3 HEDGE_COLOR{0.3f, 0.8f, 0.2f};
+static const glm::vec3 BASE_COLOR{0.6f, 0.4f, 0.2f};
+
+static const char* HEDGE_MODEL = "resources/models/hedge2.obj";
+static const char* BASE_MODEL = "resources/models/cube.obj";
+
+void MazeBatcher::requestSources(AssetLoader& assets) {
+  assets.requestModel(HEDGE_MODEL, true, HEDGE_COLOR);
+  assets.requestModel(BASE_MODEL, true, BASE_COLOR);
+}
+
+void MazeBatcher::build(
+    VKDeviceManager& device,
+    AssetLoader& assets,
+    const GameMaze& maze,
+    LveGameObject::Map& objects
+) {
+  auto sources = std::make_shared<Batch>();
+  (*sources)[HEDGE] = assets.getBuilder(HEDGE_MODEL, true, HEDGE_COLOR);
+  (*sources)[BASE] = assets.getBuilder(BASE_MODEL, true, BASE_COLOR);
+  // The batches sample the sources' textures
+  for (const VKModel::Builder& source : *sources) {
+    assets.getTexture(VKModel::texturePath(source));
+  }
+  m_sources = std::move(sources);
+
+  const int32_t blocksPerSide = GameMaze::BLOCKS_PER_SIDE;
+  m_blocks.clear();
+  m_blocks.resize(blocksPerSide * blocksPerSide);
+  for (int32_t blockY = 0; blockY < blocksPerSide; blockY++) {
+    for (int32_t blockX = 0; blockX < blocksPerSide; blockX++) {
+      m_blocks[blockY * blocksPerSide + blockX].pending = launch(maze, blockX, blockY);
+    }
+  }
+
+  for (Block& block : m_blocks) {
+    Batch batch = block.pending.get();
+    for (uint32_t material = 0; material < MATERIAL_COUNT; material++) {
+      // The vertices are already in world space
+      LveGameObject object = LveGameObject::createGameObject();
+      object.model = createModel(device, batch[material]);
+      object.transform.update_matrices();
+      block.ids[material] = object.getId();
+      objects.emplace(object.getId(), std::move(object));
+    }
+  }
+}
+
+void MazeBatcher::rebuildBlock(const GameMaze& maze, int32_t blockX, int32_t blockY) {
+  assert(m_sources && "rebuildBlock called before build");
+  // Replacing a rebuild that is still running waits for it first
+  m_blocks[blockY * GameMaze::BLOCKS_PER_SIDE + blockX].pending = launch(maze, blockX, blockY);
+}
+
+std::vector<LveGameObject::id_t> MazeBatcher::poll(
+    VKDeviceManager& device,
+    LveGameObject::Map& objects,
+    const std::function<void(std::shared_ptr<VKModel>)>& retire
+) {
+  std::vector<LveGameObject::id_t> changed;
+  for (Block& block : m_blocks) {
+    if (!block.pending.valid() ||
+        block.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      continue;
+    }
+    Batch batch = block.pending.get();
+    for (uint32_t material = 0; material < MATERIAL_COUNT; material++) {
+      LveGameObject& object = objects.at(block.ids[material]);
+      std::shared_ptr<VKModel> previous = std::move(object.model);
+      object.model = createModel(device, batch[material]);
+      object.lodLevel = 0;
+      if (previous) {
+        retire(std::move(previous));
+      }
+      changed.push_back(block.ids[material]);
+    }
+  }
+  return changed;
+}
+
+bool MazeBatcher::isBusy() const {
+  for (const Block& block : m_blocks) {
+    if (block.pending.valid()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+LveGameObject::id_t MazeBatcher::getObjectId(int32_t blockX, int32_t blockY, Material material) const {
+  return m_blocks[blockY * GameMaze::BLOCKS_PER_SIDE + blockX].ids[material];
+}
+
+MazeBatcher::Batch MazeBatcher::merge(std::shared_ptr<const Batch> sources, std::vector<Instance> instances) {
+  Batch batch{};
+  for (uint32_t material = 0; material < MATERIAL_COUNT; material++) {
+    const VKModel::Builder& source = (*sources)[material];
+    batch[material].vertices.reserve(source.vertices.size() * instances.size());
+    batch[material].indices.reserve(source.indices.size() * instances.size());
+    for (const Instance& instance : instances) {
+      batch[material].appendTransformed(
+          source,
+          instance.transforms[material],
+          instance.normalMatrices[material]);
+    }
+  }
+  return batch;
+}
+
+std::vector<MazeBatcher::Instance> MazeBatcher::collectInstances(
+    const GameMaze& maze,
+    int32_t blockX,
+    int32_t blockY
+) const {
+  std::vector<Instance> instances;
+  const glm::ivec4 cells = maze.getBlockCells(blockX, blockY);
+  for (int32_t y = cells.y; y <= cells.w; y++) {
+    for (int32_t x = cells.x; x <= cells.z; x++) {
+      int32_t wall = maze.spatial_map[y][x];
+      if (wall < 0) continue;
+      TransformComponent hedge = maze.hedgeTransform(wall);
+      TransformComponent base = maze.baseTransform(wall);
+      Instance instance{};
+      instance.transforms[HEDGE] = hedge.mat4;
+      instance.normalMatrices[HEDGE] = hedge.normalMatrix;
+      instance.transforms[BASE] = base.mat4;
+      instance.normalMatrices[BASE] = base.normalMatrix;
+      instances.push_back(instance);
+    }
+  }
+  return instances;
+}
+
+std::future<MazeBatcher::Batch> MazeBatcher::launch(
+    const GameMaze& maze,
+    int32_t blockX,
+    int32_t blockY
+) const {
+  return std::async(std::launch::async, &MazeBatcher::merge, m_sources, collectInstances(maze, blockX, blockY));
+}
+
+std::shared_ptr<VKModel> MazeBatcher::createModel(VKDeviceManager& device, const VKModel::Builder& builder) {
+  if (builder.vertices.size() < 3) {
+    return nullptr;
+  }
+  return std::make_shared<VKModel>(device, builder);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "game/asset_loader.hpp"
+#include "game/lve_game_object.hpp"
+#include "vulkan/vulkan-device.hpp"
+#include "vulkan/vulkan-model.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+class GameMaze;
+
+// Static batches of the maze's hedges and dirt bases.
+//
+// Rather than one object (and one draw) per wall cell and material, every
+// maze block gets one merged model per material with each wall's transform,
+// random rotation included, baked into the vertices; a block draws in
+// MATERIAL_COUNT calls with an identity transform. Merging runs on worker
+// threads. Creating the models (geometry pool and texture uploads) stays on
+// the thread that calls build and poll.
+//
+// A batch is only rebuilt when its block is, i.e. after Maze::shift replaced
+// it; until the new one is swapped in the old one keeps drawing.
+class MazeBatcher {
+ public:
+  enum Material : uint32_t { HEDGE, BASE, MATERIAL_COUNT };
+
+  MazeBatcher() = default;
+  ~MazeBatcher() = default;
+
+  MazeBatcher(const MazeBatcher &) = delete;
+  MazeBatcher &operator=(const MazeBatcher &) = delete;
+
+  // Starts parsing the source meshes with the rest of the startup assets
+  static void requestSources(AssetLoader& assets);
+  // Takes the source meshes from assets, merges every block in parallel and
+  // waits, then adds one object per block and material to objects
+  void build(
+      VKDeviceManager& device,
+      AssetLoader& assets,
+      const GameMaze& maze,
+      LveGameObject::Map& objects);
+  // Starts merging block (blockX, blockY) again from the maze's current walls
+  void rebuildBlock(const GameMaze& maze, int32_t blockX, int32_t blockY);
+  // Swaps finished rebuilds into their objects and returns the ids whose
+  // model changed. Replaced models go to retire, since frames in flight may
+  // still draw them.
+  std::vector<LveGameObject::id_t> poll(
+      VKDeviceManager& device,
+      LveGameObject::Map& objects,
+      const std::function<void(std::shared_ptr<VKModel>)>& retire);
+
+  bool isBusy() const;
+  // The unbatched mesh, e.g. for ImpostorSystem's bake
+  const VKModel::Builder& getSource(Material material) const { return (*m_sources)[material]; }
+  LveGameObject::id_t getObjectId(int32_t blockX, int32_t blockY, Material material) const;
+
+ private:
+  using Batch = std::array<VKModel::Builder, MATERIAL_COUNT>;
+
+  // One wall's transform per material, copied out of the maze so the
+  // workers never look at it
+  struct Instance {
+    std::array<glm::mat4, MATERIAL_COUNT> transforms;
+    std::array<glm::mat3, MATERIAL_COUNT> normalMatrices;
+  };
+
+  struct Block {
+    std::array<LveGameObject::id_t, MATERIAL_COUNT> ids{};
+    std::future<Batch> pending;
+  };
+
+  static Batch merge(std::shared_ptr<const Batch> sources, std::vector<Instance> instances);
+
+  std::vector<Instance> collectInstances(const GameMaze& maze, int32_t blockX, int32_t blockY) const;
+  std::future<Batch> launch(const GameMaze& maze, int32_t blockX, int32_t blockY) const;
+  // Null for a block without walls; VKModel needs at least a triangle
+  static std::shared_ptr<VKModel> createModel(VKDeviceManager& device, const VKModel::Builder& builder);
+
+  // The unbatched hedge and base meshes
+  std::shared_ptr<const Batch> m_sources;
+  // Row-major over GameMaze::BLOCKS_PER_SIDE^2
+  std::vector<Block> m_blocks;
+};
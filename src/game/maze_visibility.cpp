@@ -0,0 +1,196 @@
+#include "maze_visibility.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+// World y grows downwards and the floor sits at y = 1
+static constexpr float FLOOR_Y = 1.f;
+// Rays per eye sample; at 20 cells a one-cell face still gets a few
+static constexpr uint32_t RAY_COUNT = 1024;
+// Eye samples per side of a cell, spread from edge to edge
+static constexpr uint32_t EYE_SAMPLES = 4;
+static constexpr float EYE_INSET = 0.02f;
+
+MazeVisibility::MazeVisibility(float eyeHeight, float maxDistance)
+  : m_eyeHeight(eyeHeight), m_maxDistance(maxDistance)
+{
+  m_directions.reserve(RAY_COUNT);
+  for (uint32_t i = 0; i < RAY_COUNT; i++) {
+    float angle = glm::two_pi<float>() * (i + 0.5f) / RAY_COUNT;
+    m_directions.push_back({std::cos(angle), std::sin(angle)});
+  }
+}
+
+void MazeVisibility::build(const GameMaze& maze) {
+  m_height = static_cast<int32_t>(maze.spatial_map.size());
+  m_width = m_height > 0 ? static_cast<int32_t>(maze.spatial_map[0].size()) : 0;
+  m_origin = glm::vec2(maze.getFootprint());
+  m_words = (uint32_t(m_width * m_height) + 63) / 64;
+  m_pvs.assign(size_t(m_width * m_height) * m_words, 0);
+  m_activeCell = -1;
+
+  m_walls.resize(m_width * m_height);
+  for (int32_t y = 0; y < m_height; y++) {
+    for (int32_t x = 0; x < m_width; x++) {
+      m_walls[y * m_width + x] = maze.spatial_map[y][x] >= 0;
+    }
+  }
+  m_objectRegions = maze.object_regions;
+  m_computed.assign(m_width * m_height, 0);
+}
+
+void MazeVisibility::rebuildRegion(
+    const GameMaze& maze,
+    int32_t x0,
+    int32_t y0,
+    int32_t x1,
+    int32_t y1
+) {
+  if (int32_t(maze.spatial_map.size()) != m_height ||
+      (m_height > 0 && int32_t(maze.spatial_map[0].size()) != m_width)) {
+    build(maze);
+    return;
+  }
+
+  for (int32_t y = std::max(y0, 0); y <= std::min(y1, m_height - 1); y++) {
+    for (int32_t x = std::max(x0, 0); x <= std::min(x1, m_width - 1); x++) {
+      m_walls[y * m_width + x] = maze.spatial_map[y][x] >= 0;
+    }
+  }
+  m_objectRegions = maze.object_regions;
+
+  // Only cells within sight range of the region can have changed
+  const int32_t reach = static_cast<int32_t>(std::ceil(m_maxDistance)) + 1;
+  for (int32_t y = std::max(y0 - reach, 0); y <= std::min(y1 + reach, m_height - 1); y++) {
+    for (int32_t x = std::max(x0 - reach, 0); x <= std::min(x1 + reach, m_width - 1); x++) {
+      m_computed[y * m_width + x] = 0;
+    }
+  }
+  // The active cell may be one of them
+  m_activeCell = -1;
+}
+
+void MazeVisibility::computeCell(uint32_t cell) {
+  uint64_t* row = rowOf(cell);
+  std::fill(row, row + m_words, 0);
+
+  const int32_t x = cell % m_width;
+  const int32_t y = cell / m_width;
+  if (isWall(x, y)) {
+    return;
+  }
+
+  for (uint32_t sy = 0; sy < EYE_SAMPLES; sy++) {
+    for (uint32_t sx = 0; sx < EYE_SAMPLES; sx++) {
+      glm::vec2 eye(
+          x + EYE_INSET + (1.f - 2.f * EYE_INSET) * sx / (EYE_SAMPLES - 1),
+          y + EYE_INSET + (1.f - 2.f * EYE_INSET) * sy / (EYE_SAMPLES - 1));
+      for (const glm::vec2& direction : m_directions) {
+        castRay(eye, direction, row);
+      }
+    }
+  }
+}
+
+void MazeVisibility::castRay(glm::vec2 from, glm::vec2 direction, uint64_t* row) const {
+  // Grid traversal (Amanatides & Woo); cell (x, y) spans [x, x + 1] x [y, y + 1]
+  const float inf = std::numeric_limits<float>::infinity();
+  int32_t x = static_cast<int32_t>(std::floor(from.x));
+  int32_t y = static_cast<int32_t>(std::floor(from.y));
+  const int32_t stepX = direction.x > 0.f ? 1 : -1;
+  const int32_t stepY = direction.y > 0.f ? 1 : -1;
+  const float deltaX = direction.x != 0.f ? std::abs(1.f / direction.x) : inf;
+  const float deltaY = direction.y != 0.f ? std::abs(1.f / direction.y) : inf;
+  float nextX = direction.x > 0.f ? (x + 1 - from.x) * deltaX : (from.x - x) * deltaX;
+  float nextY = direction.y > 0.f ? (y + 1 - from.y) * deltaY : (from.y - y) * deltaY;
+
+  while (true) {
+    float t;
+    if (nextX < nextY) {
+      t = nextX;
+      nextX += deltaX;
+      x += stepX;
+    } else {
+      t = nextY;
+      nextY += deltaY;
+      y += stepY;
+    }
+    if (t > m_maxDistance || x < 0 || y < 0 || x >= m_width || y >= m_height) {
+      return;
+    }
+    if (isWall(x, y)) {
+      uint32_t hit = uint32_t(y * m_width + x);
+      row[hit >> 6] |= uint64_t(1) << (hit & 63);
+      return;
+    }
+  }
+}
+
+void MazeVisibility::update(const glm::vec3& eye) {
+  m_activeCell = -1;
+  if (m_width == 0 || FLOOR_Y - eye.y > m_eyeHeight) {
+    return;
+  }
+  int32_t x = static_cast<int32_t>(std::floor(eye.x - m_origin.x));
+  int32_t y = static_cast<int32_t>(std::floor(eye.z - m_origin.y));
+  if (x < 0 || y < 0 || x >= m_width || y >= m_height || isWall(x, y)) {
+    return;
+  }
+  m_activeCell = y * m_width + x;
+  if (!m_computed[m_activeCell]) {
+    computeCell(uint32_t(m_activeCell));
+    m_computed[m_activeCell] = 1;
+  }
+}
+
+bool MazeVisibility::isVisible(LveGameObject::id_t id) const {
+  if (m_activeCell < 0) {
+    return true;
+  }
+  auto it = m_objectRegions.find(id);
+  if (it == m_objectRegions.end()) {
+    return true;
+  }
+  // Visible if any wall in the region is; a whole maze block for batches
+  const glm::ivec4& region = it->second;
+  const uint64_t* row = rowOf(uint32_t(m_activeCell));
+  for (int32_t y = region.y; y <= region.w; y++) {
+    uint32_t first = uint32_t(y * m_width + region.x);
+    uint32_t last = uint32_t(y * m_width + region.z);
+    for (uint32_t word = first >> 6; word <= last >> 6; word++) {
+      uint64_t bits = row[word];
+      if (word == first >> 6) bits &= ~uint64_t(0) << (first & 63);
+      if (word == last >> 6) bits &= ~uint64_t(0) >> (63 - (last & 63));
+      if (bits != 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool MazeVisibility::isCellVisible(int32_t x, int32_t y) const {
+  if (m_activeCell < 0 || x < 0 || y < 0 || x >= m_width || y >= m_height) {
+    return true;
+  }
+  uint32_t cell = uint32_t(y * m_width + x);
+  return (rowOf(uint32_t(m_activeCell))[cell >> 6] >> (cell & 63)) & 1;
+}
+
+uint32_t MazeVisibility::getVisibleWallCount(int32_t x, int32_t y) const {
+  if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+    return 0;
+  }
+  const uint64_t* row = rowOf(uint32_t(y * m_width + x));
+  uint32_t count = 0;
+  for (uint32_t word = 0; word < m_words; word++) {
+    count += std::popcount(row[word]);
+  }
+  return count;
+}
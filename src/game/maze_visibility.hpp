@@ -0,0 +1,80 @@
+#pragma once
+
+#include "game/lve_game_object.hpp"
+#include "game/maze.h"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Potentially visible sets for the maze grid.
+//
+// For every open cell this stores which wall cells can be seen from an eye
+// anywhere in that cell. Below the hedge tops a hedge hides everything
+// behind it, so this is a 2D problem: rays are cast through the grid in all
+// directions from sample points across the cell, and the first wall each
+// one hits is marked visible.
+//
+// It only holds while the eye is below the hedges. An eye outside the grid,
+// inside a wall or more than eyeHeight above the floor (the default chase
+// camera looks down over the hedges) gets no PVS and draws everything. So
+// nothing is cast up front: a cell's PVS is computed the first time the eye
+// stands in it, which takes about half a millisecond.
+class MazeVisibility {
+ public:
+  // Hedges reach about 1.85 above the floor
+  static constexpr float DEFAULT_EYE_HEIGHT = 1.f;
+  // Past this (in cells) the fog in simple_shader.frag has hidden everything anyway
+  static constexpr float DEFAULT_MAX_DISTANCE = 20.f;
+
+  MazeVisibility(float eyeHeight = DEFAULT_EYE_HEIGHT, float maxDistance = DEFAULT_MAX_DISTANCE);
+
+  // Takes the maze's grid; no cell's PVS is computed yet
+  void build(const GameMaze& maze);
+  // Forgets the PVS of the cells that can see cells [x0, x1] x [y0, y1],
+  // e.g. a maze block regenerated by Maze::shift
+  void rebuildRegion(const GameMaze& maze, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+
+  // Picks the PVS for this frame's eye position (world space), computing it
+  // if the eye has not been in this cell before
+  void update(const glm::vec3& eye);
+  // False only for maze objects none of whose walls are in the current PVS.
+  // Batches cover a whole maze block, so they rarely are.
+  bool isVisible(LveGameObject::id_t id) const;
+  // Whether wall cell (x, y) is in the current PVS; true while there is none
+  bool isCellVisible(int32_t x, int32_t y) const;
+
+  bool isActive() const { return m_activeCell >= 0; }
+  uint32_t getVisibleWallCount(int32_t x, int32_t y) const;
+
+ private:
+  void computeCell(uint32_t cell);
+  // Marks the first wall hit from `from` (grid units) in row
+  void castRay(glm::vec2 from, glm::vec2 direction, uint64_t* row) const;
+  bool isWall(int32_t x, int32_t y) const { return m_walls[y * m_width + x] != 0; }
+  uint64_t* rowOf(uint32_t cell) { return m_pvs.data() + size_t(cell) * m_words; }
+  const uint64_t* rowOf(uint32_t cell) const { return m_pvs.data() + size_t(cell) * m_words; }
+
+  float m_eyeHeight;
+  float m_maxDistance;
+  std::vector<glm::vec2> m_directions;
+
+  int32_t m_width = 0;
+  int32_t m_height = 0;
+  glm::vec2 m_origin{0.f};  // world xz of cell (0, 0)'s min corner
+  std::vector<uint8_t> m_walls;
+  // Per cell, one bit per cell of the grid
+  uint32_t m_words = 0;
+  std::vector<uint64_t> m_pvs;
+  // Per cell, whether its row of m_pvs is up to date
+  std::vector<uint8_t> m_computed;
+  // Cells each maze object covers, see GameMaze::object_regions
+  std::unordered_map<LveGameObject::id_t, glm::ivec4> m_objectRegions;
+
+  int32_t m_activeCell = -1;
+};
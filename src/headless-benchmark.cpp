@@ -0,0 +1,331 @@
+#include "headless-benchmark.hpp"
+
+#include "game/asset_loader.hpp"
+#include "maze/maze.h"
+#include "game/maze_visibility.hpp"
+#include "vulkan/vulkan-buffer.hpp"
+#include "renderer/camera.h"
+#include "systems/impostor_system.hpp"
+#include "systems/point_light_system.hpp"
+#include "systems/simple_render_system.hpp"
+#include "systems/sun_shadow_system.hpp"
+#include "systems/transform_system.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <QImage>
+
+// std
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// The focus point circles the middle of the maze once over the run
+static constexpr float CAMERA_PATH_RADIUS = 8.f;
+// Simulated frame time, so the path does not depend on how fast frames are
+static constexpr float FRAME_TIME = 1.f / 60.f;
+
+bool HeadlessBenchmark::Options::parse(int argc, char *argv[]) {
+  bool headless = false;
+  Options parsed;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--headless") {
+      headless = true;
+    } else if (arg == "--frames" && hasValue) {
+      parsed.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (arg == "--seed" && hasValue) {
+      parsed.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (arg == "--size" && hasValue) {
+      if (std::sscanf(argv[++i], "%ux%u", &parsed.width, &parsed.height) != 2 ||
+          parsed.width == 0 || parsed.height == 0) {
+        throw std::runtime_error(std::string("Invalid --size, expected WxH: ") + argv[i]);
+      }
+    } else if (arg == "--csv" && hasValue) {
+      parsed.csvPath = argv[++i];
+    } else if (arg == "--dump-frame" && hasValue) {
+      parsed.dumpFrames.insert(static_cast<uint32_t>(std::stoul(argv[++i])));
+    } else if (arg == "--dump-dir" && hasValue) {
+      parsed.dumpDir = argv[++i];
+    } else if (arg == "--profile" && hasValue) {
+      parsed.profileDir = argv[++i];
+    } else if (arg == "--impostor-distance" && hasValue) {
+      parsed.impostorDistance = std::stof(argv[++i]);
+    } else if (arg == "--impostor-band" && hasValue) {
+      parsed.impostorBand = std::stof(argv[++i]);
+    }
+  }
+
+  if (headless) {
+    *this = parsed;
+  }
+  return headless;
+}
+
+HeadlessBenchmark::HeadlessBenchmark(const Options& options)
+  : m_options(options),
+    m_device(),
+    m_renderer(m_device, VkExtent2D{options.width, options.height})
+{
+  globalPool =
+      VK_DP_Mgr::Builder(m_device)
+          .setMaxSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3 * VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .build();
+  loadGameObjects();
+}
+
+HeadlessBenchmark::~HeadlessBenchmark() {}
+
+void HeadlessBenchmark::run() {
+  auto globalSetLayout =
+      VK_DSL_Mgr::Builder(m_device)
+          // Bindings 0-3 live in the renderer's VKFrameAllocator and move
+          // with FrameInfo::globalOffsets
+          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+          // clustered lights, see LightClusterSystem
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          // sun shadows, see SunShadowSystem
+          .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .build();
+
+  SimpleRenderSystem simpleRenderSystem{
+      m_device,
+      m_renderer.getSwapChainRenderPass(),
+      globalSetLayout->getDescriptorSetLayout()
+  };
+
+  PointLightSystem pointLightSystem{
+      m_device,
+      m_renderer.getSwapChainRenderPass(),
+      globalSetLayout->getDescriptorSetLayout()
+  };
+
+  // Distant hedges cross-fade into baked billboards; --impostor-distance 0
+  // turns them off
+  std::unique_ptr<ImpostorSystem> impostorSystem = ImpostorSystem::create(
+      m_device,
+      m_renderer.getSwapChainRenderPass(),
+      globalSetLayout->getDescriptorSetLayout(),
+      m_maze,
+      m_options.impostorDistance,
+      m_options.impostorBand);
+
+  // The maze never changes after loading, so its tiles render once
+  SunShadowSystem sunShadowSystem{m_device, m_maze.getFootprint()};
+  sunShadowSystem.setSun(m_sun_id);
+  for (LveGameObject::id_t id : m_maze.visible_ids) {
+    sunShadowSystem.registerStaticCaster(id);
+  }
+  sunShadowSystem.registerDynamicCaster(m_ball_id);
+
+  // Per-cell hedge PVS, computed cell by cell once the camera is down among
+  // the hedges; the default camera never is, so this costs nothing up front
+  MazeVisibility mazeVisibility{};
+  mazeVisibility.build(m_maze);
+
+  std::vector<VkDescriptorSet> globalDescriptorSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (int i = 0; i < globalDescriptorSets.size(); i++) {
+    VKFrameAllocator& frameAllocator = m_renderer.frameAllocator();
+    auto bufferInfo = frameAllocator.descriptorInfo(i, sizeof(GlobalUbo));
+    auto lightInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::LIGHT_BUFFER_SIZE);
+    auto clusterInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::CLUSTER_BUFFER_SIZE);
+    auto indexInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::INDEX_BUFFER_SIZE);
+    auto shadowAtlasInfo = sunShadowSystem.staticMapInfo();
+    auto dynamicShadowInfo = sunShadowSystem.dynamicMapInfo(i);
+    VKDescriptorWriter(*globalSetLayout, *globalPool)
+        .writeBuffer(0, &bufferInfo)
+        .writeBuffer(1, &lightInfo)
+        .writeBuffer(2, &clusterInfo)
+        .writeBuffer(3, &indexInfo)
+        .writeImage(4, &shadowAtlasInfo)
+        .writeImage(5, &dynamicShadowInfo)
+        .build(globalDescriptorSets[i]);
+  }
+
+  TransformSystem transformSystem{};
+  transformSystem.registerDynamic(m_ball_id);
+
+  // Same framing as the game camera, which follows the ball
+  glm::vec4 cam_pos(1.f, -11.f, 7.f, 1.f);
+  glm::vec4 focus_at(0.f, 0.f, 0.f, 1.f);
+  SceneCameraData scd{
+      cam_pos,
+      focus_at - cam_pos,
+      glm::vec4(0.f, 1.f, 0.f, 0.f),
+      M_PI/4.f,
+      0,
+      0
+  };
+  Camera camera(CAM_PROJ_PERSP);
+  camera.initScene(scd, m_options.width, m_options.height, 0.1f, 100.f);
+
+  std::ofstream csvFile;
+  if (!m_options.csvPath.empty()) {
+    csvFile.open(m_options.csvPath);
+    if (!csvFile) {
+      throw std::runtime_error("failed to open " + m_options.csvPath);
+    }
+  }
+  std::ostream& csv = m_options.csvPath.empty() ? std::cout : csvFile;
+  csv << "frame,record_ms,submit_ms,fence_wait_ms\n";
+
+  VKProfiler& profiler = m_device.profiler();
+  profiler.setEnabled(!m_options.profileDir.empty());
+
+  auto& ball = gameObjects.at(m_ball_id);
+  for (uint32_t frame = 0; frame < m_options.frames; frame++) {
+    {
+      PROFILE_CPU_SCOPE(profiler, "transforms");
+      float t = glm::two_pi<float>() * frame / m_options.frames;
+      ball.transform.translation = {
+          CAMERA_PATH_RADIUS * std::cos(t), 0.5f, CAMERA_PATH_RADIUS * std::sin(t)};
+      ball.transform.markDirty();
+      camera.recomputeMatrices(ball.transform.translation);
+      transformSystem.update(gameObjects);
+    }
+
+    auto commandBuffer = m_renderer.beginFrame();
+    if (!commandBuffer) {
+      continue;
+    }
+    auto recordStart = std::chrono::steady_clock::now();
+
+    int frameIndex = m_renderer.getFrameIndex();
+    FrameInfo frameInfo{
+        frameIndex,
+        FRAME_TIME,
+        commandBuffer,
+        camera,
+        globalDescriptorSets[frameIndex],
+        gameObjects,
+        m_renderer.frameAllocator()};
+
+    {
+      PROFILE_CPU_SCOPE(profiler, "ubo_update");
+      GlobalUbo ubo{};
+      ubo.projection = camera.proj_mat;
+      ubo.view = camera.view_mat;
+      ubo.inverseView = camera.view_mat_inv;
+      mazeVisibility.update(glm::vec3(camera.view_mat_inv[3]));
+      pointLightSystem.update(frameInfo, ubo);
+      ubo.sunLightIndex = pointLightSystem.getLightIndex(m_sun_id);
+      if (impostorSystem) {
+        impostorSystem->update(frameInfo, ubo, &mazeVisibility);
+      }
+      {
+        // outside the swap chain render pass
+        PROFILE_GPU_SCOPE(profiler, commandBuffer, "sun_shadows");
+        sunShadowSystem.render(frameInfo, ubo);
+      }
+      frameInfo.globalOffsets[0] =
+          frameInfo.frameAllocator.push(&ubo, sizeof(GlobalUbo)).dynamicOffset();
+    }
+
+    {
+      PROFILE_CPU_SCOPE(profiler, "record");
+      m_renderer.beginSwapChainRenderPass(commandBuffer);
+      {
+        PROFILE_GPU_SCOPE(profiler, commandBuffer, "simple_render");
+        simpleRenderSystem.renderGameObjects(frameInfo, &mazeVisibility, impostorSystem.get());
+      }
+      if (impostorSystem) {
+        PROFILE_GPU_SCOPE(profiler, commandBuffer, "impostors");
+        impostorSystem->render(frameInfo);
+      }
+      {
+        PROFILE_GPU_SCOPE(profiler, commandBuffer, "point_lights");
+        pointLightSystem.render(frameInfo);
+      }
+      m_renderer.endSwapChainRenderPass(commandBuffer);
+    }
+
+    double recordMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - recordStart).count();
+    m_renderer.endFrame();
+
+    const FrameTimings& timings = m_renderer.getLastFrameTimings();
+    csv << frame << ',' << recordMs << ',' << timings.submitMs << ','
+        << timings.fenceWaitMs << '\n';
+
+    if (m_options.dumpFrames.count(frame)) {
+      dumpFrame(frame);
+    }
+  }
+  csv.flush();
+
+  vkDeviceWaitIdle(m_device.device());
+
+  if (profiler.isEnabled()) {
+    // stdout may be the CSV
+    profiler.printSummary(std::cerr);
+    profiler.exportAll(m_options.profileDir);
+  }
+}
+
+void HeadlessBenchmark::dumpFrame(uint32_t frame) {
+  std::vector<uint8_t> rgba;
+  m_renderer.readbackLastFrame(rgba);
+
+  QImage image(
+      rgba.data(),
+      static_cast<int>(m_options.width),
+      static_cast<int>(m_options.height),
+      QImage::Format_RGBA8888);
+  std::string path = m_options.dumpDir + "/frame_" + std::to_string(frame) + ".png";
+  if (!image.save(QString::fromStdString(path))) {
+    throw std::runtime_error("failed to write " + path);
+  }
+  std::cerr << "wrote " << path << std::endl;
+}
+
+void HeadlessBenchmark::loadGameObjects() {
+  AssetLoader assets{m_device};
+  assets.requestModel("resources/models/ball.obj", true);
+  assets.requestModel("resources/models/quad.obj", true, glm::vec3(1.f, 1.f, 1.f));
+  GameMaze::requestAssets(assets);
+
+  std::shared_ptr<VKModel> model = assets.createModel("resources/models/ball.obj", true);
+  auto ball = LveGameObject::createGameObject();
+  ball.model = model;
+  ball.transform.scale = {0.3f, 0.3f, 0.3f};
+  ball.transform.update_matrices();
+  m_ball_id = ball.getId();
+  gameObjects.emplace(m_ball_id, std::move(ball));
+
+  model = assets.createModel("resources/models/quad.obj", true, glm::vec3(1.f, 1.f, 1.f));
+  auto floor = LveGameObject::createGameObject();
+  floor.model = model;
+  floor.transform.translation = {0.f, 1.f, 0.f};
+  floor.transform.scale = {50.f, 1.f, 50.f};
+  floor.transform.update_matrices();
+  gameObjects.emplace(floor.getId(), std::move(floor));
+
+  seedMazeGeneration(m_options.seed);
+  Maze maze = Maze(5,5);
+  maze.generate();
+  std::vector<std::vector<bool>> map = maze.toBoolVector();
+  m_maze.generateMazeFromBoolVec(assets, map);
+  m_maze.exportMazeVisibleGeometry(m_device, assets, gameObjects);
+  assets.printReport();
+
+  // Sun
+  auto pointLight = LveGameObject::makePointLight(90.f);
+  pointLight.color = glm::vec3(.98f, .84f, .11f);
+  pointLight.transform.translation = glm::vec3(0.f, -20.f, 0.f);
+  pointLight.transform.update_matrices();
+  m_sun_id = pointLight.getId();
+  gameObjects.emplace(m_sun_id, std::move(pointLight));
+}
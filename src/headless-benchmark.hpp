@@ -0,0 +1,73 @@
+#pragma once
+
+#include "vulkan/vulkan-descriptors.hpp"
+#include "vulkan/vulkan-device.hpp"
+#include "game/lve_game_object.hpp"
+#include "vulkan/vulkan-renderer.hpp"
+#include "game/maze.h"
+#include "systems/impostor_system.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// Renders a seeded maze offscreen (no window, surface or swapchain) along a
+// fixed camera path, and writes per-frame CPU timings as CSV:
+//   frame,record_ms,submit_ms,fence_wait_ms
+//
+// Usage: hyacinth-labyrinth --headless [--frames N] [--seed S] [--size WxH]
+//                           [--csv FILE] [--dump-frame N]... [--dump-dir DIR]
+//                           [--profile DIR] [--impostor-distance D]
+//                           [--impostor-band B]
+//
+// --profile also records the VKProfiler zones and writes profile.csv and
+// profile_trace.json into DIR. --impostor-distance 0 draws every hedge as a
+// mesh.
+class HeadlessBenchmark {
+ public:
+  struct Options {
+    uint32_t frames = 600;
+    uint32_t seed = 1;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    // Empty means stdout
+    std::string csvPath;
+    std::set<uint32_t> dumpFrames;
+    std::string dumpDir = ".";
+    // Empty means the profiler stays off
+    std::string profileDir;
+    // Hedges hand over to impostors from this far out, see ImpostorSystem
+    float impostorDistance = ImpostorSystem::DEFAULT_DISTANCE;
+    float impostorBand = ImpostorSystem::DEFAULT_FADE_BAND;
+
+    // Returns false (and leaves the options alone) unless --headless is given
+    bool parse(int argc, char *argv[]);
+  };
+
+  HeadlessBenchmark(const Options& options);
+  ~HeadlessBenchmark();
+
+  HeadlessBenchmark(const HeadlessBenchmark &) = delete;
+  HeadlessBenchmark &operator=(const HeadlessBenchmark &) = delete;
+
+  void run();
+
+ private:
+  void loadGameObjects();
+  void dumpFrame(uint32_t frame);
+
+  Options m_options;
+  VKDeviceManager m_device;
+  VKRenderer m_renderer;
+  // After the device: its models free their geometry on destruction
+  GameMaze m_maze;
+  LveGameObject::id_t m_ball_id;
+  LveGameObject::id_t m_sun_id;
+
+  // note: order of declarations matters
+  std::unique_ptr<VK_DP_Mgr> globalPool{};
+  LveGameObject::Map gameObjects;
+};
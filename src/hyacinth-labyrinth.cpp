@@ -1,13 +1,20 @@
 #include "hyacinth-labyrinth.hpp"
 
+#include "game/asset_loader.hpp"
 #include "game/keyboard_movement_controller.hpp"
 #include "maze/maze.h"
 #include "game/maze.h"
+#include "game/maze_visibility.hpp"
 #include "vulkan/vulkan-buffer.hpp"
 #include "renderer/camera.h"
+#include "systems/impostor_system.hpp"
 #include "systems/point_light_system.hpp"
 #include "systems/simple_render_system.hpp"
+#include "systems/sun_shadow_system.hpp"
+#include "systems/transform_system.hpp"
+#include "systems/upscale_system.hpp"
 #include "utils/utils.h"
+#include "vulkan/vulkan-frame-pacer.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -16,30 +23,39 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <cstdlib>
+#include <iostream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifndef PROFILE_DIR
+#define PROFILE_DIR "../profile/"
+#endif
+
+// Longest the idle loop sleeps before checking the input again
+static constexpr double IDLE_WAIT_SECONDS = 0.25;
+// Cycles through the frame pacing modes at runtime
+static constexpr int PACING_KEY = GLFW_KEY_P;
+// GPU frame time budget for dynamic resolution when there is no target rate
+static constexpr float DEFAULT_GPU_BUDGET_HZ = 60.f;
 
 HyacinthLabyrinth::HyacinthLabyrinth()
   : m_window(WIDTH, HEIGHT, "Hyacinth Labrynth"),
     m_device(m_window),
     m_renderer(m_window, m_device
 ) {
-    // JANKTEX
+    // Textures live in their own bindless set owned by the device
     globalPool =
       VK_DP_Mgr::Builder(m_device)
           .setMaxSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          // .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-          // .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-
+          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3 * VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * VKSwapChain::MAX_FRAMES_IN_FLIGHT)
           .build();
     loadGameObjects();
 }
@@ -47,62 +63,22 @@ HyacinthLabyrinth::HyacinthLabyrinth()
 HyacinthLabyrinth::~HyacinthLabyrinth() {}
 
 void HyacinthLabyrinth::run() {
-  std::vector<std::unique_ptr<VKBufferMgr>> uboBuffers(VKSwapChain::MAX_FRAMES_IN_FLIGHT);
-  for (int i = 0; i < uboBuffers.size(); i++) {
-    uboBuffers[i] = std::make_unique<VKBufferMgr>(
-        m_device,
-        sizeof(GlobalUbo),
-        1,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    uboBuffers[i]->map();
-  }
-
-  // JANKTEX
   auto globalSetLayout =
       VK_DSL_Mgr::Builder(m_device)
-          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-          .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-          .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-          .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+          // Bindings 0-3 live in the renderer's VKFrameAllocator and move
+          // with FrameInfo::globalOffsets
+          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
+          // clustered lights, see LightClusterSystem
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
+          // sun shadows, see SunShadowSystem
           .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
           .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-          .addBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-          // .addBinding(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-          // .addBinding(8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
           .build();
 
   auto& ball = gameObjects.at(m_ball_id);
 
-  // HACK
-  VkDescriptorImageInfo imageInfos[m_device.cur_texture];
-  std::cout << "JANKTEX: we are using: " << m_device.cur_texture << " textures" << std::endl;
-
-  for (int32_t i = 0; i < m_device.cur_texture; i++) {
-      imageInfos[i] = VkDescriptorImageInfo{
-          m_device.textureSampler[i],
-          m_device.textureImageView[i],
-          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-      };
-  }
-
-  // JANKTEX
-  std::vector<VkDescriptorSet> globalDescriptorSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT);
-  for (int i = 0; i < globalDescriptorSets.size(); i++) {
-    auto bufferInfo = uboBuffers[i]->descriptorInfo();
-    VKDescriptorWriter(*globalSetLayout, *globalPool)
-        .writeBuffer(0, &bufferInfo)
-        .writeImage(1, &imageInfos[0])
-        .writeImage(2, &imageInfos[1])
-        .writeImage(3, &imageInfos[2])
-        .writeImage(4, &imageInfos[3])
-        .writeImage(5, &imageInfos[4])
-        .writeImage(6, &imageInfos[5])
-        // .writeImage(7, &imageInfos[6])
-        // .writeImage(8, &imageInfos[7])
-        .build(globalDescriptorSets[i]);
-  }
-
   SimpleRenderSystem simpleRenderSystem{
       m_device,
       m_renderer.getSwapChainRenderPass(),
@@ -115,6 +91,52 @@ void HyacinthLabyrinth::run() {
       globalSetLayout->getDescriptorSetLayout()
   };
 
+  // Hedges further than HL_IMPOSTOR_DISTANCE (default 8) cross-fade over
+  // HL_IMPOSTOR_BAND into baked billboards; HL_IMPOSTOR_DISTANCE=0 turns
+  // them off
+  std::unique_ptr<ImpostorSystem> impostorSystem = ImpostorSystem::createFromEnvironment(
+      m_device,
+      m_renderer.getSwapChainRenderPass(),
+      globalSetLayout->getDescriptorSetLayout(),
+      m_maze);
+
+  // The maze never changes after loading, so its tiles render once
+  SunShadowSystem sunShadowSystem{m_device, m_maze.getFootprint()};
+  sunShadowSystem.setSun(m_sun_id);
+  for (LveGameObject::id_t id : m_maze.visible_ids) {
+    sunShadowSystem.registerStaticCaster(id);
+  }
+  sunShadowSystem.registerDynamicCaster(m_ball_id);
+
+  // Per-cell hedge PVS, computed cell by cell once the camera is down among
+  // the hedges; the default camera never is, so this costs nothing up front
+  MazeVisibility mazeVisibility{};
+  mazeVisibility.build(m_maze);
+
+  std::vector<VkDescriptorSet> globalDescriptorSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT);
+  for (int i = 0; i < globalDescriptorSets.size(); i++) {
+    VKFrameAllocator& frameAllocator = m_renderer.frameAllocator();
+    auto bufferInfo = frameAllocator.descriptorInfo(i, sizeof(GlobalUbo));
+    auto lightInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::LIGHT_BUFFER_SIZE);
+    auto clusterInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::CLUSTER_BUFFER_SIZE);
+    auto indexInfo = frameAllocator.descriptorInfo(i, LightClusterSystem::INDEX_BUFFER_SIZE);
+    auto shadowAtlasInfo = sunShadowSystem.staticMapInfo();
+    auto dynamicShadowInfo = sunShadowSystem.dynamicMapInfo(i);
+    VKDescriptorWriter(*globalSetLayout, *globalPool)
+        .writeBuffer(0, &bufferInfo)
+        .writeBuffer(1, &lightInfo)
+        .writeBuffer(2, &clusterInfo)
+        .writeBuffer(3, &indexInfo)
+        .writeImage(4, &shadowAtlasInfo)
+        .writeImage(5, &dynamicShadowInfo)
+        .build(globalDescriptorSets[i]);
+  }
+
+  // Only things that move every frame go through the transform system;
+  // everything else computed its matrices at load time
+  TransformSystem transformSystem{};
+  transformSystem.registerDynamic(m_ball_id);
+
   // Create camera
 //  glm::vec4 cam_pos(-5.f, -12.f, 5.f, 1.f);
   glm::vec4 cam_pos(1.f, -11.f, 7.f, 1.f);
@@ -139,33 +161,126 @@ void HyacinthLabyrinth::run() {
   KeyboardMovementController cameraController{};
   KeyboardMovementController ballController{};
 
+  // HL_PROFILE=1 collects per-phase CPU and GPU timings for the session
+  VKProfiler& profiler = m_device.profiler();
+  profiler.setEnabled(std::getenv("HL_PROFILE") != nullptr);
+
+  // Frames are only drawn when something changed, unless HL_CONTINUOUS is
+  // set; while idle the loop sleeps in glfwWaitEventsTimeout
+  const bool continuous = std::getenv("HL_CONTINUOUS") != nullptr;
+  bool needsFrame = true;
+
+  // HL_PACING=balanced|low-latency|throughput|limited picks frames in flight
+  // and present mode; HL_TARGET_HZ caps the frame rate (implies limited)
+  VKFramePacer pacer{};
+  if (const char* hz = std::getenv("HL_TARGET_HZ")) {
+    pacer.setTargetHz(std::atof(hz));
+    pacer.setMode(PacingMode::Limited);
+  }
+  if (const char* mode = std::getenv("HL_PACING")) {
+    pacer.setMode(VKFramePacer::parseMode(mode));
+  }
+  m_renderer.setFramePacing(pacer.swapChainPacing());
+  bool pacingKeyDown = false;
+
+  // The scene is drawn at a lower resolution whenever the GPU frame time
+  // goes over budget (HL_GPU_BUDGET_MS, default one frame at the target
+  // rate) and upscaled into the swap chain; HL_DYNAMIC_RES=0 turns it off
+  std::unique_ptr<UpscaleSystem> upscaleSystem;
+  const char* dynamicRes = std::getenv("HL_DYNAMIC_RES");
+  if (dynamicRes == nullptr || std::string(dynamicRes) != "0") {
+    float budgetMs = 1000.f / DEFAULT_GPU_BUDGET_HZ;
+    if (pacer.getTargetHz() > 0.0) {
+      budgetMs = static_cast<float>(1000.0 / pacer.getTargetHz());
+    }
+    if (const char* budget = std::getenv("HL_GPU_BUDGET_MS")) {
+      budgetMs = static_cast<float>(std::atof(budget));
+    }
+    m_renderer.enableDynamicResolution(budgetMs);
+    upscaleSystem = std::make_unique<UpscaleSystem>(m_device, m_renderer.getSwapChainRenderPass());
+  }
+
+  // Every pipeline exists by now, the upscale one included
+  m_device.pipelineCache().printReport();
+
   auto currentTime = std::chrono::high_resolution_clock::now();
+  bool firstFramePresented = false;
 
   while (!m_window.shouldClose()) {
-    bool do_update = false;
-    glfwPollEvents();
+    pacer.waitForNextFrame();
+    if (pacer.waitsBeforeInput()) {
+      // Sample input as late as possible: after the frame slot is free
+      // rather than before blocking on it in beginFrame
+      m_renderer.waitForFrameSlot();
+    }
 
     auto newTime = std::chrono::high_resolution_clock::now();
     float frameTime =
         std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
     currentTime = newTime;
 
-    // TODO: Update the frame only when something changes
-    bool did_move =
-        cameraController.moveCameraNoRot(
-            m_window.getGLFWwindow(),
-            frameTime,
-            camera
-        );
+    {
+      PROFILE_CPU_SCOPE(profiler, "input");
+      glfwPollEvents();
+      pacer.markInputSampled();
+
+      bool pacingKeyPressed = glfwGetKey(m_window.getGLFWwindow(), PACING_KEY) == GLFW_PRESS;
+      if (pacingKeyPressed && !pacingKeyDown) {
+        pacer.setMode(pacer.nextMode());
+        m_renderer.setFramePacing(pacer.swapChainPacing());
+        std::cout << "Frame pacing: " << VKFramePacer::modeName(pacer.getMode()) << std::endl;
+        needsFrame = true;
+      }
+      pacingKeyDown = pacingKeyPressed;
+
+      needsFrame |=
+          cameraController.moveCameraNoRot(
+              m_window.getGLFWwindow(),
+              frameTime,
+              camera
+          );
+    }
 
     camera.recomputeMatrices(ball.transform.translation);
 
-    ballController.moveInPlaneXZ(
-        m_window.getGLFWwindow(),
-        frameTime,
-        gameObjects.at(m_ball_id),
-        &m_maze
-    );
+    {
+      PROFILE_CPU_SCOPE(profiler, "physics");
+      needsFrame |= ballController.moveInPlaneXZ(
+          m_window.getGLFWwindow(),
+          frameTime,
+          gameObjects.at(m_ball_id),
+          &m_maze
+      );
+    }
+
+    // Maze blocks rebuilt after Maze::shift swap in their new batches here
+    if (m_maze.batcher.isBusy()) {
+      auto retire = [this](std::shared_ptr<VKModel> model) { m_renderer.retire(std::move(model)); };
+      std::vector<LveGameObject::id_t> rebuilt = m_maze.batcher.poll(m_device, gameObjects, retire);
+      for (LveGameObject::id_t id : rebuilt) {
+        sunShadowSystem.unregisterCaster(id);
+        sunShadowSystem.registerStaticCaster(id);
+        needsFrame = true;
+      }
+      if (impostorSystem && !rebuilt.empty()) {
+        impostorSystem->setMaze(m_maze);
+      }
+    }
+
+    // Exposed or resized windows need a fresh image even when idle
+    needsFrame |= m_window.wasRefreshRequested() || m_window.wasWindowResized();
+    m_window.resetRefreshRequestedFlag();
+    if (!needsFrame && !continuous) {
+      // Nothing moves on its own once the ball is at rest; wake up on input
+      // or after IDLE_WAIT_SECONDS to poll the held keys again
+      glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+      pacer.markSkipped();
+      // Don't feed the time spent asleep into the physics step
+      currentTime = std::chrono::high_resolution_clock::now();
+      continue;
+    }
+    needsFrame = false;
+
     // move the lights with the ball
     gameObjects.at(m_ball_light_id).transform.translation = gameObjects.at(m_ball_id).transform.translation;
 //    for (int i=0; i<point_light_ids.size(); i++) {
@@ -176,6 +291,11 @@ void HyacinthLabyrinth::run() {
 //        gameObjects.at(point_light_ids[i]).transform.translation = glm::vec3(rotateLight * glm::vec4(gameObjects.at(m_ball_id).transform.translation,1.0f)) + glm::vec3(0.f,-2.f,0.f);
 //    }
 
+    {
+      PROFILE_CPU_SCOPE(profiler, "transforms");
+      transformSystem.update(gameObjects);
+    }
+
     if (auto commandBuffer = m_renderer.beginFrame()) {
       int frameIndex = m_renderer.getFrameIndex();
       FrameInfo frameInfo{
@@ -184,35 +304,110 @@ void HyacinthLabyrinth::run() {
           commandBuffer,
           camera,
           globalDescriptorSets[frameIndex],
-          gameObjects};
+          gameObjects,
+          m_renderer.frameAllocator()};
 
       // update
-      GlobalUbo ubo{};
-      ubo.projection = camera.proj_mat;
-      ubo.view = camera.view_mat;
-      ubo.inverseView = camera.view_mat_inv;
-      pointLightSystem.update(frameInfo, ubo);
-      uboBuffers[frameIndex]->writeToBuffer(&ubo);
-      uboBuffers[frameIndex]->flush();
+      {
+        PROFILE_CPU_SCOPE(profiler, "ubo_update");
+        GlobalUbo ubo{};
+        ubo.projection = camera.proj_mat;
+        ubo.view = camera.view_mat;
+        ubo.inverseView = camera.view_mat_inv;
+        mazeVisibility.update(glm::vec3(camera.view_mat_inv[3]));
+        pointLightSystem.update(frameInfo, ubo);
+        ubo.sunLightIndex = pointLightSystem.getLightIndex(m_sun_id);
+        if (impostorSystem) {
+          impostorSystem->update(frameInfo, ubo, &mazeVisibility);
+        }
+        {
+          // outside the swap chain render pass
+          PROFILE_GPU_SCOPE(profiler, commandBuffer, "sun_shadows");
+          sunShadowSystem.render(frameInfo, ubo);
+        }
+        frameInfo.globalOffsets[0] =
+            frameInfo.frameAllocator.push(&ubo, sizeof(GlobalUbo)).dynamicOffset();
+      }
 
       // render
-      m_renderer.beginSwapChainRenderPass(commandBuffer);
-
-      // order here matters
-      simpleRenderSystem.renderGameObjects(frameInfo);
-      pointLightSystem.render(frameInfo);
-
-      m_renderer.endSwapChainRenderPass(commandBuffer);
+      {
+        PROFILE_CPU_SCOPE(profiler, "record");
+        m_renderer.beginScenePass(commandBuffer);
+
+        // order here matters
+        {
+          PROFILE_GPU_SCOPE(profiler, commandBuffer, "simple_render");
+          simpleRenderSystem.renderGameObjects(frameInfo, &mazeVisibility, impostorSystem.get());
+        }
+        if (impostorSystem) {
+          PROFILE_GPU_SCOPE(profiler, commandBuffer, "impostors");
+          impostorSystem->render(frameInfo);
+        }
+        {
+          PROFILE_GPU_SCOPE(profiler, commandBuffer, "point_lights");
+          pointLightSystem.render(frameInfo);
+        }
+
+        m_renderer.endScenePass(commandBuffer);
+
+        if (upscaleSystem) {
+          PROFILE_GPU_SCOPE(profiler, commandBuffer, "upscale");
+          m_renderer.beginSwapChainRenderPass(commandBuffer);
+          upscaleSystem->render(
+              frameInfo,
+              m_renderer.getSceneImageInfo(),
+              m_renderer.getSceneRenderExtent(),
+              m_renderer.getSceneTargetExtent());
+          m_renderer.endSwapChainRenderPass(commandBuffer);
+        }
+      }
       m_renderer.endFrame();
+
+      if (!firstFramePresented) {
+        firstFramePresented = true;
+        std::cout << "time to first frame: " << std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - m_launchTime).count() << " ms" << std::endl;
+      }
+      pacer.markPresented();
+    } else {
+      // The swap chain was recreated; draw into the new one next time round
+      needsFrame = true;
     }
   }
 
   vkDeviceWaitIdle(m_device.device());
+
+  if (profiler.isEnabled()) {
+    profiler.printSummary();
+    profiler.exportAll(PROFILE_DIR);
+    pacer.printReport();
+    if (upscaleSystem) {
+      std::cout << "Render scale at exit: " << m_renderer.getRenderScale() << std::endl;
+    }
+  }
 }
 
 void HyacinthLabyrinth::loadGameObjects() {
-    std::shared_ptr<VKModel> model =
-        VKModel::createModelFromFile(m_device, "resources/models/ball.obj", true);
+  // Everything is requested before anything is used, so the parses and
+  // texture decodes run side by side; HL_LOAD_THREADS=1 loads serially
+  uint32_t loadThreads = 0;
+  if (const char* threads = std::getenv("HL_LOAD_THREADS")) {
+    // Anything but a plain positive number keeps 0 (one per hardware
+    // thread), and more than that is capped
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(threads, &end, 10);
+    if (threads[0] >= '0' && threads[0] <= '9' && *end == '\0' && parsed > 0) {
+      const unsigned long hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+      loadThreads = static_cast<uint32_t>(std::min(parsed, hardwareThreads));
+    }
+  }
+  AssetLoader assets{m_device, loadThreads};
+  assets.requestModel("resources/models/ball.obj", true);
+  assets.requestModel("resources/models/lsys.obj", true, glm::vec3(1.f, 0.1f, 0.1f));
+  assets.requestModel("resources/models/quad.obj", true, glm::vec3(1.f, 1.f, 1.f));
+  GameMaze::requestAssets(assets);
+
+    std::shared_ptr<VKModel> model = assets.createModel("resources/models/ball.obj", true);
     auto ball = LveGameObject::createGameObject();
     ball.model = model;
     ball.transform.translation = {-.5f, 0.5f, 0.f};
@@ -232,9 +427,7 @@ void HyacinthLabyrinth::loadGameObjects() {
     m_ball_light_id = ballLight.getId();
     gameObjects.emplace(m_ball_light_id, std::move(ballLight));
 
-  model = VKModel::createModelFromFile(m_device,
-                                        "resources/models/lsys.obj",
-                                         true, glm::vec3(1.f, 0.1f, 0.1f));
+  model = assets.createModel("resources/models/lsys.obj", true, glm::vec3(1.f, 0.1f, 0.1f));
   auto smoothVase = LveGameObject::createGameObject();
   smoothVase.model = model;
   smoothVase.transform.translation = {.5f, .5f, 0.f};
@@ -242,9 +435,7 @@ void HyacinthLabyrinth::loadGameObjects() {
   smoothVase.transform.update_matrices();
   gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
 
-  model = VKModel::createModelFromFile(m_device,
-                                       "resources/models/quad.obj",
-                                       true, glm::vec3(1.f, 1.f, 1.f));
+  model = assets.createModel("resources/models/quad.obj", true, glm::vec3(1.f, 1.f, 1.f));
   auto floor = LveGameObject::createGameObject();
   floor.model = model;
   floor.transform.translation = {0.f, 1.f, 0.f};
@@ -268,8 +459,9 @@ void HyacinthLabyrinth::loadGameObjects() {
  //     {1, 0, 0, 0, 0, 0, 0, 0, 1, 1},
  //     {1, 1, 1, 1, 1, 1, 1, 1, 1, 1}
  // };
-  m_maze.generateMazeFromBoolVec(m_device, map);
-  m_maze.exportMazeVisibleGeometry(m_device, gameObjects);
+  m_maze.generateMazeFromBoolVec(assets, map);
+  m_maze.exportMazeVisibleGeometry(m_device, assets, gameObjects);
+  assets.printReport();
 
 
  // Sun
@@ -277,5 +469,6 @@ void HyacinthLabyrinth::loadGameObjects() {
   pointLight.color = glm::vec3(.98f, .84f, .11f);
   pointLight.transform.translation = glm::vec3(0.f, -20.f, 0.f);
   pointLight.transform.update_matrices();
-  gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+  m_sun_id = pointLight.getId();
+  gameObjects.emplace(m_sun_id, std::move(pointLight));
 }
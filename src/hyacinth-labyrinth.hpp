@@ -8,6 +8,7 @@
 #include "game/maze.h"
 
 // std
+#include <chrono>
 #include <memory>
 #include <vector>
 using id_t = unsigned int;
@@ -29,12 +30,16 @@ class HyacinthLabyrinth {
   void loadGameObjects();
   void generateMazeFromBoolVec(std::vector<std::vector<bool>>& map);
   
-  GameMaze m_maze;
+  // First, so time to first frame includes creating the window and device
+  std::chrono::steady_clock::time_point m_launchTime = std::chrono::steady_clock::now();
   GlfwWindow m_window;
   VKDeviceManager m_device;
   VKRenderer m_renderer;
+  // After the device: its models free their geometry on destruction
+  GameMaze m_maze;
   id_t m_ball_id;
   id_t m_ball_light_id;
+  id_t m_sun_id;
 
   // note: order of declarations matters
   std::unique_ptr<VK_DP_Mgr> globalPool{};
@@ -1,6 +1,7 @@
 #define VULKAN_PROJ 1
 
 #if VULKAN_PROJ == 1
+#include "headless-benchmark.hpp"
 #include "hyacinth-labyrinth.hpp"
 
 #include <QApplication>
@@ -9,6 +10,19 @@
 #include <iostream>
 
 int main(int argc, char *argv[]) {
+    // --headless runs the offscreen benchmark; no window or display needed
+    try {
+        HeadlessBenchmark::Options benchmarkOptions;
+        if (benchmarkOptions.parse(argc, argv)) {
+            HeadlessBenchmark benchmark(benchmarkOptions);
+            benchmark.run();
+            return EXIT_SUCCESS;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
     QApplication a(argc, argv);
 
     QCoreApplication::setApplicationName("Hyacinth Labyrinth");
@@ -1,6 +1,16 @@
 #include "mazeblock.h"
 #include <iostream>
 
+// A fresh maze every launch unless someone seeds it (the benchmark does)
+static std::mt19937 s_mazeRandomEngine(std::random_device{}());
+
+std::mt19937& mazeRandomEngine() {
+    return s_mazeRandomEngine;
+}
+
+void seedMazeGeneration(uint32_t seed) {
+    s_mazeRandomEngine.seed(seed);
+}
 
 MazeBlock::MazeBlock()
 {
@@ -27,8 +37,7 @@ void MazeBlock::assignStringRepresentations(char wall, char path, char closed) {
 int MazeBlock::getRandomEmptyCell() {
     if (mazeCells.size() == size()) { return -1; }
     // todo move for performance?
-    static std::random_device rd;
-    static std::mt19937 gen(1); // mersenne_twister_engine seeded with rd()
+    std::mt19937& gen = mazeRandomEngine();
     std::uniform_int_distribution<> distrib(0, size()-1);
     // todo maybe don't rely on luck
     // idea: shuffle cells and iterate
@@ -64,8 +73,7 @@ void MazeBlock::performRandomWalk() {
 //    std::cout << "walk start: " << initial << std::endl;
 
     // set up random generation
-    static std::random_device rd; // a seed source for the random number engine
-    static std::mt19937 gen(1); // mersenne_twister_engine seeded with rd()
+    std::mt19937& gen = mazeRandomEngine();
     std::uniform_int_distribution<> distrib(0, directions.size() - 1);
 
     // FIRST PASS
@@ -213,8 +221,7 @@ void MazeBlock::makePathBetweenCells(Cell* first, Cell* second, Direction dir) {
 
 // randomly places closed spaces to be used for decor later
 void MazeBlock::insertClosedSpaces() {
-    static std::random_device rd; // a seed source for the random number engine
-    static std::mt19937 gen(1); // mersenne_twister_engine seeded with rd()
+    std::mt19937& gen = mazeRandomEngine();
     std::uniform_int_distribution<> distribLoc(0, cells.size()-1);
 
     // add one closed space to a random location
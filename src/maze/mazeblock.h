@@ -6,6 +6,12 @@
 #include <random>
 #include <tuple>
 
+// Every random choice made while generating a maze (and dressing it, see
+// GameMaze) comes from this engine, so the same seed gives the same maze.
+// Until seedMazeGeneration is called it is seeded from std::random_device.
+std::mt19937& mazeRandomEngine();
+void seedMazeGeneration(uint32_t seed);
+
 class MazeBlock
 {
 public:
@@ -0,0 +1,235 @@
+#include "impostor_atlas.hpp"
+
+#include "utils/file_cache.h"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace {
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t framesPerSide;
+  uint32_t frameSize;
+  uint64_t sourceHash;
+  float center[3];
+  float radius;
+  uint64_t dataSize;
+  uint64_t dataHash;
+};
+
+constexpr uint32_t MAGIC = 0x4D494C48;  // "HLIM"
+constexpr uint32_t VERSION = 1;
+
+struct ProjectedVertex {
+  float x, y;  // pixels within the frame
+  float depth;  // towards the viewer
+};
+
+void bakeFrame(
+    const std::vector<glm::vec3>& positions,
+    const std::vector<glm::vec3>& normals,
+    const std::vector<uint32_t>& indices,
+    const ImpostorAtlas& layout,
+    uint32_t frameX,
+    uint32_t frameY,
+    uint8_t* rgba
+) {
+  const uint32_t n = layout.framesPerSide;
+  const uint32_t size = layout.frameSize;
+  const uint32_t atlasSize = layout.getSize();
+
+  glm::vec2 encoded((frameX + 0.5f) / n * 2.f - 1.f, (frameY + 0.5f) / n * 2.f - 1.f);
+  glm::vec3 direction = hemiOctDecode(encoded);
+  glm::vec3 right, up;
+  impostorFrameBasis(direction, right, up);
+
+  const float scale = size / (2.f * layout.radius);
+  std::vector<ProjectedVertex> projected(positions.size());
+  for (size_t i = 0; i < positions.size(); i++) {
+    glm::vec3 q = positions[i] - layout.center;
+    projected[i] = {
+        (0.5f * size) + glm::dot(q, right) * scale,
+        (0.5f * size) - glm::dot(q, up) * scale,
+        glm::dot(q, direction)};
+  }
+
+  std::vector<float> depth(size_t(size) * size, -std::numeric_limits<float>::infinity());
+  for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+    const ProjectedVertex& a = projected[indices[t]];
+    const ProjectedVertex& b = projected[indices[t + 1]];
+    const ProjectedVertex& c = projected[indices[t + 2]];
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (std::abs(area) < 1e-8f) continue;
+
+    int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(std::min({a.x, b.x, c.x}))));
+    int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(std::min({a.y, b.y, c.y}))));
+    int32_t x1 = std::min(int32_t(size) - 1, static_cast<int32_t>(std::ceil(std::max({a.x, b.x, c.x}))));
+    int32_t y1 = std::min(int32_t(size) - 1, static_cast<int32_t>(std::ceil(std::max({a.y, b.y, c.y}))));
+
+    const glm::vec3& na = normals[indices[t]];
+    const glm::vec3& nb = normals[indices[t + 1]];
+    const glm::vec3& nc = normals[indices[t + 2]];
+    for (int32_t y = y0; y <= y1; y++) {
+      for (int32_t x = x0; x <= x1; x++) {
+        float px = x + 0.5f;
+        float py = y + 0.5f;
+        // Barycentrics, with the sign of area folded in so either winding works
+        float wa = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / area;
+        float wb = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / area;
+        float wc = 1.f - wa - wb;
+        if (wa < 0.f || wb < 0.f || wc < 0.f) continue;
+
+        float z = wa * a.depth + wb * b.depth + wc * c.depth;
+        float& stored = depth[size_t(y) * size + x];
+        if (z <= stored) continue;
+        stored = z;
+
+        glm::vec3 normal = wa * na + wb * nb + wc * nc;
+        if (glm::dot(normal, direction) < 0.f) {
+          normal = -normal;
+        }
+        normal = glm::dot(normal, normal) > 0.f ? glm::normalize(normal) : direction;
+
+        uint8_t* texel = rgba + (size_t(frameY * size + y) * atlasSize + frameX * size + x) * 4;
+        for (int i = 0; i < 3; i++) {
+          texel[i] = static_cast<uint8_t>(std::lround((normal[i] * 0.5f + 0.5f) * 255.f));
+        }
+        texel[3] = 255;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+glm::vec2 hemiOctEncode(const glm::vec3& direction) {
+  glm::vec2 p = glm::vec2(direction.x, direction.z) /
+                (std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z));
+  return {p.x + p.y, p.x - p.y};
+}
+
+glm::vec3 hemiOctDecode(const glm::vec2& encoded) {
+  glm::vec2 t = 0.5f * glm::vec2(encoded.x + encoded.y, encoded.x - encoded.y);
+  return glm::normalize(glm::vec3(t.x, 1.f - std::abs(t.x) - std::abs(t.y), t.y));
+}
+
+void impostorFrameBasis(const glm::vec3& direction, glm::vec3& right, glm::vec3& up) {
+  glm::vec3 reference = std::abs(direction.y) > 0.999f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+  right = glm::normalize(glm::cross(reference, direction));
+  up = glm::cross(direction, right);
+}
+
+ImpostorAtlas bakeImpostorAtlas(
+    const std::vector<glm::vec3>& positions,
+    const std::vector<glm::vec3>& normals,
+    const std::vector<uint32_t>& indices,
+    uint32_t framesPerSide,
+    uint32_t frameSize
+) {
+  ImpostorAtlas atlas{};
+  atlas.framesPerSide = framesPerSide;
+  atlas.frameSize = frameSize;
+
+  glm::vec3 boundsMin(std::numeric_limits<float>::max());
+  glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+  for (const glm::vec3& position : positions) {
+    boundsMin = glm::min(boundsMin, position);
+    boundsMax = glm::max(boundsMax, position);
+  }
+  atlas.center = 0.5f * (boundsMin + boundsMax);
+  for (const glm::vec3& position : positions) {
+    atlas.radius = std::max(atlas.radius, glm::length(position - atlas.center));
+  }
+  atlas.radius = std::max(atlas.radius, 1e-6f);
+  atlas.rgba.assign(size_t(atlas.getSize()) * atlas.getSize() * 4, 0);
+
+  // Frames don't overlap, so workers just pull the next one
+  const uint32_t frameCount = framesPerSide * framesPerSide;
+  std::atomic<uint32_t> next{0};
+  auto worker = [&]() {
+    for (uint32_t frame = next++; frame < frameCount; frame = next++) {
+      bakeFrame(positions, normals, indices, atlas, frame % framesPerSide, frame / framesPerSide, atlas.rgba.data());
+    }
+  };
+
+  size_t threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), frameCount);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < threadCount; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return atlas;
+}
+
+uint64_t hashImpostorSource(
+    const std::vector<glm::vec3>& positions,
+    const std::vector<glm::vec3>& normals,
+    const std::vector<uint32_t>& indices,
+    uint32_t framesPerSide,
+    uint32_t frameSize
+) {
+  uint64_t hash = hashBytes(positions.data(), positions.size() * sizeof(glm::vec3));
+  hash = hashBytes(normals.data(), normals.size() * sizeof(glm::vec3), hash);
+  hash = hashBytes(indices.data(), indices.size() * sizeof(uint32_t), hash);
+  hash = hashBytes(&framesPerSide, sizeof(framesPerSide), hash);
+  return hashBytes(&frameSize, sizeof(frameSize), hash);
+}
+
+bool loadImpostorAtlas(const std::string& path, uint64_t sourceHash, ImpostorAtlas& atlas) {
+  std::ifstream file{path, std::ios::binary};
+  if (!file.is_open()) {
+    return false;
+  }
+  FileHeader header{};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != MAGIC || header.version != VERSION || header.sourceHash != sourceHash) {
+    std::cout << "impostor cache: " << path << " is stale, baking" << std::endl;
+    return false;
+  }
+
+  std::vector<uint8_t> rgba(header.dataSize);
+  size_t expectedSize = size_t(header.framesPerSide) * header.frameSize;
+  expectedSize *= expectedSize * 4;
+  if (header.dataSize != expectedSize ||
+      !file.read(reinterpret_cast<char*>(rgba.data()), rgba.size()) ||
+      hashBytes(rgba.data(), rgba.size()) != header.dataHash) {
+    std::cout << "impostor cache: " << path << " is corrupt, baking" << std::endl;
+    return false;
+  }
+
+  atlas.framesPerSide = header.framesPerSide;
+  atlas.frameSize = header.frameSize;
+  atlas.center = glm::vec3(header.center[0], header.center[1], header.center[2]);
+  atlas.radius = header.radius;
+  atlas.rgba = std::move(rgba);
+  return true;
+}
+
+void saveImpostorAtlas(const std::string& path, uint64_t sourceHash, const ImpostorAtlas& atlas) {
+  FileHeader header{};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.framesPerSide = atlas.framesPerSide;
+  header.frameSize = atlas.frameSize;
+  header.sourceHash = sourceHash;
+  header.center[0] = atlas.center.x;
+  header.center[1] = atlas.center.y;
+  header.center[2] = atlas.center.z;
+  header.radius = atlas.radius;
+  header.dataSize = atlas.rgba.size();
+  header.dataHash = hashBytes(atlas.rgba.data(), atlas.rgba.size());
+
+  writeFileAtomically("impostor cache", path, header, {{atlas.rgba.data(), atlas.rgba.size()}});
+}
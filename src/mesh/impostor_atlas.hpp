@@ -0,0 +1,57 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Octahedral impostor of one mesh, baked on the CPU.
+//
+// The upper hemisphere of view directions (mesh +y is up) is folded onto a
+// framesPerSide x framesPerSide grid with a hemi-octahedral map. Every frame
+// is an orthographic render of the mesh seen from the direction at the
+// frame's centre, framing its bounding sphere. Texels hold the mesh-space
+// normal (xyz * 0.5 + 0.5) and coverage in alpha, so the impostor can be lit
+// like the mesh itself. impostor.vert has to pick frames the same way.
+struct ImpostorAtlas {
+  uint32_t framesPerSide = 0;
+  uint32_t frameSize = 0;
+  // Bounding sphere the frames are fitted to, in mesh space
+  glm::vec3 center{0.f};
+  float radius = 0.f;
+  // (framesPerSide * frameSize)^2 RGBA8 texels, row-major
+  std::vector<uint8_t> rgba;
+
+  uint32_t getSize() const { return framesPerSide * frameSize; }
+};
+
+// Direction in the upper hemisphere <-> [-1, 1]^2
+glm::vec2 hemiOctEncode(const glm::vec3& direction);
+glm::vec3 hemiOctDecode(const glm::vec2& encoded);
+// Image axes of the frame looking back along direction
+void impostorFrameBasis(const glm::vec3& direction, glm::vec3& right, glm::vec3& up);
+
+// Rasterizes all frames, spread over the hardware threads. normals are per
+// vertex like positions; faces count from both sides.
+ImpostorAtlas bakeImpostorAtlas(
+    const std::vector<glm::vec3>& positions,
+    const std::vector<glm::vec3>& normals,
+    const std::vector<uint32_t>& indices,
+    uint32_t framesPerSide,
+    uint32_t frameSize);
+
+// Identifies a bake: the mesh data and the atlas layout
+uint64_t hashImpostorSource(
+    const std::vector<glm::vec3>& positions,
+    const std::vector<glm::vec3>& normals,
+    const std::vector<uint32_t>& indices,
+    uint32_t framesPerSide,
+    uint32_t frameSize);
+
+// On-disk cache. load fails (and the caller bakes) for a missing, corrupt or
+// stale file, i.e. one baked from a different sourceHash.
+bool loadImpostorAtlas(const std::string& path, uint64_t sourceHash, ImpostorAtlas& atlas);
+void saveImpostorAtlas(const std::string& path, uint64_t sourceHash, const ImpostorAtlas& atlas);
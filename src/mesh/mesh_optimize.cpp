@@ -0,0 +1,255 @@
+#include "mesh_optimize.hpp"
+
+// std
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// Running ACMR below which a long run of triangles is split into its own
+// cluster for overdraw sorting (Sander et al. use roughly this value)
+constexpr float CLUSTER_SPLIT_ACMR = 0.75f;
+constexpr uint32_t MIN_CLUSTER_TRIANGLES = 128;
+
+// Vertex -> triangle lists in CSR form
+struct Adjacency {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> triangles;
+
+  Adjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+      : offsets(vertexCount + 1, 0), triangles(indices.size()) {
+    for (uint32_t index : indices) {
+      offsets[index + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+      triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+};
+
+}  // namespace
+
+VertexCacheStats analyzeVertexCache(
+    const std::vector<uint32_t>& indices,
+    size_t vertexCount,
+    uint32_t cacheSize
+) {
+  VertexCacheStats stats{};
+  if (indices.empty()) {
+    return stats;
+  }
+
+  // FIFO cache: a vertex is resident while fewer than cacheSize misses have
+  // happened since it was loaded
+  std::vector<uint64_t> loadedAt(vertexCount, 0);
+  std::vector<bool> seen(vertexCount, false);
+  uint64_t misses = 0;
+  size_t unique = 0;
+  for (uint32_t index : indices) {
+    if (!seen[index]) {
+      seen[index] = true;
+      unique++;
+    } else if (misses - loadedAt[index] < cacheSize) {
+      continue;
+    }
+    loadedAt[index] = misses++;
+  }
+
+  stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+  stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+  return stats;
+}
+
+void optimizeVertexCache(
+    std::vector<uint32_t>& indices,
+    size_t vertexCount,
+    std::vector<uint32_t>* clusters,
+    uint32_t cacheSize
+) {
+  size_t triangleCount = indices.size() / 3;
+  if (clusters) {
+    clusters->clear();
+  }
+  if (triangleCount == 0) {
+    return;
+  }
+
+  Adjacency adjacency(indices, vertexCount);
+  std::vector<uint32_t> liveTriangles(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+  }
+
+  std::vector<uint32_t> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnd;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  uint32_t time = cacheSize + 1;
+  uint32_t cursor = 0;
+  int64_t fanning = indices[0];
+
+  // Cluster bookkeeping, in triangles and cache misses since the cut
+  uint32_t clusterTriangles = 0;
+  uint32_t clusterMisses = 0;
+  auto startCluster = [&]() {
+    if (clusters) {
+      clusters->push_back(static_cast<uint32_t>(result.size() / 3));
+    }
+    clusterTriangles = 0;
+    clusterMisses = 0;
+  };
+  startCluster();
+
+  while (fanning >= 0) {
+    candidates.clear();
+
+    uint32_t f = static_cast<uint32_t>(fanning);
+    for (uint32_t a = adjacency.offsets[f]; a < adjacency.offsets[f + 1]; a++) {
+      uint32_t t = adjacency.triangles[a];
+      if (emitted[t]) continue;
+
+      for (int k = 0; k < 3; k++) {
+        uint32_t v = indices[t * 3 + k];
+        result.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        liveTriangles[v]--;
+        if (time - cacheTime[v] > cacheSize) {
+          cacheTime[v] = time++;
+          clusterMisses++;
+        }
+      }
+      emitted[t] = true;
+      clusterTriangles++;
+    }
+
+    // Prefer a cached vertex whose remaining fan still fits in the cache
+    int64_t next = -1;
+    uint32_t bestPriority = 0;
+    for (uint32_t v : candidates) {
+      if (liveTriangles[v] == 0) continue;
+      uint32_t priority = 0;
+      if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+        priority = time - cacheTime[v];
+      }
+      if (next < 0 || priority > bestPriority) {
+        next = v;
+        bestPriority = priority;
+      }
+    }
+
+    bool hardCut = false;
+    if (next < 0) {
+      // Dead end: back up through recently used vertices, then scan
+      while (!deadEnd.empty() && next < 0) {
+        uint32_t v = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveTriangles[v] > 0) next = v;
+      }
+      while (next < 0 && cursor < vertexCount) {
+        if (liveTriangles[cursor] > 0) {
+          next = cursor;
+          hardCut = true;
+        }
+        cursor++;
+      }
+    }
+
+    if (next >= 0 && clusterTriangles > 0) {
+      bool softCut = clusterTriangles >= MIN_CLUSTER_TRIANGLES &&
+                     static_cast<float>(clusterMisses) / clusterTriangles < CLUSTER_SPLIT_ACMR;
+      if (hardCut || softCut) {
+        startCluster();
+      }
+    }
+    fanning = next;
+  }
+
+  indices = std::move(result);
+}
+
+void optimizeOverdraw(
+    std::vector<uint32_t>& indices,
+    const std::vector<uint32_t>& clusters,
+    const std::vector<glm::vec3>& positions,
+    float threshold
+) {
+  uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  if (clusters.size() < 2) {
+    return;
+  }
+
+  struct Cluster {
+    uint32_t begin;
+    uint32_t end;
+    glm::dvec3 centroid{0.0};
+    glm::dvec3 normal{0.0};
+    double sortKey = 0.0;
+  };
+  std::vector<Cluster> sorted(clusters.size());
+
+  glm::dvec3 meshCentroid{0.0};
+  double meshArea = 0.0;
+  for (size_t c = 0; c < clusters.size(); c++) {
+    Cluster& cluster = sorted[c];
+    cluster.begin = clusters[c];
+    cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+    double area = 0.0;
+    for (uint32_t t = cluster.begin; t < cluster.end; t++) {
+      glm::dvec3 p0 = positions[indices[t * 3 + 0]];
+      glm::dvec3 p1 = positions[indices[t * 3 + 1]];
+      glm::dvec3 p2 = positions[indices[t * 3 + 2]];
+      glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+      double triangleArea = glm::length(n);
+      cluster.centroid += (p0 + p1 + p2) * (triangleArea / 3.0);
+      cluster.normal += n;
+      area += triangleArea;
+    }
+    meshCentroid += cluster.centroid;
+    meshArea += area;
+
+    if (area > 0.0) cluster.centroid /= area;
+    double normalLength = glm::length(cluster.normal);
+    if (normalLength > 0.0) cluster.normal /= normalLength;
+  }
+  if (meshArea > 0.0) meshCentroid /= meshArea;
+
+  // Clusters facing away from the middle of the mesh tend to occlude the rest
+  for (Cluster& cluster : sorted) {
+    cluster.sortKey = glm::dot(cluster.centroid - meshCentroid, cluster.normal);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& l, const Cluster& r) {
+    return l.sortKey > r.sortKey;
+  });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (const Cluster& cluster : sorted) {
+    result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+  }
+
+  // Cluster seams cost some cache hits; keep the cache order if too many
+  float acmr = analyzeVertexCache(indices, positions.size()).acmr;
+  if (analyzeVertexCache(result, positions.size()).acmr <= acmr * threshold) {
+    indices = std::move(result);
+  }
+}
+
+std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount) {
+  std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+  uint32_t next = 0;
+  for (uint32_t& index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+  return remap;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+// Load-time index/vertex reordering for triangle lists. The usual order is
+// optimizeVertexCache -> optimizeOverdraw -> optimizeVertexFetch, since each
+// step only permutes what the previous one produced.
+
+// Post-transform cache statistics from a FIFO simulation.
+//  - acmr: vertices transformed per triangle (0.5 is ideal, 3 is worst)
+//  - atvr: vertices transformed per unique vertex (1 is ideal)
+struct VertexCacheStats {
+  float acmr = 0.f;
+  float atvr = 0.f;
+};
+
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(
+    const std::vector<uint32_t>& indices,
+    size_t vertexCount,
+    uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander, Nehab & Barczak 2007): reorders triangles in place for
+// vertex-cache locality. If clusters is non-null it receives the first
+// triangle of every cluster, i.e. the spots where overdraw ordering may cut
+// the sequence without hurting the cache much.
+void optimizeVertexCache(
+    std::vector<uint32_t>& indices,
+    size_t vertexCount,
+    std::vector<uint32_t>* clusters = nullptr,
+    uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Sorts the clusters from optimizeVertexCache so outward-facing ones are drawn
+// first, which lets early-Z reject more of what is behind them. The new order
+// is only kept if ACMR grows by at most the given factor.
+void optimizeOverdraw(
+    std::vector<uint32_t>& indices,
+    const std::vector<uint32_t>& clusters,
+    const std::vector<glm::vec3>& positions,
+    float threshold = 1.05f);
+
+// Renumbers vertices in first-use order and rewrites indices to match.
+// Returns the old -> new remap (UINT32_MAX for unreferenced vertices) for the
+// caller to apply to its own vertex array.
+std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount);
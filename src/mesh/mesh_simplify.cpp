@@ -0,0 +1,328 @@
+#include "mesh_simplify.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+// Symmetric 4x4 error quadric, upper triangle only
+struct Quadric {
+  double a2 = 0, ab = 0, ac = 0, ad = 0;
+  double b2 = 0, bc = 0, bd = 0;
+  double c2 = 0, cd = 0;
+  double d2 = 0;
+
+  static Quadric fromPlane(const glm::dvec3& n, double d, double weight) {
+    Quadric q;
+    q.a2 = weight * n.x * n.x; q.ab = weight * n.x * n.y; q.ac = weight * n.x * n.z; q.ad = weight * n.x * d;
+    q.b2 = weight * n.y * n.y; q.bc = weight * n.y * n.z; q.bd = weight * n.y * d;
+    q.c2 = weight * n.z * n.z; q.cd = weight * n.z * d;
+    q.d2 = weight * d * d;
+    return q;
+  }
+
+  Quadric& operator+=(const Quadric& o) {
+    a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+    b2 += o.b2; bc += o.bc; bd += o.bd;
+    c2 += o.c2; cd += o.cd;
+    d2 += o.d2;
+    return *this;
+  }
+
+  // Sum of squared distances from p to the accumulated planes
+  double error(const glm::dvec3& p) const {
+    double x = p.x, y = p.y, z = p.z;
+    return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+           b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+           c2 * z * z + 2 * cd * z +
+           d2;
+  }
+};
+
+struct Collapse {
+  uint32_t from;
+  uint32_t to;
+  double cost;
+};
+
+// Boundary edges are weighted well above interior faces so outlines survive
+constexpr double BOUNDARY_WEIGHT = 10.0;
+// Reject collapses that rotate a neighbouring face by more than ~80 degrees
+constexpr double MIN_NORMAL_DOT = 0.2;
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+  if (a > b) std::swap(a, b);
+  return (uint64_t(a) << 32) | b;
+}
+
+class Simplifier {
+ public:
+  Simplifier(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+      : m_tris(indices),
+        m_triDeleted(indices.size() / 3, false),
+        m_liveTris(indices.size() / 3),
+        m_quadrics(positions.size()),
+        m_removed(positions.size(), false) {
+    // Work in a unit-sized space so errors are relative to the mesh size
+    glm::vec3 boundsMin{INFINITY}, boundsMax{-INFINITY};
+    for (const glm::vec3& p : positions) {
+      boundsMin = glm::min(boundsMin, p);
+      boundsMax = glm::max(boundsMax, p);
+    }
+    float extent = std::max({boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z});
+    double scale = extent > 0.f ? 1.0 / extent : 1.0;
+
+    m_positions.reserve(positions.size());
+    for (const glm::vec3& p : positions) {
+      m_positions.push_back(glm::dvec3(p - boundsMin) * scale);
+    }
+
+    computeQuadrics();
+  }
+
+  std::vector<uint32_t> run(size_t targetIndexCount, float maxError, float* resultError) {
+    double maxCost = double(maxError) * double(maxError);
+    double worstCost = 0.0;
+
+    while (m_liveTris * 3 > targetIndexCount) {
+      buildAdjacency();
+
+      std::vector<Collapse> candidates = collectCandidates();
+      std::sort(candidates.begin(), candidates.end(), [](const Collapse& l, const Collapse& r) {
+        return l.cost < r.cost;
+      });
+
+      // Each vertex takes part in at most one collapse per pass, which keeps
+      // the adjacency built above valid for the untouched ones
+      std::vector<bool> touched(m_positions.size(), false);
+      size_t collapsed = 0;
+      for (const Collapse& c : candidates) {
+        if (c.cost > maxCost || m_liveTris * 3 <= targetIndexCount) {
+          break;
+        }
+        if (touched[c.from] || touched[c.to] || m_removed[c.from] || m_removed[c.to]) {
+          continue;
+        }
+        if (flipsTriangle(c.from, c.to)) {
+          continue;
+        }
+        collapse(c.from, c.to);
+        touched[c.from] = touched[c.to] = true;
+        worstCost = std::max(worstCost, c.cost);
+        collapsed++;
+      }
+
+      if (collapsed == 0) {
+        break;
+      }
+    }
+
+    if (resultError) {
+      *resultError = static_cast<float>(std::sqrt(worstCost));
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(m_liveTris * 3);
+    for (size_t t = 0; t < m_triDeleted.size(); t++) {
+      if (!m_triDeleted[t]) {
+        result.insert(result.end(), m_tris.begin() + t * 3, m_tris.begin() + t * 3 + 3);
+      }
+    }
+    return result;
+  }
+
+ private:
+  glm::dvec3 faceNormal(uint32_t v0, uint32_t v1, uint32_t v2) const {
+    return glm::cross(m_positions[v1] - m_positions[v0], m_positions[v2] - m_positions[v0]);
+  }
+
+  void computeQuadrics() {
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    edgeUse.reserve(m_tris.size());
+    for (size_t i = 0; i < m_tris.size(); i += 3) {
+      for (int e = 0; e < 3; e++) {
+        edgeUse[edgeKey(m_tris[i + e], m_tris[i + (e + 1) % 3])]++;
+      }
+    }
+
+    for (size_t i = 0; i < m_tris.size(); i += 3) {
+      uint32_t v[3] = {m_tris[i], m_tris[i + 1], m_tris[i + 2]};
+      glm::dvec3 n = faceNormal(v[0], v[1], v[2]);
+      double area2 = glm::length(n);
+      if (area2 <= 0.0) {
+        continue;
+      }
+      n /= area2;
+
+      // Area-weighted face plane
+      Quadric face = Quadric::fromPlane(n, -glm::dot(n, m_positions[v[0]]), area2 * 0.5);
+      for (uint32_t vertex : v) {
+        m_quadrics[vertex] += face;
+      }
+
+      // A plane through each boundary edge, perpendicular to the face
+      for (int e = 0; e < 3; e++) {
+        uint32_t a = v[e], b = v[(e + 1) % 3];
+        if (edgeUse[edgeKey(a, b)] != 1) {
+          continue;
+        }
+        glm::dvec3 edge = m_positions[b] - m_positions[a];
+        glm::dvec3 bn = glm::cross(edge, n);
+        double len = glm::length(bn);
+        if (len <= 0.0) {
+          continue;
+        }
+        bn /= len;
+        Quadric border = Quadric::fromPlane(
+            bn, -glm::dot(bn, m_positions[a]), BOUNDARY_WEIGHT * glm::dot(edge, edge));
+        m_quadrics[a] += border;
+        m_quadrics[b] += border;
+      }
+    }
+  }
+
+  // Vertex -> live triangle lists (CSR) plus which vertices/edges are boundaries
+  void buildAdjacency() {
+    size_t vertexCount = m_positions.size();
+    m_adjOffsets.assign(vertexCount + 1, 0);
+    m_edgeUse.clear();
+    for (size_t t = 0; t < m_triDeleted.size(); t++) {
+      if (m_triDeleted[t]) continue;
+      for (int e = 0; e < 3; e++) {
+        m_adjOffsets[m_tris[t * 3 + e] + 1]++;
+        m_edgeUse[edgeKey(m_tris[t * 3 + e], m_tris[t * 3 + (e + 1) % 3])]++;
+      }
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+      m_adjOffsets[v + 1] += m_adjOffsets[v];
+    }
+
+    m_adjTris.resize(m_adjOffsets[vertexCount]);
+    std::vector<uint32_t> cursor(m_adjOffsets.begin(), m_adjOffsets.end() - 1);
+    for (size_t t = 0; t < m_triDeleted.size(); t++) {
+      if (m_triDeleted[t]) continue;
+      for (int e = 0; e < 3; e++) {
+        m_adjTris[cursor[m_tris[t * 3 + e]]++] = static_cast<uint32_t>(t);
+      }
+    }
+
+    m_boundary.assign(vertexCount, false);
+    for (const auto& [key, count] : m_edgeUse) {
+      if (count == 1) {
+        m_boundary[key >> 32] = true;
+        m_boundary[key & 0xffffffffu] = true;
+      }
+    }
+  }
+
+  bool isBoundaryEdge(uint32_t a, uint32_t b) const {
+    auto it = m_edgeUse.find(edgeKey(a, b));
+    return it != m_edgeUse.end() && it->second == 1;
+  }
+
+  // Boundary vertices may only slide along their own boundary
+  bool canCollapse(uint32_t from, uint32_t to) const {
+    if (!m_boundary[from]) {
+      return true;
+    }
+    return m_boundary[to] && isBoundaryEdge(from, to);
+  }
+
+  std::vector<Collapse> collectCandidates() const {
+    std::vector<Collapse> candidates;
+    candidates.reserve(m_liveTris * 3);
+    for (size_t t = 0; t < m_triDeleted.size(); t++) {
+      if (m_triDeleted[t]) continue;
+      for (int e = 0; e < 3; e++) {
+        uint32_t a = m_tris[t * 3 + e];
+        uint32_t b = m_tris[t * 3 + (e + 1) % 3];
+        if (a > b) std::swap(a, b);  // interior edges show up twice; harmless
+
+        Quadric q = m_quadrics[a];
+        q += m_quadrics[b];
+        double costToB = canCollapse(a, b) ? q.error(m_positions[b]) : INFINITY;
+        double costToA = canCollapse(b, a) ? q.error(m_positions[a]) : INFINITY;
+        if (costToB <= costToA && std::isfinite(costToB)) {
+          candidates.push_back({a, b, std::max(costToB, 0.0)});
+        } else if (std::isfinite(costToA)) {
+          candidates.push_back({b, a, std::max(costToA, 0.0)});
+        }
+      }
+    }
+    return candidates;
+  }
+
+  bool flipsTriangle(uint32_t from, uint32_t to) const {
+    for (uint32_t i = m_adjOffsets[from]; i < m_adjOffsets[from + 1]; i++) {
+      uint32_t t = m_adjTris[i];
+      if (m_triDeleted[t]) continue;
+      const uint32_t* v = &m_tris[t * 3];
+      if (v[0] == to || v[1] == to || v[2] == to) continue;  // collapses away
+
+      uint32_t moved[3] = {v[0], v[1], v[2]};
+      for (uint32_t& vertex : moved) {
+        if (vertex == from) vertex = to;
+      }
+      glm::dvec3 before = faceNormal(v[0], v[1], v[2]);
+      glm::dvec3 after = faceNormal(moved[0], moved[1], moved[2]);
+      double beforeLen = glm::length(before), afterLen = glm::length(after);
+      if (afterLen <= 1e-12 || beforeLen <= 1e-12) {
+        return true;
+      }
+      if (glm::dot(before, after) < MIN_NORMAL_DOT * beforeLen * afterLen) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void collapse(uint32_t from, uint32_t to) {
+    for (uint32_t i = m_adjOffsets[from]; i < m_adjOffsets[from + 1]; i++) {
+      uint32_t t = m_adjTris[i];
+      if (m_triDeleted[t]) continue;
+      uint32_t* v = &m_tris[t * 3];
+      if (v[0] == to || v[1] == to || v[2] == to) {
+        m_triDeleted[t] = true;
+        m_liveTris--;
+        continue;
+      }
+      for (int e = 0; e < 3; e++) {
+        if (v[e] == from) v[e] = to;
+      }
+    }
+    m_quadrics[to] += m_quadrics[from];
+    m_removed[from] = true;
+  }
+
+  std::vector<glm::dvec3> m_positions;
+  std::vector<uint32_t> m_tris;
+  std::vector<bool> m_triDeleted;
+  size_t m_liveTris;
+
+  std::vector<Quadric> m_quadrics;
+  std::vector<bool> m_removed;
+
+  std::vector<uint32_t> m_adjOffsets;
+  std::vector<uint32_t> m_adjTris;
+  std::unordered_map<uint64_t, uint32_t> m_edgeUse;
+  std::vector<bool> m_boundary;
+};
+
+}  // namespace
+
+std::vector<uint32_t> simplifyMesh(
+    const std::vector<glm::vec3>& positions,
+    const std::vector<uint32_t>& indices,
+    size_t targetIndexCount,
+    float maxError,
+    float* resultError
+) {
+  if (indices.size() <= targetIndexCount) {
+    if (resultError) *resultError = 0.f;
+    return indices;
+  }
+  Simplifier simplifier(positions, indices);
+  return simplifier.run(targetIndexCount, maxError, resultError);
+}
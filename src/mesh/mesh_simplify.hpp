@@ -0,0 +1,25 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert 1997) using
+// half-edge collapses, so the surviving vertices keep their exact normals and
+// UVs and every LOD can index into the same vertex buffer.
+//
+// Open boundaries (including UV/normal seams, which show up as boundaries
+// after vertex deduplication) only collapse along themselves and carry extra
+// boundary-plane quadrics, so silhouettes and seams hold their shape.
+//
+// maxError is relative to the mesh's largest AABB dimension; simplification
+// stops at whichever of targetIndexCount or maxError is hit first.
+std::vector<uint32_t> simplifyMesh(
+    const std::vector<glm::vec3>& positions,
+    const std::vector<uint32_t>& indices,
+    size_t targetIndexCount,
+    float maxError,
+    float* resultError = nullptr);
@@ -0,0 +1,282 @@
+#include "impostor_system.hpp"
+
+#include "game/maze.h"
+#include "vulkan/vulkan-textures.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#ifndef IMPOSTOR_CACHE_DIR
+#define IMPOSTOR_CACHE_DIR "../cache/"
+#endif
+
+struct ImpostorPushConstantData {
+  glm::vec4 color{1.f};
+  int32_t atlasId;
+  int32_t framesPerSide;
+};
+
+ImpostorSystem::ImpostorSystem(
+    VKDeviceManager& device,
+    VkRenderPass renderPass,
+    VkDescriptorSetLayout globalSetLayout,
+    const VKModel::Builder& hedge
+  ) : m_device(device)
+{
+  loadAtlas(hedge);
+  createPipelineLayout(globalSetLayout);
+  createPipeline(renderPass);
+}
+
+ImpostorSystem::~ImpostorSystem() {
+  vkDestroyPipelineLayout(m_device.device(), pipelineLayout, nullptr);
+}
+
+std::unique_ptr<ImpostorSystem> ImpostorSystem::create(
+    VKDeviceManager& device,
+    VkRenderPass renderPass,
+    VkDescriptorSetLayout globalSetLayout,
+    const GameMaze& maze,
+    float distance,
+    float fadeBand
+) {
+  if (!(distance > 0.f)) {
+    return nullptr;
+  }
+  auto system = std::make_unique<ImpostorSystem>(
+      device, renderPass, globalSetLayout, maze.batcher.getSource(MazeBatcher::HEDGE));
+  system->setDistance(distance, fadeBand);
+  system->setMaze(maze);
+  return system;
+}
+
+std::unique_ptr<ImpostorSystem> ImpostorSystem::createFromEnvironment(
+    VKDeviceManager& device,
+    VkRenderPass renderPass,
+    VkDescriptorSetLayout globalSetLayout,
+    const GameMaze& maze
+) {
+  // Unset or unparsable values keep the defaults
+  auto readFloat = [](const char* name, float fallback) {
+    const char* value = std::getenv(name);
+    if (value == nullptr) {
+      return fallback;
+    }
+    char* end = nullptr;
+    float parsed = std::strtof(value, &end);
+    return end != value ? parsed : fallback;
+  };
+  return create(
+      device,
+      renderPass,
+      globalSetLayout,
+      maze,
+      readFloat("HL_IMPOSTOR_DISTANCE", DEFAULT_DISTANCE),
+      readFloat("HL_IMPOSTOR_BAND", DEFAULT_FADE_BAND));
+}
+
+void ImpostorSystem::loadAtlas(const VKModel::Builder& builder) {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  positions.reserve(builder.vertices.size());
+  normals.reserve(builder.vertices.size());
+  for (const VKModel::Vertex& vertex : builder.vertices) {
+    positions.push_back(vertex.position);
+    normals.push_back(vertex.normal);
+  }
+  if (!builder.vertices.empty()) {
+    m_hedgeColor = builder.vertices[0].color;
+  }
+
+  const uint64_t hash = hashImpostorSource(positions, normals, builder.indices, FRAMES_PER_SIDE, FRAME_SIZE);
+  const std::string cachePath = std::string(IMPOSTOR_CACHE_DIR) + "hedge2.impostor";
+  if (!loadImpostorAtlas(cachePath, hash, m_atlas)) {
+    m_atlas = bakeImpostorAtlas(positions, normals, builder.indices, FRAMES_PER_SIDE, FRAME_SIZE);
+    saveImpostorAtlas(cachePath, hash, m_atlas);
+  }
+
+  // Normals, not colours, so no sRGB decode. Mips stop at 8 texels per
+  // frame; below that the frames bleed into each other.
+  m_atlasTextureId = static_cast<int32_t>(m_device.textures().addTexture(
+      "impostor:hedge2",
+      m_atlas.rgba.data(),
+      m_atlas.getSize(),
+      m_atlas.getSize(),
+      VK_FORMAT_R8G8B8A8_UNORM,
+      ATLAS_MIP_LEVELS));
+}
+
+void ImpostorSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(ImpostorPushConstantData);
+
+  // set 0: per-frame globals, set 1: bindless textures (the atlas)
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+      globalSetLayout,
+      m_device.textures().getDescriptorSetLayout()};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+}
+
+void ImpostorSystem::createPipeline(VkRenderPass renderPass) {
+  assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+  PipelineConfigInfo pipelineConfig{};
+  VulkanPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+
+  // The quad corners come from gl_VertexIndex; each instance is one hedge
+  pipelineConfig.bindingDescriptions = {{0, sizeof(Instance), VK_VERTEX_INPUT_RATE_INSTANCE}};
+  pipelineConfig.attributeDescriptions = {
+      {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Instance, axisX)},
+      {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Instance, axisY)},
+      {2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Instance, axisZ)},
+      {3, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Instance, center)}};
+  pipelineConfig.renderPass = renderPass;
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  m_pipeline = std::make_unique<VulkanPipeline>(
+      m_device,
+      "impostor.vert.spv",
+      "impostor.frag.spv",
+      pipelineConfig);
+}
+
+void ImpostorSystem::setDistance(float distance, float fadeBand) {
+  m_distance = std::max(distance, 0.f);
+  m_fadeBand = std::max(fadeBand, 1e-3f);
+}
+
+void ImpostorSystem::setMaze(const GameMaze& maze) {
+  const glm::vec4 footprint = maze.getFootprint();
+  m_gridCorner = glm::vec2(footprint.x, footprint.y);
+
+  m_blocks.clear();
+  m_fadingBatches.clear();
+  m_fadingSet.clear();
+  for (int32_t blockY = 0; blockY < GameMaze::BLOCKS_PER_SIDE; blockY++) {
+    for (int32_t blockX = 0; blockX < GameMaze::BLOCKS_PER_SIDE; blockX++) {
+      Block block{};
+      block.batchId = maze.batcher.getObjectId(blockX, blockY, MazeBatcher::HEDGE);
+
+      const glm::ivec4 cells = maze.getBlockCells(blockX, blockY);
+      for (int32_t y = cells.y; y <= cells.w; y++) {
+        for (int32_t x = cells.x; x <= cells.z; x++) {
+          int32_t wall = maze.spatial_map[y][x];
+          if (wall < 0) continue;
+          const glm::mat4 m = maze.hedgeTransform(wall).mat4;
+          const float scale = glm::length(glm::vec3(m[1]));
+
+          Instance instance{};
+          instance.axisX = glm::vec4(glm::normalize(glm::vec3(m[0])), 0.f);
+          instance.axisY = glm::vec4(glm::normalize(glm::vec3(m[1])), 0.f);
+          instance.axisZ = glm::vec4(glm::normalize(glm::vec3(m[2])), 0.f);
+          instance.center = glm::vec4(glm::vec3(m * glm::vec4(m_atlas.center, 1.f)), m_atlas.radius * scale);
+          block.hedges.push_back(instance);
+          block.cells.push_back(m_gridCorner + glm::vec2(x, y) + 0.5f);
+          block.gridCells.push_back(glm::ivec2(x, y));
+        }
+      }
+
+      m_fadingBatches.push_back(block.batchId);
+      m_fadingSet.insert(block.batchId);
+      m_blocks.push_back(std::move(block));
+    }
+  }
+}
+
+void ImpostorSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo, const MazeVisibility* visibility) {
+  const float fadeEnd = m_distance + m_fadeBand;
+  ubo.impostorFade = glm::vec4(m_distance, fadeEnd, m_gridCorner);
+
+  const glm::vec3 cameraPos = glm::vec3(frameInfo.camera.getPosition());
+  const glm::vec2 camera(cameraPos.x, cameraPos.z);
+  const float startSquared = m_distance * m_distance;
+  const float endSquared = fadeEnd * fadeEnd;
+
+  m_replaced.clear();
+  m_visible.clear();
+  for (const Block& block : m_blocks) {
+    if (block.hedges.empty()) continue;
+
+    float nearestSquared = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < block.cells.size(); i++) {
+      glm::vec2 offset = block.cells[i] - camera;
+      float distanceSquared = glm::dot(offset, offset);
+      nearestSquared = std::min(nearestSquared, distanceSquared);
+      if (distanceSquared <= startSquared) continue;
+      // Unlike the batches, impostors are culled hedge by hedge
+      if (visibility && !visibility->isCellVisible(block.gridCells[i].x, block.gridCells[i].y)) continue;
+      m_visible.push_back(block.hedges[i]);
+    }
+
+    // Every hedge in the block is fully faded out, so the batch is skipped
+    if (nearestSquared >= endSquared) {
+      m_replaced.insert(block.batchId);
+    }
+  }
+}
+
+void ImpostorSystem::render(FrameInfo& frameInfo) {
+  const uint32_t count = static_cast<uint32_t>(m_visible.size());
+  if (count == 0) {
+    return;
+  }
+
+  VKFrameAllocator::Allocation instances{};
+  Instance* data = frameInfo.frameAllocator.allocate<Instance>(count, instances);
+  std::copy(m_visible.begin(), m_visible.end(), data);
+
+  m_pipeline->bind(frameInfo.commandBuffer);
+
+  VkDescriptorSet descriptorSets[] = {
+      frameInfo.globalDescriptorSet,
+      m_device.textures().getDescriptorSet()};
+  vkCmdBindDescriptorSets(
+      frameInfo.commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipelineLayout,
+      0,
+      2,
+      descriptorSets,
+      GLOBAL_DYNAMIC_OFFSET_COUNT,
+      frameInfo.globalOffsets.data());
+
+  ImpostorPushConstantData push{};
+  push.color = glm::vec4(m_hedgeColor, 1.f);
+  push.atlasId = m_atlasTextureId;
+  push.framesPerSide = static_cast<int32_t>(m_atlas.framesPerSide);
+  vkCmdPushConstants(
+      frameInfo.commandBuffer,
+      pipelineLayout,
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+      0,
+      sizeof(ImpostorPushConstantData),
+      &push);
+
+  VkBuffer buffers[] = {instances.buffer};
+  VkDeviceSize offsets[] = {instances.offset};
+  vkCmdBindVertexBuffers(frameInfo.commandBuffer, 0, 1, buffers, offsets);
+  vkCmdDraw(frameInfo.commandBuffer, 6, count, 0, 0);
+}
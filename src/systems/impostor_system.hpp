@@ -0,0 +1,133 @@
+#pragma once
+
+#include "game/lve_game_object.hpp"
+#include "game/maze_visibility.hpp"
+#include "mesh/impostor_atlas.hpp"
+
+#include "vulkan/vulkan-device.hpp"
+#include "vulkan/vulkan-frame-info.hpp"
+#include "vulkan/vulkan-model.hpp"
+#include "vulkan/vulkan-pipeline.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+class GameMaze;
+
+// Octahedral impostors for distant hedges.
+//
+// The hedge mesh is baked into an ImpostorAtlas at load time (or read back from
+// the on-disk cache) and uploaded as a bindless texture. Every hedge whose
+// cell is further than the fade start from the camera (horizontally) gets a
+// camera-facing quad, drawn in one instanced call, that samples the atlas
+// frame closest to the view direction and is lit with the hedge's baked
+// normals.
+//
+// Across the fade band the hedge meshes and the impostors swap pixels with
+// complementary ordered dither, so there is no blending and no pop.
+// SimpleRenderSystem draws the maze's hedge batches with a pipeline that
+// does its half of the dither, and skips a block's batch altogether once all
+// of its hedges are past the band; that is where the vertex work goes.
+class ImpostorSystem {
+ public:
+  static constexpr uint32_t FRAMES_PER_SIDE = 8;
+  static constexpr uint32_t FRAME_SIZE = 64;
+  static constexpr uint32_t ATLAS_MIP_LEVELS = 4;
+  // Fog in simple_shader.frag washes everything out by 20
+  static constexpr float DEFAULT_DISTANCE = 8.f;
+  static constexpr float DEFAULT_FADE_BAND = 2.f;
+
+  // hedge is the unbatched hedge mesh (MazeBatcher::getSource)
+  ImpostorSystem(
+      VKDeviceManager& device,
+      VkRenderPass renderPass,
+      VkDescriptorSetLayout globalSetLayout,
+      const VKModel::Builder& hedge);
+  ~ImpostorSystem();
+
+  // Set up for the maze's hedges, or null when distance is not positive
+  // (impostors off)
+  static std::unique_ptr<ImpostorSystem> create(
+      VKDeviceManager& device,
+      VkRenderPass renderPass,
+      VkDescriptorSetLayout globalSetLayout,
+      const GameMaze& maze,
+      float distance = DEFAULT_DISTANCE,
+      float fadeBand = DEFAULT_FADE_BAND);
+  // create() with the distance from HL_IMPOSTOR_DISTANCE and the band from
+  // HL_IMPOSTOR_BAND, where set; HL_IMPOSTOR_DISTANCE=0 turns them off
+  static std::unique_ptr<ImpostorSystem> createFromEnvironment(
+      VKDeviceManager& device,
+      VkRenderPass renderPass,
+      VkDescriptorSetLayout globalSetLayout,
+      const GameMaze& maze);
+
+  ImpostorSystem(const ImpostorSystem &) = delete;
+  ImpostorSystem &operator=(const ImpostorSystem &) = delete;
+
+  // Meshes start handing over at distance and are gone at distance + fadeBand
+  void setDistance(float distance, float fadeBand = DEFAULT_FADE_BAND);
+  // Takes every hedge and block batch from the maze; call again whenever the
+  // maze's batches have been rebuilt
+  void setMaze(const GameMaze& maze);
+
+  // Picks this frame's impostors and fills ubo.impostorFade. Hedges outside
+  // visibility's PVS get none.
+  void update(FrameInfo &frameInfo, GlobalUbo &ubo, const MazeVisibility* visibility = nullptr);
+  void render(FrameInfo &frameInfo);
+
+  // Hedge batches, which SimpleRenderSystem draws with its fading pipeline
+  const std::vector<LveGameObject::id_t>& getFadingBatches() const { return m_fadingBatches; }
+  bool fadesOut(LveGameObject::id_t id) const { return m_fadingSet.count(id) != 0; }
+  // Batches entirely past the fade band this frame
+  bool isReplaced(LveGameObject::id_t id) const { return m_replaced.count(id) != 0; }
+  uint32_t getImpostorCount() const { return static_cast<uint32_t>(m_visible.size()); }
+
+ private:
+  // Per-instance vertex data for impostor.vert: the hedge's transform as
+  // unit axes plus its bounding sphere
+  struct Instance {
+    glm::vec4 axisX{};  // xyz: world direction of the mesh's +x
+    glm::vec4 axisY{};
+    glm::vec4 axisZ{};
+    glm::vec4 center{};  // xyz: world bounding sphere centre, w: radius
+  };
+
+  struct Block {
+    LveGameObject::id_t batchId;
+    std::vector<Instance> hedges;
+    // World xz of each hedge's cell centre, which is what the fade measures
+    std::vector<glm::vec2> cells;
+    // Grid cell of each hedge, for the PVS
+    std::vector<glm::ivec2> gridCells;
+  };
+
+  void loadAtlas(const VKModel::Builder& hedge);
+  void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+  void createPipeline(VkRenderPass renderPass);
+
+  VKDeviceManager& m_device;
+
+  ImpostorAtlas m_atlas;
+  int32_t m_atlasTextureId = -1;
+  glm::vec3 m_hedgeColor{1.f};
+
+  float m_distance = DEFAULT_DISTANCE;
+  float m_fadeBand = DEFAULT_FADE_BAND;
+  glm::vec2 m_gridCorner{0.f};
+
+  std::vector<Block> m_blocks;
+  std::vector<LveGameObject::id_t> m_fadingBatches;
+  std::unordered_set<LveGameObject::id_t> m_fadingSet;
+  std::unordered_set<LveGameObject::id_t> m_replaced;
+  std::vector<Instance> m_visible;
+
+  std::unique_ptr<VulkanPipeline> m_pipeline;
+  VkPipelineLayout pipelineLayout;
+};
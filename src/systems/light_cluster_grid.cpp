@@ -0,0 +1,185 @@
+#include "light_cluster_grid.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+
+LightClusterGrid::LightClusterGrid() {
+  m_minX.resize(CLUSTERS_Z * CLUSTERS_X);
+  m_maxX.resize(CLUSTERS_Z * CLUSTERS_X);
+  m_minY.resize(CLUSTERS_Z * CLUSTERS_Y);
+  m_maxY.resize(CLUSTERS_Z * CLUSTERS_Y);
+  m_sliceNear.resize(CLUSTERS_Z);
+  m_sliceFar.resize(CLUSTERS_Z);
+  m_counts.resize(CLUSTER_COUNT);
+  m_ranges.resize(CLUSTER_COUNT);
+  m_indices.resize(MAX_LIGHT_INDICES);
+  m_rowDist.resize(CLUSTERS_X);
+}
+
+void LightClusterGrid::buildClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane) {
+  m_boundsProjection = projection;
+  m_near = nearPlane;
+  m_far = farPlane;
+
+  const float logRatio = std::log(farPlane / nearPlane);
+  m_sliceScale = CLUSTERS_Z / logRatio;
+  m_sliceBias = -(CLUSTERS_Z * std::log(nearPlane)) / logRatio;
+
+  // View-space point at a given NDC xy and view depth, so this works for any
+  // projection the camera hands us
+  const glm::mat4 inverseProjection = glm::inverse(projection);
+  auto unproject = [&](float ndcX, float ndcY, float depth) {
+    glm::vec4 clip = projection * glm::vec4(0.f, 0.f, -depth, 1.f);
+    glm::vec4 view = inverseProjection * glm::vec4(ndcX, ndcY, clip.z / clip.w, 1.f);
+    return glm::vec3(view) / view.w;
+  };
+
+  for (uint32_t z = 0; z < CLUSTERS_Z; z++) {
+    const float sliceNear = nearPlane * std::pow(farPlane / nearPlane, float(z) / CLUSTERS_Z);
+    const float sliceFar = nearPlane * std::pow(farPlane / nearPlane, float(z + 1) / CLUSTERS_Z);
+    m_sliceNear[z] = sliceNear;
+    m_sliceFar[z] = sliceFar;
+
+    for (uint32_t x = 0; x < CLUSTERS_X; x++) {
+      const float ndc0 = -1.f + 2.f * x / CLUSTERS_X;
+      const float ndc1 = -1.f + 2.f * (x + 1) / CLUSTERS_X;
+      float corners[4] = {
+          unproject(ndc0, 0.f, sliceNear).x, unproject(ndc1, 0.f, sliceNear).x,
+          unproject(ndc0, 0.f, sliceFar).x, unproject(ndc1, 0.f, sliceFar).x};
+      m_minX[z * CLUSTERS_X + x] = *std::min_element(corners, corners + 4);
+      m_maxX[z * CLUSTERS_X + x] = *std::max_element(corners, corners + 4);
+    }
+    for (uint32_t y = 0; y < CLUSTERS_Y; y++) {
+      const float ndc0 = -1.f + 2.f * y / CLUSTERS_Y;
+      const float ndc1 = -1.f + 2.f * (y + 1) / CLUSTERS_Y;
+      float corners[4] = {
+          unproject(0.f, ndc0, sliceNear).y, unproject(0.f, ndc1, sliceNear).y,
+          unproject(0.f, ndc0, sliceFar).y, unproject(0.f, ndc1, sliceFar).y};
+      m_minY[z * CLUSTERS_Y + y] = *std::min_element(corners, corners + 4);
+      m_maxY[z * CLUSTERS_Y + y] = *std::max_element(corners, corners + 4);
+    }
+  }
+}
+
+void LightClusterGrid::binSphere(
+    uint32_t index,
+    const glm::vec3& center,
+    float range,
+    const glm::mat4& projection
+) {
+  const float depth = -center.z;
+  if (depth + range < m_near || depth - range > m_far) {
+    return;
+  }
+
+  auto sliceOf = [this](float d) {
+    int slice = static_cast<int>(std::floor(std::log(d) * m_sliceScale + m_sliceBias));
+    return static_cast<uint32_t>(std::clamp(slice, 0, int(CLUSTERS_Z) - 1));
+  };
+  const uint32_t z0 = sliceOf(std::max(depth - range, m_near));
+  const uint32_t z1 = sliceOf(std::min(depth + range, m_far));
+
+  // Screen rectangle from the projected corners of the sphere's box; a
+  // sphere crossing the near plane can cover anything
+  uint32_t x0 = 0, x1 = CLUSTERS_X - 1;
+  uint32_t y0 = 0, y1 = CLUSTERS_Y - 1;
+  if (depth - range > m_near) {
+    glm::vec2 ndcMin(1.f);
+    glm::vec2 ndcMax(-1.f);
+    for (int corner = 0; corner < 8; corner++) {
+      glm::vec3 offset(
+          corner & 1 ? range : -range,
+          corner & 2 ? range : -range,
+          corner & 4 ? range : -range);
+      glm::vec4 clip = projection * glm::vec4(center + offset, 1.f);
+      glm::vec2 ndc = glm::vec2(clip) / clip.w;
+      ndcMin = glm::min(ndcMin, ndc);
+      ndcMax = glm::max(ndcMax, ndc);
+    }
+    if (ndcMax.x < -1.f || ndcMin.x > 1.f || ndcMax.y < -1.f || ndcMin.y > 1.f) {
+      return;
+    }
+    auto tileOf = [](float ndc, uint32_t count) {
+      int tile = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * count));
+      return static_cast<uint32_t>(std::clamp(tile, 0, int(count) - 1));
+    };
+    x0 = tileOf(ndcMin.x, CLUSTERS_X);
+    x1 = tileOf(ndcMax.x, CLUSTERS_X);
+    y0 = tileOf(ndcMin.y, CLUSTERS_Y);
+    y1 = tileOf(ndcMax.y, CLUSTERS_Y);
+  }
+
+  const float rangeSq = range * range;
+  float* rowDist = m_rowDist.data();
+  for (uint32_t z = z0; z <= z1; z++) {
+    float dz = std::max(std::max(m_sliceNear[z] - depth, depth - m_sliceFar[z]), 0.f);
+    float remainingZ = rangeSq - dz * dz;
+    if (remainingZ < 0.f) continue;
+
+    const float* minX = m_minX.data() + z * CLUSTERS_X;
+    const float* maxX = m_maxX.data() + z * CLUSTERS_X;
+    for (uint32_t y = y0; y <= y1; y++) {
+      const uint32_t row = z * CLUSTERS_Y + y;
+      float dy = std::max(std::max(m_minY[row] - center.y, center.y - m_maxY[row]), 0.f);
+      float remaining = remainingZ - dy * dy;
+      if (remaining < 0.f) continue;
+
+      // Branch-free over the columns so it vectorizes
+      for (uint32_t x = x0; x <= x1; x++) {
+        float dx = std::max(std::max(minX[x] - center.x, center.x - maxX[x]), 0.f);
+        rowDist[x] = dx * dx;
+      }
+      const uint32_t rowBase = row * CLUSTERS_X;
+      for (uint32_t x = x0; x <= x1; x++) {
+        if (rowDist[x] <= remaining) {
+          m_hitCluster.push_back(rowBase + x);
+          m_hitLight.push_back(index);
+        }
+      }
+    }
+  }
+}
+
+
+uint32_t LightClusterGrid::bin(
+    const glm::mat4& projection,
+    float nearPlane,
+    float farPlane,
+    const std::vector<glm::vec4>& spheres
+) {
+  if (projection != m_boundsProjection || nearPlane != m_near || farPlane != m_far) {
+    buildClusterBounds(projection, nearPlane, farPlane);
+  }
+
+  m_hitCluster.clear();
+  m_hitLight.clear();
+  for (uint32_t i = 0; i < spheres.size(); i++) {
+    binSphere(i, glm::vec3(spheres[i]), spheres[i].w, projection);
+  }
+
+  // Count, prefix sum, scatter. Spheres stay in order within a cluster.
+  std::fill(m_counts.begin(), m_counts.end(), 0u);
+  for (uint32_t cluster : m_hitCluster) {
+    m_counts[cluster]++;
+  }
+  uint32_t total = 0;
+  for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+    uint32_t first = std::min(total, MAX_LIGHT_INDICES);
+    m_ranges[cluster] = glm::uvec2(first, std::min(m_counts[cluster], MAX_LIGHT_INDICES - first));
+    total += m_counts[cluster];
+    m_counts[cluster] = 0;
+  }
+  for (size_t hit = 0; hit < m_hitCluster.size(); hit++) {
+    uint32_t cluster = m_hitCluster[hit];
+    if (m_counts[cluster] < m_ranges[cluster].y) {
+      m_indices[m_ranges[cluster].x + m_counts[cluster]++] = m_hitLight[hit];
+    }
+  }
+  return total;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+// The CPU side of LightClusterSystem: view-space cluster ("froxel") bounds
+// and the binning of light spheres into them. It needs nothing from Vulkan,
+// so LightClusterTest can check it against brute force without a device.
+//
+// Cluster bounds are separable (x depends on the column and slice, y on the
+// row and slice, depth on the slice), so they are kept as SoA arrays and the
+// per-row sphere test over a light's columns is a straight loop that
+// vectorizes.
+class LightClusterGrid {
+ public:
+  static constexpr uint32_t CLUSTERS_X = 16;
+  static constexpr uint32_t CLUSTERS_Y = 9;
+  static constexpr uint32_t CLUSTERS_Z = 24;
+  static constexpr uint32_t CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+  // Capacity of the index list, an average of 32 lights per cluster
+  static constexpr uint32_t MAX_LIGHT_INDICES = CLUSTER_COUNT * 32;
+
+  LightClusterGrid();
+
+  // Bins view-space spheres (xyz: centre, w: range) into the clusters of
+  // projection, rebuilding the bounds first if the projection changed.
+  // Returns how many indices the bins wanted; past MAX_LIGHT_INDICES the
+  // later clusters lose lights.
+  uint32_t bin(
+      const glm::mat4& projection,
+      float nearPlane,
+      float farPlane,
+      const std::vector<glm::vec4>& spheres);
+
+  // Cluster index is (slice * CLUSTERS_Y + row) * CLUSTERS_X + column
+  static uint32_t clusterIndex(uint32_t x, uint32_t y, uint32_t z) {
+    return (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+  }
+  // First index and count into getIndices, per cluster
+  const std::vector<glm::uvec2>& getRanges() const { return m_ranges; }
+  // Sphere indices grouped by cluster, in input order within a cluster
+  const std::vector<uint32_t>& getIndices() const { return m_indices; }
+  // slice = log(depth) * x + y
+  glm::vec2 getSliceParams() const { return glm::vec2(m_sliceScale, m_sliceBias); }
+
+ private:
+  // Only redone when the projection changes
+  void buildClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane);
+  void binSphere(uint32_t index, const glm::vec3& center, float range, const glm::mat4& projection);
+
+  glm::mat4 m_boundsProjection{0.f};
+  float m_near = 0.f;
+  float m_far = 0.f;
+  float m_sliceScale = 0.f;
+  float m_sliceBias = 0.f;
+
+  // View-space cluster bounds; depth is positive distance along the view axis
+  std::vector<float> m_minX;  // [slice * CLUSTERS_X + column]
+  std::vector<float> m_maxX;
+  std::vector<float> m_minY;  // [slice * CLUSTERS_Y + row]
+  std::vector<float> m_maxY;
+  std::vector<float> m_sliceNear;  // [slice]
+  std::vector<float> m_sliceFar;
+
+  // Scratch space, kept around so the per-frame pass doesn't allocate
+  std::vector<uint32_t> m_hitCluster;
+  std::vector<uint32_t> m_hitLight;
+  std::vector<uint32_t> m_counts;
+  std::vector<glm::uvec2> m_ranges;
+  std::vector<uint32_t> m_indices;
+  std::vector<float> m_rowDist;
+};
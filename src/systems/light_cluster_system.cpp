@@ -0,0 +1,56 @@
+#include "light_cluster_system.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+void LightClusterSystem::update(
+    FrameInfo& frameInfo,
+    const std::vector<PointLight>& lights,
+    GlobalUbo& ubo
+) {
+  const Camera& camera = frameInfo.camera;
+
+  uint32_t lightCount = static_cast<uint32_t>(std::min<size_t>(lights.size(), MAX_LIGHTS));
+  if (lights.size() > MAX_LIGHTS && !m_warnedOverflow) {
+    std::cerr << "LightClusterSystem: " << lights.size() << " lights, only the first "
+              << MAX_LIGHTS << " are shaded" << std::endl;
+    m_warnedOverflow = true;
+  }
+
+  m_spheres.resize(lightCount);
+  for (uint32_t i = 0; i < lightCount; i++) {
+    glm::vec3 center = glm::vec3(camera.view_mat * glm::vec4(glm::vec3(lights[i].position), 1.f));
+    m_spheres[i] = glm::vec4(center, lights[i].position.w);
+  }
+  uint32_t total = m_grid.bin(camera.proj_mat, camera.near_plane, camera.far_plane, m_spheres);
+  if (total > MAX_LIGHT_INDICES && !m_warnedOverflow) {
+    std::cerr << "LightClusterSystem: light index list overflow (" << total << " > "
+              << MAX_LIGHT_INDICES << "), far clusters lose lights" << std::endl;
+    m_warnedOverflow = true;
+  }
+
+  // Upload. The descriptors cover the full ranges, so those are allocated,
+  // but only the used part is written.
+  VKFrameAllocator& allocator = frameInfo.frameAllocator;
+  VKFrameAllocator::Allocation lightAlloc = allocator.allocate(LIGHT_BUFFER_SIZE);
+  std::memcpy(lightAlloc.data, lights.data(), lightCount * sizeof(PointLight));
+  VKFrameAllocator::Allocation clusterAlloc = allocator.push(m_grid.getRanges().data(), CLUSTER_BUFFER_SIZE);
+  VKFrameAllocator::Allocation indexAlloc = allocator.allocate(INDEX_BUFFER_SIZE);
+  uint32_t indexCount = std::min(total, MAX_LIGHT_INDICES);
+  std::memcpy(indexAlloc.data, m_grid.getIndices().data(), indexCount * sizeof(uint32_t));
+
+  frameInfo.globalOffsets[1] = lightAlloc.dynamicOffset();
+  frameInfo.globalOffsets[2] = clusterAlloc.dynamicOffset();
+  frameInfo.globalOffsets[3] = indexAlloc.dynamicOffset();
+
+  ubo.clusterGrid = glm::uvec4(
+      LightClusterGrid::CLUSTERS_X, LightClusterGrid::CLUSTERS_Y, LightClusterGrid::CLUSTERS_Z, lightCount);
+  ubo.clusterDepth = m_grid.getSliceParams();
+}
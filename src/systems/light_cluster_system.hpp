@@ -0,0 +1,48 @@
+#pragma once
+
+#include "systems/light_cluster_grid.hpp"
+#include "vulkan/vulkan-frame-info.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+// Bins point lights into view-space clusters ("froxels": screen tiles split
+// into exponential depth slices) so the fragment shader only evaluates the
+// lights that can reach its cluster. The binning itself is LightClusterGrid.
+//
+// Every frame it fills three storage buffers in the frame allocator, bound in
+// the global set as dynamic storage buffers:
+//   binding 1: PointLight[MAX_LIGHTS], position.w is the light's range
+//   binding 2: uvec2 per cluster, first index and count into binding 3
+//   binding 3: uint light indices, grouped by cluster
+class LightClusterSystem {
+ public:
+  static constexpr uint32_t CLUSTER_COUNT = LightClusterGrid::CLUSTER_COUNT;
+  static constexpr uint32_t MAX_LIGHT_INDICES = LightClusterGrid::MAX_LIGHT_INDICES;
+
+  // Descriptor ranges of bindings 1-3; each frame allocates them in full
+  static constexpr VkDeviceSize LIGHT_BUFFER_SIZE = sizeof(PointLight) * MAX_LIGHTS;
+  static constexpr VkDeviceSize CLUSTER_BUFFER_SIZE = sizeof(glm::uvec2) * CLUSTER_COUNT;
+  static constexpr VkDeviceSize INDEX_BUFFER_SIZE = sizeof(uint32_t) * MAX_LIGHT_INDICES;
+
+  LightClusterSystem() = default;
+  ~LightClusterSystem() = default;
+
+  LightClusterSystem(const LightClusterSystem &) = delete;
+  LightClusterSystem &operator=(const LightClusterSystem &) = delete;
+
+  // Bins lights for the camera, writes the buffers and their offsets into
+  // frameInfo and the cluster grid parameters into ubo. Lights past
+  // MAX_LIGHTS are dropped.
+  void update(FrameInfo& frameInfo, const std::vector<PointLight>& lights, GlobalUbo& ubo);
+
+ private:
+  LightClusterGrid m_grid;
+  // View-space centre and range of each light, the grid's input
+  std::vector<glm::vec4> m_spheres;
+  bool m_warnedOverflow = false;
+};
@@ -0,0 +1,190 @@
+#include "light_cluster_grid.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Checks LightClusterGrid::bin against a brute force test of every light
+// against every cluster's exact frustum cell. A light the brute force puts in
+// a cluster but the grid doesn't is a miss, which shows up as a light cut off
+// at a cluster border. Extra lights are fine (the bins are conservative) and
+// only reported.
+
+static constexpr uint32_t LIGHT_COUNT = 1000;
+static constexpr float NEAR_PLANE = 0.1f;
+static constexpr float FAR_PLANE = 100.f;
+
+// A cluster as eight view-space corners (bit 0: right, bit 1: top, bit 2:
+// far) and its six outward facing planes (xyz: normal, w: offset)
+struct Froxel {
+  glm::vec3 corners[8];
+  glm::vec4 planes[6];
+};
+
+// Corners of each face, wound so the cross product points outwards
+static constexpr int FACES[6][3] = {
+    {0, 4, 2},  // left
+    {1, 3, 5},  // right
+    {0, 1, 4},  // bottom
+    {2, 6, 3},  // top
+    {0, 2, 1},  // near
+    {4, 5, 6}};  // far
+
+// The cluster's corners unprojected one by one, so none of the grid's
+// separable shortcuts are shared
+static Froxel makeFroxel(const glm::mat4& projection, uint32_t x, uint32_t y, uint32_t z) {
+  using Grid = LightClusterGrid;
+  const glm::mat4 inverseProjection = glm::inverse(projection);
+  const float depths[2] = {
+      NEAR_PLANE * std::pow(FAR_PLANE / NEAR_PLANE, float(z) / Grid::CLUSTERS_Z),
+      NEAR_PLANE * std::pow(FAR_PLANE / NEAR_PLANE, float(z + 1) / Grid::CLUSTERS_Z)};
+
+  Froxel froxel;
+  for (int corner = 0; corner < 8; corner++) {
+    float ndcX = -1.f + 2.f * (x + (corner & 1)) / Grid::CLUSTERS_X;
+    float ndcY = -1.f + 2.f * (y + ((corner >> 1) & 1)) / Grid::CLUSTERS_Y;
+    float depth = depths[corner >> 2];
+    glm::vec4 clip = projection * glm::vec4(0.f, 0.f, -depth, 1.f);
+    glm::vec4 view = inverseProjection * glm::vec4(ndcX, ndcY, clip.z / clip.w, 1.f);
+    froxel.corners[corner] = glm::vec3(view) / view.w;
+  }
+
+  glm::vec3 center(0.f);
+  for (const glm::vec3& corner : froxel.corners) {
+    center += corner / 8.f;
+  }
+  for (int face = 0; face < 6; face++) {
+    const glm::vec3& a = froxel.corners[FACES[face][0]];
+    glm::vec3 normal = glm::normalize(glm::cross(
+        froxel.corners[FACES[face][1]] - a, froxel.corners[FACES[face][2]] - a));
+    // Don't trust the winding table through a y flipped projection
+    if (glm::dot(normal, center - a) > 0.f) {
+      normal = -normal;
+    }
+    froxel.planes[face] = glm::vec4(normal, -glm::dot(normal, a));
+  }
+  return froxel;
+}
+
+static glm::vec3 closestOnSegment(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b) {
+  glm::vec3 ab = b - a;
+  float t = glm::clamp(glm::dot(p - a, ab) / glm::dot(ab, ab), 0.f, 1.f);
+  return a + t * ab;
+}
+
+// Exact distance from p to the (convex) froxel: zero inside, otherwise the
+// nearest of the face interiors, the edges and the corners
+static float froxelDistance(const Froxel& froxel, const glm::vec3& p) {
+  const float epsilon = 1e-5f;
+  auto inside = [&](const glm::vec3& q, int skip) {
+    for (int face = 0; face < 6; face++) {
+      if (face == skip) continue;
+      const glm::vec4& plane = froxel.planes[face];
+      if (glm::dot(glm::vec3(plane), q) + plane.w > epsilon * (1.f + glm::length(q))) return false;
+    }
+    return true;
+  };
+  if (inside(p, -1)) {
+    return 0.f;
+  }
+
+  float best = std::numeric_limits<float>::max();
+  for (int face = 0; face < 6; face++) {
+    const glm::vec4& plane = froxel.planes[face];
+    float signedDistance = glm::dot(glm::vec3(plane), p) + plane.w;
+    if (signedDistance <= 0.f) continue;
+    glm::vec3 projected = p - signedDistance * glm::vec3(plane);
+    if (inside(projected, face)) {
+      best = std::min(best, signedDistance);
+    }
+  }
+  for (int a = 0; a < 8; a++) {
+    for (int bit = 1; bit < 8; bit <<= 1) {
+      if (a & bit) continue;
+      glm::vec3 q = closestOnSegment(p, froxel.corners[a], froxel.corners[a | bit]);
+      best = std::min(best, glm::length(p - q));
+    }
+  }
+  return best;
+}
+
+static bool check(const char* name, const glm::mat4& projection, std::mt19937& rng) {
+  using Grid = LightClusterGrid;
+
+  // View space, around and past the frustum so every kind of edge case
+  // (behind the camera, across the near plane, off screen) comes up
+  std::uniform_real_distribution<float> spreadX(-40.f, 40.f);
+  std::uniform_real_distribution<float> spreadY(-25.f, 25.f);
+  std::uniform_real_distribution<float> spreadZ(-FAR_PLANE - 5.f, 5.f);
+  std::uniform_real_distribution<float> spreadRange(0.1f, 6.f);
+  std::vector<glm::vec4> spheres(LIGHT_COUNT);
+  for (glm::vec4& sphere : spheres) {
+    sphere = glm::vec4(spreadX(rng), spreadY(rng), spreadZ(rng), spreadRange(rng));
+  }
+
+  Grid grid;
+  auto start = std::chrono::steady_clock::now();
+  uint32_t total = grid.bin(projection, NEAR_PLANE, FAR_PLANE, spheres);
+  double binMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  if (total > Grid::MAX_LIGHT_INDICES) {
+    std::cout << name << ": index list overflowed, the test lights are too big" << std::endl;
+    return false;
+  }
+
+  uint32_t missed = 0;
+  uint32_t expected = 0;
+  std::vector<bool> binned(LIGHT_COUNT);
+  for (uint32_t z = 0; z < Grid::CLUSTERS_Z; z++) {
+    for (uint32_t y = 0; y < Grid::CLUSTERS_Y; y++) {
+      for (uint32_t x = 0; x < Grid::CLUSTERS_X; x++) {
+        const glm::uvec2 range = grid.getRanges()[Grid::clusterIndex(x, y, z)];
+        std::fill(binned.begin(), binned.end(), false);
+        for (uint32_t i = range.x; i < range.x + range.y; i++) {
+          binned[grid.getIndices()[i]] = true;
+        }
+
+        const Froxel froxel = makeFroxel(projection, x, y, z);
+        for (uint32_t light = 0; light < LIGHT_COUNT; light++) {
+          // A hair smaller, so a light that only grazes a corner in one
+          // rounding and not the other doesn't count
+          const glm::vec4& sphere = spheres[light];
+          if (froxelDistance(froxel, glm::vec3(sphere)) > sphere.w * (1.f - 1e-4f)) continue;
+          expected++;
+          if (!binned[light]) {
+            if (missed < 10) {
+              std::cout << name << ": light " << light << " missing from cluster ("
+                        << x << ", " << y << ", " << z << ")" << std::endl;
+            }
+            missed++;
+          }
+        }
+      }
+    }
+  }
+
+  std::cout << name << ": " << LIGHT_COUNT << " lights, " << expected << " brute force hits, "
+            << total << " binned, " << missed << " missed, bin took " << binMs << " ms" << std::endl;
+  return missed == 0;
+}
+
+int main(int argc, char *argv[]) {
+  std::mt19937 rng(1);
+  bool passed = true;
+  // The game camera's projection, and an orthographic one
+  passed &= check("perspective", glm::perspective(glm::pi<float>() / 4.f, 16.f / 9.f, NEAR_PLANE, FAR_PLANE), rng);
+  passed &= check("orthographic", glm::ortho(-20.f, 20.f, -11.25f, 11.25f, NEAR_PLANE, FAR_PLANE), rng);
+  std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+  return passed ? 0 : 1;
+}
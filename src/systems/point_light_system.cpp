@@ -7,16 +7,16 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
-#include <map>
+#include <cmath>
+#include <cstddef>
 #include <stdexcept>
 
-struct PointLightPushConstants {
-  glm::vec4 position{};
-  glm::vec4 color{};
-  float radius;
-};
+// A light is culled where intensity / distance^2 falls below this; the
+// shader fades it out smoothly towards that range
+static constexpr float LIGHT_CUTOFF = 0.005f;
 
 PointLightSystem::PointLightSystem(
     VKDeviceManager& device,
@@ -33,19 +33,14 @@ PointLightSystem::~PointLightSystem() {
 }
 
 void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-  VkPushConstantRange pushConstantRange{};
-  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-  pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(PointLightPushConstants);
-
   std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
   pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = nullptr;
   if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to create pipeline layout!");
@@ -61,8 +56,11 @@ void PointLightSystem::createPipeline(VkRenderPass renderPass) {
   // Disable backface culling to show the lights from any angle
   pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
 
-  pipelineConfig.attributeDescriptions.clear();
-  pipelineConfig.bindingDescriptions.clear();
+  // The quad corners come from gl_VertexIndex; each instance is one light
+  pipelineConfig.bindingDescriptions = {{0, sizeof(Billboard), VK_VERTEX_INPUT_RATE_INSTANCE}};
+  pipelineConfig.attributeDescriptions = {
+      {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Billboard, position)},
+      {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Billboard, color)}};
   pipelineConfig.renderPass = renderPass;
   pipelineConfig.pipelineLayout = pipelineLayout;
   m_pipeline = std::make_unique<VulkanPipeline>(
@@ -74,36 +72,62 @@ void PointLightSystem::createPipeline(VkRenderPass renderPass) {
 
 void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo) {
   auto rotateLight = glm::rotate(glm::mat4(1.f), 0.5f * frameInfo.frameTime, {0.f, -1.f, 0.f});
-  int lightIndex = 0;
+  m_lights.clear();
+  m_lightIds.clear();
+  m_billboards.clear();
   for (auto& kv : frameInfo.gameObjects) {
     auto& obj = kv.second;
     if (obj.pointLight == nullptr) continue;
 
-    assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified");
-
     // update light position
 //    obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.f));
 
-    // copy light to ubo
-    ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.f);
-    ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+    float intensity = obj.pointLight->lightIntensity;
+    float brightest = std::max(obj.color.r, std::max(obj.color.g, obj.color.b));
+    float range = std::sqrt(std::max(intensity * brightest, 0.f) / LIGHT_CUTOFF);
+
+    PointLight light{};
+    light.position = glm::vec4(obj.transform.translation, range);
+    light.color = glm::vec4(obj.color, intensity);
+    m_lights.push_back(light);
+    m_lightIds.push_back(kv.first);
+
+    Billboard billboard{};
+    billboard.position = glm::vec4(obj.transform.translation, obj.transform.scale.x);
+    billboard.color = light.color;
+    m_billboards.push_back(billboard);
+  }
+  m_clusters.update(frameInfo, m_lights, ubo);
+}
 
-    lightIndex += 1;
+int PointLightSystem::getLightIndex(LveGameObject::id_t id) const {
+  auto it = std::find(m_lightIds.begin(), m_lightIds.end(), id);
+  if (it == m_lightIds.end() || it - m_lightIds.begin() >= MAX_LIGHTS) {
+    return -1;
   }
-  ubo.numLights = lightIndex;
+  return static_cast<int>(it - m_lightIds.begin());
 }
 
 void PointLightSystem::render(FrameInfo& frameInfo) {
-  // sort lights
-  std::map<float, LveGameObject::id_t> sorted;
-  for (auto& kv : frameInfo.gameObjects) {
-    auto& obj = kv.second;
-    if (obj.pointLight == nullptr) continue;
+  const uint32_t count = static_cast<uint32_t>(m_billboards.size());
+  if (count == 0) {
+    return;
+  }
+
+  // Back to front for blending
+  const glm::vec3 cameraPosition = glm::vec3(frameInfo.camera.getPosition());
+  m_distances.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    glm::vec3 offset = cameraPosition - glm::vec3(m_billboards[i].position);
+    m_distances[i] = glm::dot(offset, offset);
+  }
+  const std::vector<uint32_t>& order = m_sorter.sort(m_distances.data(), count, true);
 
-    // calculate distance
-    auto offset = glm::vec3(frameInfo.camera.getPosition()) - obj.transform.translation;
-    float disSquared = glm::dot(offset, offset);
-    sorted[disSquared] = obj.getId();
+  // Written sorted straight into this frame's transient memory
+  VKFrameAllocator::Allocation instances{};
+  Billboard* sorted = frameInfo.frameAllocator.allocate<Billboard>(count, instances);
+  for (uint32_t i = 0; i < count; i++) {
+    sorted[i] = m_billboards[order[i]];
   }
 
   m_pipeline->bind(frameInfo.commandBuffer);
@@ -115,26 +139,11 @@ void PointLightSystem::render(FrameInfo& frameInfo) {
       0,
       1,
       &frameInfo.globalDescriptorSet,
-      0,
-      nullptr);
-
-  // iterate through sorted lights in reverse order
-  for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
-    // use game obj id to find light object
-    auto& obj = frameInfo.gameObjects.at(it->second);
-
-    PointLightPushConstants push{};
-    push.position = glm::vec4(obj.transform.translation, 1.f);
-    push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-    push.radius = obj.transform.scale.x;
-
-    vkCmdPushConstants(
-        frameInfo.commandBuffer,
-        pipelineLayout,
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        0,
-        sizeof(PointLightPushConstants),
-        &push);
-    vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-  }
+      GLOBAL_DYNAMIC_OFFSET_COUNT,
+      frameInfo.globalOffsets.data());
+
+  VkBuffer buffers[] = {instances.buffer};
+  VkDeviceSize offsets[] = {instances.offset};
+  vkCmdBindVertexBuffers(frameInfo.commandBuffer, 0, 1, buffers, offsets);
+  vkCmdDraw(frameInfo.commandBuffer, 6, count, 0, 0);
 }
@@ -2,6 +2,9 @@
 
 #include "game/lve_camera.hpp"
 #include "game/lve_game_object.hpp"
+#include "systems/light_cluster_system.hpp"
+
+#include "utils/radix_sort.h"
 
 #include "vulkan/vulkan-device.hpp"
 #include "vulkan/vulkan-frame-info.hpp"
@@ -23,14 +26,32 @@ class PointLightSystem {
   PointLightSystem(const PointLightSystem &) = delete;
   PointLightSystem &operator=(const PointLightSystem &) = delete;
 
+  // Gathers the lights and bins them into clusters for the lit shaders
   void update(FrameInfo &frameInfo, GlobalUbo &ubo);
+  // Draws a billboard for every light gathered by update, back to front, in
+  // one instanced draw
   void render(FrameInfo &frameInfo);
 
+  // Index of the light in this frame's light buffer, -1 if it isn't one
+  int getLightIndex(LveGameObject::id_t id) const;
+
  private:
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
   void createPipeline(VkRenderPass renderPass);
 
   VKDeviceManager& m_device;
+  LightClusterSystem m_clusters;
+  std::vector<PointLight> m_lights;
+  std::vector<LveGameObject::id_t> m_lightIds;
+
+  // Per-instance vertex data for point_light.vert
+  struct Billboard {
+    glm::vec4 position{};  // w is the billboard radius
+    glm::vec4 color{};  // w is intensity
+  };
+  std::vector<Billboard> m_billboards;
+  std::vector<float> m_distances;
+  RadixSorter m_sorter;
 
   std::unique_ptr<VulkanPipeline> m_pipeline;
   VkPipelineLayout pipelineLayout;
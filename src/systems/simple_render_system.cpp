@@ -1,5 +1,7 @@
 #include "simple_render_system.hpp"
+#include "systems/impostor_system.hpp"
 #include "vulkan/vulkan-swapchain.hpp"
+#include "vulkan/vulkan-textures.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -8,14 +10,19 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
 
+// 116 bytes, inside the 128 every device guarantees
 struct SimplePushConstantData {
+    // Includes the model's position dequantization
     glm::mat4 modelMatrix{1.f};
-    glm::mat4 normalMatrix{1.f};
+    // xyz: columns of the normal matrix, w: model colour
+    glm::vec4 normalMatrix[3];
     int32_t tex_id;
 };
 
@@ -23,7 +30,7 @@ SimpleRenderSystem::SimpleRenderSystem(
     VKDeviceManager& device,
     VkRenderPass renderPass,
     VkDescriptorSetLayout globalSetLayout
-    ) : m_device(device), m_descriptorSet()
+    ) : m_device(device)
 {
     createPipelineLayout(globalSetLayout);
     createPipeline(renderPass);
@@ -31,7 +38,6 @@ SimpleRenderSystem::SimpleRenderSystem(
 
 SimpleRenderSystem::~SimpleRenderSystem() {
     vkDestroyPipelineLayout(m_device.device(), pipelineLayout, nullptr);
-    delete m_descriptorWriter;
 }
 
 void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
@@ -40,7 +46,11 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLay
     pushConstantRange.offset = 0;
     pushConstantRange.size = sizeof(SimplePushConstantData);
 
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
+    // set 0: per-frame globals, set 1: bindless textures
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+        globalSetLayout,
+        m_device.textures().getDescriptorSetLayout()
+    };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -52,17 +62,6 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLay
         VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
     }
-
-    // auto layout = VK_DSL_Mgr::Builder(m_device)
-    //                   .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-    //                   .build();
-    // auto pool = VK_DP_Mgr::Builder(m_device)
-    //                 .setMaxSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-    //                 .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
-    //                 .build();
-    // m_descriptorWriter = new VKDescriptorWriter(*layout, *pool);
-    // //m_descriptorWriter->writeImage(1, nullptr);
-    // m_descriptorWriter->build(m_descriptorSet);
 }
 
 void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
@@ -79,47 +78,126 @@ void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
       "simple_shader.vert.spv",
       "simple_shader.frag.spv",
       pipelineConfig);
+
+  // Hedges fading into impostors: the same shader with its discard switched
+  // on, so everything else keeps early depth testing
+  const VkBool32 impostorFade = VK_TRUE;
+  VkSpecializationMapEntry fadeEntry{0, 0, sizeof(VkBool32)};
+  VkSpecializationInfo fadeSpecialization{};
+  fadeSpecialization.mapEntryCount = 1;
+  fadeSpecialization.pMapEntries = &fadeEntry;
+  fadeSpecialization.dataSize = sizeof(VkBool32);
+  fadeSpecialization.pData = &impostorFade;
+  pipelineConfig.fragmentSpecializationInfo = &fadeSpecialization;
+  m_fadePipeline = std::make_unique<VulkanPipeline>(
+      m_device,
+      "simple_shader.vert.spv",
+      "simple_shader.frag.spv",
+      pipelineConfig);
 }
 
-void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
+void SimpleRenderSystem::renderGameObjects(
+    FrameInfo& frameInfo,
+    const MazeVisibility* visibility,
+    const ImpostorSystem* impostors
+) {
     m_pipeline->bind(frameInfo.commandBuffer);
 
+    VkDescriptorSet descriptorSets[] = {
+        frameInfo.globalDescriptorSet,
+        m_device.textures().getDescriptorSet()
+    };
     vkCmdBindDescriptorSets(
         frameInfo.commandBuffer,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelineLayout,
         0,
-        1,
-        &frameInfo.globalDescriptorSet,
-        0,
-        nullptr);
-
+        2,
+        descriptorSets,
+        GLOBAL_DYNAMIC_OFFSET_COUNT,
+        frameInfo.globalOffsets.data());
+
+    // Screen-height fraction of a sphere is radius / (distance * tanHalfFov)
+    const float tanHalfFov = std::tan(frameInfo.camera.getHeightAngle() * 0.5f);
+    const glm::vec3 cameraPos = glm::vec3(frameInfo.camera.getPosition());
+
+    // Models share a handful of geometry pages, so buffers are only rebound
+    // when the page changes
+    uint32_t boundPage = UINT32_MAX;
     for (auto& kv : frameInfo.gameObjects) {
         auto& obj = kv.second;
         if (obj.model == nullptr) continue;
-        SimplePushConstantData push{};
-        push.modelMatrix = obj.transform.mat4;
-        push.normalMatrix = obj.transform.normalMatrix;
-        push.tex_id = obj.model->texture_id;
-
-        vkCmdPushConstants(
-            frameInfo.commandBuffer,
-            pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            0,
-            sizeof(SimplePushConstantData),
-            &push);
-
-        // // for image:
-        // VkDescriptorImageInfo imageInfo{
-        //     obj.model->textureSampler,
-        //     obj.model->textureImageView,
-        //     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-        // };
-        // m_descriptorWriter->writeImage(1, &imageInfo /* image pointer */);
-        // m_descriptorWriter->build(m_descriptorSet);
+        if (visibility && !visibility->isVisible(kv.first)) continue;
+        if (impostors && impostors->fadesOut(kv.first)) continue;
+        drawObject(frameInfo, obj, cameraPos, tanHalfFov, boundPage);
+    }
+
+    if (impostors == nullptr) {
+        return;
+    }
+    // Same layout, so the descriptor sets stay bound
+    m_fadePipeline->bind(frameInfo.commandBuffer);
+    for (LveGameObject::id_t id : impostors->getFadingBatches()) {
+        if (impostors->isReplaced(id)) continue;
+        if (visibility && !visibility->isVisible(id)) continue;
+        auto it = frameInfo.gameObjects.find(id);
+        if (it == frameInfo.gameObjects.end() || it->second.model == nullptr) continue;
+        drawObject(frameInfo, it->second, cameraPos, tanHalfFov, boundPage);
+    }
+}
+
+void SimpleRenderSystem::drawObject(
+    FrameInfo& frameInfo,
+    LveGameObject& obj,
+    const glm::vec3& cameraPos,
+    float tanHalfFov,
+    uint32_t& boundPage
+) {
+    SimplePushConstantData push{};
+    const glm::vec3& color = obj.model->getColor();
+    push.modelMatrix = obj.model->getPositionMatrix(obj.transform.mat4);
+    for (int i = 0; i < 3; i++) {
+        push.normalMatrix[i] = glm::vec4(obj.transform.normalMatrix[i], color[i]);
+    }
+    push.tex_id = obj.model->texture_id;
+
+    vkCmdPushConstants(
+        frameInfo.commandBuffer,
+        pipelineLayout,
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        0,
+        sizeof(SimplePushConstantData),
+        &push);
 
+    if (obj.model->getGeometryPage() != boundPage) {
         obj.model->bind(frameInfo.commandBuffer);
-        obj.model->draw(frameInfo.commandBuffer);
+        boundPage = obj.model->getGeometryPage();
+    }
+    obj.lodLevel = selectLod(obj, cameraPos, tanHalfFov);
+    obj.model->draw(frameInfo.commandBuffer, obj.lodLevel);
+}
+
+uint32_t SimpleRenderSystem::selectLod(
+    const LveGameObject& obj,
+    const glm::vec3& cameraPos,
+    float tanHalfFov
+) const {
+    const VKModel& model = *obj.model;
+    if (model.getLodCount() <= 1) {
+        return 0;
+    }
+
+    const glm::mat4& m = obj.transform.mat4;
+    glm::vec3 center = glm::vec3(m * glm::vec4(model.getBoundsCenter(), 1.f));
+    float maxScale = std::max({
+        glm::length(glm::vec3(m[0])),
+        glm::length(glm::vec3(m[1])),
+        glm::length(glm::vec3(m[2]))});
+    float radius = model.getBoundsRadius() * maxScale;
+
+    float distance = glm::length(center - cameraPos);
+    if (distance <= radius) {
+        return 0;
     }
+    return model.selectLod(radius / (distance * tanHalfFov), obj.lodLevel);
 }
@@ -2,6 +2,7 @@
 
 #include "game/lve_camera.hpp"
 #include "game/lve_game_object.hpp"
+#include "game/maze_visibility.hpp"
 
 #include "vulkan/vulkan-descriptors.hpp"
 #include "vulkan/vulkan-device.hpp"
@@ -12,6 +13,8 @@
 #include <memory>
 #include <vector>
 
+class ImpostorSystem;
+
 class SimpleRenderSystem {
 public:
     SimpleRenderSystem(
@@ -24,17 +27,30 @@ public:
     SimpleRenderSystem(const SimpleRenderSystem &) = delete;
     SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
-    void renderGameObjects(FrameInfo &frameInfo);
+    // Skips maze walls outside visibility's current PVS, if given. With
+    // impostors, their hedge batches are drawn last with the pipeline that
+    // dithers out towards the impostors, or not at all once fully replaced.
+    void renderGameObjects(
+        FrameInfo &frameInfo,
+        const MazeVisibility* visibility = nullptr,
+        const ImpostorSystem* impostors = nullptr);
 
 private:
     void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
     void createPipeline(VkRenderPass renderPass);
+    // LOD for obj from its projected size, given the previous frame's choice
+    uint32_t selectLod(const LveGameObject& obj, const glm::vec3& cameraPos, float tanHalfFov) const;
+    void drawObject(
+        FrameInfo &frameInfo,
+        LveGameObject& obj,
+        const glm::vec3& cameraPos,
+        float tanHalfFov,
+        uint32_t& boundPage);
 
     VKDeviceManager& m_device;
 
     std::unique_ptr<VulkanPipeline> m_pipeline;
+    // simple_shader.frag with IMPOSTOR_FADE set
+    std::unique_ptr<VulkanPipeline> m_fadePipeline;
     VkPipelineLayout pipelineLayout;
-
-    VKDescriptorWriter *m_descriptorWriter;
-    VkDescriptorSet m_descriptorSet;
 };
@@ -0,0 +1,332 @@
+#include "sun_shadow_system.hpp"
+#include "vulkan/vulkan-swapchain.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// World y grows downwards: the floor sits at y = 1 and the hedges reach up
+// to about y = -1. Tile frusta cover this slab.
+static constexpr float SHADOW_SLAB_TOP = -2.f;
+static constexpr float SHADOW_SLAB_BOTTOM = 1.5f;
+// Extra world units around each tile so filtering at its edges stays inside
+static constexpr float TILE_PADDING = 0.5f;
+// How far behind the dynamic casters their shadows are captured
+static constexpr float DYNAMIC_SHADOW_REACH = 4.f;
+
+static_assert(SunShadowSystem::TILE_COUNT == SHADOW_TILE_COUNT, "GlobalUbo tile count mismatch");
+
+struct ShadowPushConstants {
+  glm::mat4 lightModelMatrix{1.f};
+};
+
+// Bounding sphere of an object in world space
+static void worldBounds(const LveGameObject& obj, glm::vec3& center, float& radius) {
+  const glm::mat4& m = obj.transform.mat4;
+  center = glm::vec3(m * glm::vec4(obj.model->getBoundsCenter(), 1.f));
+  float maxScale = std::max({
+      glm::length(glm::vec3(m[0])),
+      glm::length(glm::vec3(m[1])),
+      glm::length(glm::vec3(m[2]))});
+  radius = obj.model->getBoundsRadius() * maxScale;
+}
+
+// Sphere against the clip volume of viewProj (0 <= z <= w)
+static bool sphereInFrustum(const glm::mat4& viewProj, const glm::vec3& center, float radius) {
+  glm::vec4 rowX(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+  glm::vec4 rowY(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+  glm::vec4 rowZ(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+  glm::vec4 rowW(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+  const glm::vec4 planes[6] = {
+      rowW + rowX, rowW - rowX, rowW + rowY, rowW - rowY, rowZ, rowW - rowZ};
+  for (const glm::vec4& plane : planes) {
+    float length = glm::length(glm::vec3(plane));
+    if (length == 0.f) return false;
+    if ((glm::dot(glm::vec3(plane), center) + plane.w) / length < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static glm::vec3 upFor(const glm::vec3& direction) {
+  return std::abs(direction.z) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 0.f, 1.f);
+}
+
+SunShadowSystem::SunShadowSystem(VKDeviceManager& device, const glm::vec4& footprint)
+  : m_device(device),
+    m_atlas(device, TILES_PER_SIDE, TILE_SIZE, DYNAMIC_MAP_SIZE, VKSwapChain::MAX_FRAMES_IN_FLIGHT),
+    m_footprint(footprint)
+{
+  createPipelineLayout();
+  createPipeline();
+}
+
+SunShadowSystem::~SunShadowSystem() {
+  vkDestroyPipelineLayout(m_device.device(), pipelineLayout, nullptr);
+}
+
+void SunShadowSystem::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(ShadowPushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 0;
+  pipelineLayoutInfo.pSetLayouts = nullptr;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+}
+
+void SunShadowSystem::createPipeline() {
+  assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+  PipelineConfigInfo pipelineConfig{};
+  VulkanPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  // Depth only
+  pipelineConfig.colorBlendInfo.attachmentCount = 0;
+  pipelineConfig.colorBlendInfo.pAttachments = nullptr;
+  // Hedges are mirrored (negative scale), so draw both faces
+  pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+  pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+  pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 1.25f;
+  pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 1.75f;
+  pipelineConfig.renderPass = m_atlas.getRenderPass();
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  m_pipeline = std::make_unique<VulkanPipeline>(
+      m_device,
+      "shadow.vert.spv",
+      "shadow.frag.spv",
+      pipelineConfig);
+}
+
+void SunShadowSystem::registerStaticCaster(LveGameObject::id_t id) {
+  m_pendingStatic.push_back(id);
+}
+
+void SunShadowSystem::registerDynamicCaster(LveGameObject::id_t id) {
+  if (std::find(m_dynamicCasters.begin(), m_dynamicCasters.end(), id) == m_dynamicCasters.end()) {
+    m_dynamicCasters.push_back(id);
+  }
+}
+
+void SunShadowSystem::unregisterCaster(LveGameObject::id_t id) {
+  auto it = m_staticCasters.find(id);
+  if (it != m_staticCasters.end()) {
+    m_dirtyTiles |= it->second;
+    m_staticCasters.erase(it);
+  }
+  m_pendingStatic.erase(
+      std::remove(m_pendingStatic.begin(), m_pendingStatic.end(), id),
+      m_pendingStatic.end());
+  m_dynamicCasters.erase(
+      std::remove(m_dynamicCasters.begin(), m_dynamicCasters.end(), id),
+      m_dynamicCasters.end());
+}
+
+uint32_t SunShadowSystem::tileAt(float x, float z) const {
+  auto axis = [](float value, float origin, float size) {
+    int tile = static_cast<int>(std::floor((value - origin) / size * TILES_PER_SIDE));
+    return static_cast<uint32_t>(std::clamp(tile, 0, int(TILES_PER_SIDE) - 1));
+  };
+  return axis(z, m_footprint.y, m_footprint.w) * TILES_PER_SIDE + axis(x, m_footprint.x, m_footprint.z);
+}
+
+void SunShadowSystem::updateTileMatrices(const glm::vec3& sunPosition) {
+  const float tileWidth = m_footprint.z / TILES_PER_SIDE;
+  const float tileDepth = m_footprint.w / TILES_PER_SIDE;
+
+  for (uint32_t tile = 0; tile < TILE_COUNT; tile++) {
+    float x0 = m_footprint.x + (tile % TILES_PER_SIDE) * tileWidth - TILE_PADDING;
+    float z0 = m_footprint.y + (tile / TILES_PER_SIDE) * tileDepth - TILE_PADDING;
+    float x1 = x0 + tileWidth + 2.f * TILE_PADDING;
+    float z1 = z0 + tileDepth + 2.f * TILE_PADDING;
+
+    glm::vec3 target(0.5f * (x0 + x1), SHADOW_SLAB_BOTTOM, 0.5f * (z0 + z1));
+    glm::mat4 view = glm::lookAt(sunPosition, target, upFor(glm::normalize(target - sunPosition)));
+
+    // Tightest off-centre frustum around the tile's slab
+    float left = std::numeric_limits<float>::max(), right = -left;
+    float bottom = left, top = -left;
+    float nearest = left, farthest = 0.f;
+    for (int corner = 0; corner < 8; corner++) {
+      glm::vec3 world(
+          corner & 1 ? x1 : x0,
+          corner & 2 ? SHADOW_SLAB_BOTTOM : SHADOW_SLAB_TOP,
+          corner & 4 ? z1 : z0);
+      glm::vec3 v = glm::vec3(view * glm::vec4(world, 1.f));
+      float depth = -v.z;
+      nearest = std::min(nearest, depth);
+      farthest = std::max(farthest, depth);
+      if (depth > 0.f) {
+        left = std::min(left, v.x / depth);
+        right = std::max(right, v.x / depth);
+        bottom = std::min(bottom, v.y / depth);
+        top = std::max(top, v.y / depth);
+      }
+    }
+
+    // The sun is inside the slab; no usable projection for this tile
+    if (nearest <= 0.1f) {
+      m_tileMatrices[tile] = glm::mat4(0.f);
+      continue;
+    }
+    float zNear = std::max(nearest - 1.f, 0.1f);
+    float zFar = farthest + 1.f;
+    glm::mat4 projection = glm::frustum(
+        left * zNear, right * zNear, bottom * zNear, top * zNear, zNear, zFar);
+    m_tileMatrices[tile] = projection * view;
+  }
+}
+
+uint32_t SunShadowSystem::tilesTouchedBy(const LveGameObject& obj) const {
+  if (obj.model == nullptr) {
+    return 0;
+  }
+  glm::vec3 center;
+  float radius;
+  worldBounds(obj, center, radius);
+
+  uint32_t tiles = 0;
+  for (uint32_t tile = 0; tile < TILE_COUNT; tile++) {
+    if (sphereInFrustum(m_tileMatrices[tile], center, radius)) {
+      tiles |= 1u << tile;
+    }
+  }
+  return tiles;
+}
+
+void SunShadowSystem::drawCaster(
+    VkCommandBuffer commandBuffer,
+    const LveGameObject& obj,
+    const glm::mat4& lightViewProj,
+    uint32_t& boundPage
+) {
+  ShadowPushConstants push{};
+  push.lightModelMatrix = lightViewProj * obj.model->getPositionMatrix(obj.transform.mat4);
+  vkCmdPushConstants(
+      commandBuffer,
+      pipelineLayout,
+      VK_SHADER_STAGE_VERTEX_BIT,
+      0,
+      sizeof(ShadowPushConstants),
+      &push);
+
+  if (obj.model->getGeometryPage() != boundPage) {
+    obj.model->bind(commandBuffer);
+    boundPage = obj.model->getGeometryPage();
+  }
+  obj.model->draw(commandBuffer);
+}
+
+void SunShadowSystem::render(FrameInfo& frameInfo, GlobalUbo& ubo) {
+  m_tilesRenderedLastFrame = 0;
+  ubo.sunDynamicMatrix = glm::mat4(0.f);
+  ubo.sunTileRect = glm::vec4(
+      m_footprint.x, m_footprint.y,
+      m_footprint.z / TILES_PER_SIDE, m_footprint.w / TILES_PER_SIDE);
+
+  auto sunIt = m_sunId ? frameInfo.gameObjects.find(*m_sunId) : frameInfo.gameObjects.end();
+  if (sunIt == frameInfo.gameObjects.end()) {
+    for (glm::mat4& matrix : ubo.sunTileMatrices) {
+      matrix = glm::mat4(0.f);
+    }
+    return;
+  }
+
+  // A moving sun invalidates every tile
+  const glm::vec3 sunPosition = sunIt->second.transform.translation;
+  if (!m_sunPosition || glm::length(*m_sunPosition - sunPosition) > 1e-4f) {
+    m_sunPosition = sunPosition;
+    updateTileMatrices(sunPosition);
+    for (auto& [id, tiles] : m_staticCasters) {
+      auto it = frameInfo.gameObjects.find(id);
+      tiles = it == frameInfo.gameObjects.end() ? 0 : tilesTouchedBy(it->second);
+    }
+    invalidateAll();
+  }
+
+  for (LveGameObject::id_t id : m_pendingStatic) {
+    auto it = frameInfo.gameObjects.find(id);
+    if (it == frameInfo.gameObjects.end()) continue;
+    uint32_t tiles = tilesTouchedBy(it->second);
+    m_staticCasters[id] = tiles;
+    m_dirtyTiles |= tiles;
+  }
+  m_pendingStatic.clear();
+
+  VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+  uint32_t boundPage = UINT32_MAX;
+
+  // Static tiles, only the dirty ones
+  if (m_dirtyTiles != 0) {
+    m_atlas.beginStaticPass(commandBuffer);
+    m_pipeline->bind(commandBuffer);
+    for (uint32_t tile = 0; tile < TILE_COUNT; tile++) {
+      if (!(m_dirtyTiles & (1u << tile))) continue;
+      m_atlas.beginTile(commandBuffer, tile);
+      for (const auto& [id, tiles] : m_staticCasters) {
+        if (!(tiles & (1u << tile))) continue;
+        auto it = frameInfo.gameObjects.find(id);
+        if (it == frameInfo.gameObjects.end() || it->second.model == nullptr) continue;
+        drawCaster(commandBuffer, it->second, m_tileMatrices[tile], boundPage);
+      }
+      m_tilesRenderedLastFrame++;
+    }
+    m_atlas.endPass(commandBuffer);
+    m_dirtyTiles = 0;
+  }
+
+  // Dynamic casters: one frustum around all of them
+  glm::vec3 minCorner(std::numeric_limits<float>::max());
+  glm::vec3 maxCorner(-std::numeric_limits<float>::max());
+  bool anyDynamic = false;
+  for (LveGameObject::id_t id : m_dynamicCasters) {
+    auto it = frameInfo.gameObjects.find(id);
+    if (it == frameInfo.gameObjects.end() || it->second.model == nullptr) continue;
+    glm::vec3 center;
+    float radius;
+    worldBounds(it->second, center, radius);
+    minCorner = glm::min(minCorner, center - radius);
+    maxCorner = glm::max(maxCorner, center + radius);
+    anyDynamic = true;
+  }
+  if (anyDynamic) {
+    glm::vec3 center = 0.5f * (minCorner + maxCorner);
+    float radius = 0.5f * glm::length(maxCorner - minCorner) * 1.1f;
+    float distance = glm::length(center - sunPosition);
+    if (distance > radius + 0.1f) {
+      glm::mat4 view = glm::lookAt(sunPosition, center, upFor((center - sunPosition) / distance));
+      float fov = 2.f * std::asin(radius / distance);
+      glm::mat4 projection = glm::perspective(
+          fov, 1.f, distance - radius, distance + radius + DYNAMIC_SHADOW_REACH);
+      ubo.sunDynamicMatrix = projection * view;
+
+      m_atlas.beginDynamicPass(commandBuffer, frameInfo.frameIndex);
+      m_pipeline->bind(commandBuffer);
+      for (LveGameObject::id_t id : m_dynamicCasters) {
+        auto it = frameInfo.gameObjects.find(id);
+        if (it == frameInfo.gameObjects.end() || it->second.model == nullptr) continue;
+        drawCaster(commandBuffer, it->second, ubo.sunDynamicMatrix, boundPage);
+      }
+      m_atlas.endPass(commandBuffer);
+    }
+  }
+
+  std::copy(m_tileMatrices.begin(), m_tileMatrices.end(), ubo.sunTileMatrices);
+}
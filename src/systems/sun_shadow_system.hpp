@@ -0,0 +1,97 @@
+#pragma once
+
+#include "game/lve_game_object.hpp"
+
+#include "vulkan/vulkan-device.hpp"
+#include "vulkan/vulkan-frame-info.hpp"
+#include "vulkan/vulkan-pipeline.hpp"
+#include "vulkan/vulkan-shadow-atlas.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Shadows from the sun point light, split into a static and a dynamic part.
+//
+// The maze footprint is divided into TILES_PER_SIDE^2 tiles, one per
+// MazeBlock of Maze's 3x3 grid. Each tile gets its own light frustum (from the
+// sun through the tile's box) and its own region of a persistent depth
+// atlas. Static casters are rendered into the tiles they overlap once and
+// then left alone: a tile is only re-rendered when a caster in it is
+// registered or unregistered (i.e. its maze block changed), when it is
+// invalidated explicitly, or when the sun moves.
+//
+// Dynamic casters (the ball) go into a small per-frame map with a tight
+// frustum around them; the lit shader combines both lookups.
+class SunShadowSystem {
+ public:
+  static constexpr uint32_t TILES_PER_SIDE = 3;
+  static constexpr uint32_t TILE_COUNT = TILES_PER_SIDE * TILES_PER_SIDE;
+  static constexpr uint32_t TILE_SIZE = 1024;
+  static constexpr uint32_t DYNAMIC_MAP_SIZE = 512;
+
+  // footprint: xy = world xz of the maze's min corner, zw = its size
+  SunShadowSystem(VKDeviceManager& device, const glm::vec4& footprint);
+  ~SunShadowSystem();
+
+  SunShadowSystem(const SunShadowSystem &) = delete;
+  SunShadowSystem &operator=(const SunShadowSystem &) = delete;
+
+  void setSun(LveGameObject::id_t id) { m_sunId = id; }
+
+  void registerStaticCaster(LveGameObject::id_t id);
+  void registerDynamicCaster(LveGameObject::id_t id);
+  // Dirties the tiles a static caster was in
+  void unregisterCaster(LveGameObject::id_t id);
+
+  // Tile index of a world position, e.g. to invalidate a regenerated block
+  uint32_t tileAt(float x, float z) const;
+  void invalidateTile(uint32_t tile) { m_dirtyTiles |= 1u << tile; }
+  void invalidateAll() { m_dirtyTiles = (1u << TILE_COUNT) - 1; }
+
+  // Re-renders dirty tiles and the dynamic map into commandBuffer (outside
+  // any render pass) and fills the sun shadow fields of ubo
+  void render(FrameInfo &frameInfo, GlobalUbo &ubo);
+
+  uint32_t getTilesRenderedLastFrame() const { return m_tilesRenderedLastFrame; }
+
+  VkDescriptorImageInfo staticMapInfo() { return m_atlas.staticImageInfo(); }
+  VkDescriptorImageInfo dynamicMapInfo(int frameIndex) { return m_atlas.dynamicImageInfo(frameIndex); }
+
+ private:
+  void createPipelineLayout();
+  void createPipeline();
+
+  void updateTileMatrices(const glm::vec3& sunPosition);
+  uint32_t tilesTouchedBy(const LveGameObject& obj) const;
+  void drawCaster(
+      VkCommandBuffer commandBuffer,
+      const LveGameObject& obj,
+      const glm::mat4& lightViewProj,
+      uint32_t& boundPage);
+
+  VKDeviceManager& m_device;
+  VKShadowAtlas m_atlas;
+  glm::vec4 m_footprint;
+
+  std::unique_ptr<VulkanPipeline> m_pipeline;
+  VkPipelineLayout pipelineLayout;
+
+  std::optional<LveGameObject::id_t> m_sunId;
+  std::optional<glm::vec3> m_sunPosition;
+  std::array<glm::mat4, TILE_COUNT> m_tileMatrices{};
+
+  // Static caster -> bitmask of the tiles it overlaps
+  std::unordered_map<LveGameObject::id_t, uint32_t> m_staticCasters;
+  std::vector<LveGameObject::id_t> m_pendingStatic;
+  std::vector<LveGameObject::id_t> m_dynamicCasters;
+  uint32_t m_dirtyTiles = 0;
+  uint32_t m_tilesRenderedLastFrame = 0;
+};
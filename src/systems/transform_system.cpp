@@ -0,0 +1,62 @@
+#include "transform_system.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+void TransformSystem::registerDynamic(LveGameObject::id_t id) {
+  if (std::find(m_dynamic_ids.begin(), m_dynamic_ids.end(), id) == m_dynamic_ids.end()) {
+    m_dynamic_ids.push_back(id);
+  }
+}
+
+void TransformSystem::unregisterDynamic(LveGameObject::id_t id) {
+  m_dynamic_ids.erase(
+      std::remove(m_dynamic_ids.begin(), m_dynamic_ids.end(), id),
+      m_dynamic_ids.end());
+}
+
+size_t TransformSystem::update(LveGameObject::Map& gameObjects) {
+  // Gather
+  m_dirty.clear();
+  for (int axis = 0; axis < 3; axis++) {
+    m_angles[axis].clear();
+  }
+  for (LveGameObject::id_t id : m_dynamic_ids) {
+    auto it = gameObjects.find(id);
+    if (it == gameObjects.end() || !it->second.transform.dirty) continue;
+
+    TransformComponent& transform = it->second.transform;
+    m_dirty.push_back(&transform);
+    m_angles[0].push_back(transform.rotation.x);
+    m_angles[1].push_back(transform.rotation.y);
+    m_angles[2].push_back(transform.rotation.z);
+  }
+
+  const size_t count = m_dirty.size();
+  if (count == 0) {
+    return 0;
+  }
+
+  // Trig is the expensive part, so do it over contiguous arrays
+  for (int axis = 0; axis < 3; axis++) {
+    m_sin[axis].resize(count);
+    m_cos[axis].resize(count);
+    const float* angles = m_angles[axis].data();
+    float* sins = m_sin[axis].data();
+    float* coss = m_cos[axis].data();
+    for (size_t i = 0; i < count; i++) {
+      sins[i] = std::sin(angles[i]);
+      coss[i] = std::cos(angles[i]);
+    }
+  }
+
+  // Compose and scatter
+  for (size_t i = 0; i < count; i++) {
+    m_dirty[i]->compose_matrices(
+        glm::vec3(m_sin[0][i], m_sin[1][i], m_sin[2][i]),
+        glm::vec3(m_cos[0][i], m_cos[1][i], m_cos[2][i]));
+  }
+
+  return count;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "game/lve_game_object.hpp"
+
+// std
+#include <vector>
+
+// Recomputes model/normal matrices once per frame for the objects that moved.
+//
+// Static objects (walls, hedges, floor) compute their matrices once at load
+// time and are never registered, so they cost nothing per frame. Registered
+// objects are only recomputed when their transform is marked dirty; the
+// trig for all of them is done in one pass over SoA arrays so it vectorizes.
+class TransformSystem {
+ public:
+  TransformSystem() = default;
+  ~TransformSystem() = default;
+
+  TransformSystem(const TransformSystem &) = delete;
+  TransformSystem &operator=(const TransformSystem &) = delete;
+
+  void registerDynamic(LveGameObject::id_t id);
+  void unregisterDynamic(LveGameObject::id_t id);
+
+  // Returns the number of transforms that were recomputed
+  size_t update(LveGameObject::Map& gameObjects);
+
+ private:
+  std::vector<LveGameObject::id_t> m_dynamic_ids;
+
+  // Scratch space, kept around so the per-frame pass doesn't allocate
+  std::vector<TransformComponent*> m_dirty;
+  std::vector<float> m_angles[3];
+  std::vector<float> m_sin[3];
+  std::vector<float> m_cos[3];
+};
@@ -0,0 +1,119 @@
+#include "upscale_system.hpp"
+#include "vulkan/vulkan-swapchain.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+struct UpscalePushConstants {
+  glm::vec2 uvScale;  // swap chain uv -> scene image uv
+  glm::vec2 uvMax;    // last drawn texel centre, so filtering stays inside
+};
+
+UpscaleSystem::UpscaleSystem(VKDeviceManager& device, VkRenderPass renderPass)
+  : m_device(device), m_sets(VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+{
+  createDescriptorSets();
+  createPipelineLayout();
+  createPipeline(renderPass);
+}
+
+UpscaleSystem::~UpscaleSystem() {
+  vkDestroyPipelineLayout(m_device.device(), pipelineLayout, nullptr);
+}
+
+void UpscaleSystem::createDescriptorSets() {
+  m_setLayout =
+      VK_DSL_Mgr::Builder(m_device)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+          .build();
+  m_pool =
+      VK_DP_Mgr::Builder(m_device)
+          .setMaxSets(VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+          .build();
+  for (VkDescriptorSet& set : m_sets) {
+    if (!m_pool->allocateDescriptor(m_setLayout->getDescriptorSetLayout(), set)) {
+      throw std::runtime_error("failed to allocate upscale descriptor set!");
+    }
+  }
+}
+
+void UpscaleSystem::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(UpscalePushConstants);
+
+  VkDescriptorSetLayout setLayout = m_setLayout->getDescriptorSetLayout();
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+}
+
+void UpscaleSystem::createPipeline(VkRenderPass renderPass) {
+  assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+  PipelineConfigInfo pipelineConfig{};
+  VulkanPipeline::defaultPipelineConfigInfo(pipelineConfig);
+  // The triangle comes from gl_VertexIndex and covers everything
+  pipelineConfig.bindingDescriptions.clear();
+  pipelineConfig.attributeDescriptions.clear();
+  pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+  pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+  pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+  pipelineConfig.renderPass = renderPass;
+  pipelineConfig.pipelineLayout = pipelineLayout;
+  m_pipeline = std::make_unique<VulkanPipeline>(
+      m_device,
+      "upscale.vert.spv",
+      "upscale.frag.spv",
+      pipelineConfig);
+}
+
+void UpscaleSystem::render(
+    FrameInfo &frameInfo,
+    VkDescriptorImageInfo scene,
+    VkExtent2D renderExtent,
+    VkExtent2D imageExtent
+) {
+  // The slot's fence has been waited on, so its set is free to rewrite
+  VkDescriptorSet& set = m_sets[frameInfo.frameIndex];
+  VKDescriptorWriter(*m_setLayout, *m_pool)
+      .writeImage(0, &scene)
+      .overwrite(set);
+
+  UpscalePushConstants push{};
+  glm::vec2 size(imageExtent.width, imageExtent.height);
+  push.uvScale = glm::vec2(renderExtent.width, renderExtent.height) / size;
+  push.uvMax = (glm::vec2(renderExtent.width, renderExtent.height) - 0.5f) / size;
+
+  m_pipeline->bind(frameInfo.commandBuffer);
+  vkCmdBindDescriptorSets(
+      frameInfo.commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipelineLayout,
+      0,
+      1,
+      &set,
+      0,
+      nullptr);
+  vkCmdPushConstants(
+      frameInfo.commandBuffer,
+      pipelineLayout,
+      VK_SHADER_STAGE_FRAGMENT_BIT,
+      0,
+      sizeof(UpscalePushConstants),
+      &push);
+  vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+}
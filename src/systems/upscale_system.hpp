@@ -0,0 +1,45 @@
+#pragma once
+
+#include "vulkan/vulkan-descriptors.hpp"
+#include "vulkan/vulkan-device.hpp"
+#include "vulkan/vulkan-frame-info.hpp"
+#include "vulkan/vulkan-pipeline.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+// Stretches the scene, drawn at a reduced size into VKSceneTarget, over the
+// whole swap chain image with one bilinear fullscreen triangle.
+class UpscaleSystem {
+ public:
+  UpscaleSystem(VKDeviceManager& device, VkRenderPass renderPass);
+  ~UpscaleSystem();
+
+  UpscaleSystem(const UpscaleSystem &) = delete;
+  UpscaleSystem &operator=(const UpscaleSystem &) = delete;
+
+  // Inside the swap chain pass. scene is this frame's color image, of which
+  // only [0, renderExtent) out of imageExtent was drawn.
+  void render(
+      FrameInfo &frameInfo,
+      VkDescriptorImageInfo scene,
+      VkExtent2D renderExtent,
+      VkExtent2D imageExtent);
+
+ private:
+  void createDescriptorSets();
+  void createPipelineLayout();
+  void createPipeline(VkRenderPass renderPass);
+
+  VKDeviceManager& m_device;
+
+  std::unique_ptr<VK_DSL_Mgr> m_setLayout;
+  std::unique_ptr<VK_DP_Mgr> m_pool;
+  // Per frame in flight; rewritten every frame since the scene target is
+  // recreated with the swap chain
+  std::vector<VkDescriptorSet> m_sets;
+
+  std::unique_ptr<VulkanPipeline> m_pipeline;
+  VkPipelineLayout pipelineLayout;
+};
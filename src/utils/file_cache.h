@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Shared by the on-disk caches (pipelines, impostors, textures, meshes):
+// the hash they key and checksum with, and the write that swaps a finished
+// file in so a crash mid-write can't leave a half-written one behind.
+
+// FNV-1a; pass the previous result as hash to continue over more bytes
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// A run of bytes written after the header
+struct FileBlob {
+  const void* data;
+  size_t size;
+};
+
+// Writes header and then blobs to path + ".tmp" and renames it over path,
+// creating path's directory first. Failures go to std::cerr prefixed with
+// name (e.g. "mesh cache") and leave any existing file at path alone.
+template <typename Header>
+bool writeFileAtomically(
+    const char* name,
+    const std::string& path,
+    const Header& header,
+    const std::vector<FileBlob>& blobs = {}
+) {
+  static_assert(std::is_trivially_copyable_v<Header>, "headers are written as raw bytes");
+
+  std::error_code ec;
+  const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+  if (!parent.empty()) {
+    std::filesystem::create_directories(parent, ec);
+  }
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+      std::cerr << name << ": failed to write " << tmpPath << std::endl;
+      return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const FileBlob& blob : blobs) {
+      file.write(static_cast<const char*>(blob.data), blob.size);
+    }
+    file.close();
+    if (!file) {
+      std::cerr << name << ": failed to write " << tmpPath << std::endl;
+      std::filesystem::remove(tmpPath, ec);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    std::cerr << name << ": failed to save: " << ec.message() << std::endl;
+    return false;
+  }
+  return true;
+}
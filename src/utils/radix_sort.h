@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Sorts indices by float key. The scratch arrays are kept between calls, so
+// sorting every frame does not allocate once it has seen its largest input.
+//
+// Small inputs use an insertion sort; larger ones an LSD radix sort over the
+// key bits (4 passes of 8 bits, skipping passes where every key has the same
+// byte). Both are stable.
+class RadixSorter {
+ public:
+  // Returns the indices [0, count) ordered by keys, ascending or descending
+  const std::vector<uint32_t>& sort(const float* keys, uint32_t count, bool descending = false) {
+    m_keys.resize(count);
+    m_order.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t bits = floatBits(keys[i]);
+      m_keys[i] = descending ? ~bits : bits;
+      m_order[i] = i;
+    }
+
+    if (count <= INSERTION_SORT_MAX) {
+      insertionSort(count);
+    } else {
+      radixSort(count);
+    }
+    return m_order;
+  }
+
+ private:
+  static constexpr uint32_t INSERTION_SORT_MAX = 32;
+
+  // Maps a float to a uint32 with the same ordering
+  static uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+  }
+
+  void insertionSort(uint32_t count) {
+    for (uint32_t i = 1; i < count; i++) {
+      uint32_t key = m_keys[i];
+      uint32_t index = m_order[i];
+      uint32_t j = i;
+      for (; j > 0 && m_keys[j - 1] > key; j--) {
+        m_keys[j] = m_keys[j - 1];
+        m_order[j] = m_order[j - 1];
+      }
+      m_keys[j] = key;
+      m_order[j] = index;
+    }
+  }
+
+  void radixSort(uint32_t count) {
+    m_keysScratch.resize(count);
+    m_orderScratch.resize(count);
+
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+      std::array<uint32_t, 256> histogram{};
+      for (uint32_t i = 0; i < count; i++) {
+        histogram[(m_keys[i] >> shift) & 0xff]++;
+      }
+      if (histogram[(m_keys[0] >> shift) & 0xff] == count) {
+        continue;
+      }
+
+      uint32_t offset = 0;
+      for (uint32_t& bucket : histogram) {
+        uint32_t size = bucket;
+        bucket = offset;
+        offset += size;
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        uint32_t slot = histogram[(m_keys[i] >> shift) & 0xff]++;
+        m_keysScratch[slot] = m_keys[i];
+        m_orderScratch[slot] = m_order[i];
+      }
+      m_keys.swap(m_keysScratch);
+      m_order.swap(m_orderScratch);
+    }
+  }
+
+  std::vector<uint32_t> m_keys;
+  std::vector<uint32_t> m_order;
+  std::vector<uint32_t> m_keysScratch;
+  std::vector<uint32_t> m_orderScratch;
+};
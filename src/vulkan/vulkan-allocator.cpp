@@ -0,0 +1,354 @@
+#include "vulkan-allocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment) {
+  return value / alignment * alignment;
+}
+
+VKMemoryAllocator::VKMemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice)
+    : m_device(device) {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+  m_maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+  m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+}
+
+VKMemoryAllocator::~VKMemoryAllocator() {
+  VKMemoryStats stats = getStats();
+  if (stats.allocationCount > 0) {
+    std::cerr << "VKMemoryAllocator: " << stats.allocationCount
+              << " allocations still live at shutdown" << std::endl;
+  }
+
+  for (Pool& pool : m_pools) {
+    for (auto& block : pool.blocks) {
+      if (block->mapped) {
+        vkUnmapMemory(m_device, block->memory);
+      }
+      vkFreeMemory(m_device, block->memory, nullptr);
+    }
+  }
+}
+
+uint32_t VKMemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool VKMemoryAllocator::isCoherent(uint32_t memoryTypeIndex) const {
+  return m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+VkDeviceSize VKMemoryAllocator::preferredBlockSize(uint32_t memoryTypeIndex) const {
+  uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+  // Small heaps (e.g. the 256MB host-visible BAR) get proportionally smaller blocks
+  return std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+}
+
+VKAllocation VKMemoryAllocator::allocate(
+    const VkMemoryRequirements &requirements,
+    VkMemoryPropertyFlags properties,
+    bool linear
+) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+  uint32_t poolIndex = memoryTypeIndex * 2 + (linear ? 0 : 1);
+
+  VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+  bool hostVisible = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  if (hostVisible && !isCoherent(memoryTypeIndex)) {
+    // Flushes get rounded out to whole atoms, so neighbours must not share one
+    alignment = std::max(alignment, m_nonCoherentAtomSize);
+  }
+
+  VKMemoryBlock* block = nullptr;
+  VkDeviceSize offset = 0;
+
+  VkDeviceSize blockSize = preferredBlockSize(memoryTypeIndex);
+  if (requirements.size > blockSize / 2) {
+    block = createBlock(poolIndex, memoryTypeIndex, requirements.size, true);
+    offset = 0;
+    block->freeRanges.clear();
+  } else {
+    for (auto& candidate : m_pools[poolIndex].blocks) {
+      if (!candidate->dedicated &&
+          suballocate(*candidate, requirements.size, alignment, offset)) {
+        block = candidate.get();
+        break;
+      }
+    }
+
+    if (!block) {
+      block = createBlock(poolIndex, memoryTypeIndex, blockSize, false);
+      bool fits = suballocate(*block, requirements.size, alignment, offset);
+      assert(fits && "Fresh memory block too small for allocation");
+    }
+  }
+
+  block->used += requirements.size;
+  block->allocationCount++;
+
+  VKAllocation allocation{};
+  allocation.memory = block->memory;
+  allocation.offset = offset;
+  allocation.size = requirements.size;
+  allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+  allocation.block = block;
+  return allocation;
+}
+
+void VKMemoryAllocator::free(VKAllocation &allocation) {
+  if (!allocation.isValid()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VKMemoryBlock* block = allocation.block;
+  assert(block && block->memory == allocation.memory && "Allocation does not belong to this allocator");
+
+  if (block->dedicated) {
+    destroyBlock(block);
+  } else {
+    releaseRange(*block, allocation.offset, allocation.size);
+    block->used -= allocation.size;
+    block->allocationCount--;
+
+    if (block->allocationCount == 0) {
+      uint32_t emptyBlocks = 0;
+      for (auto& other : m_pools[block->poolIndex].blocks) {
+        if (other->allocationCount == 0) {
+          emptyBlocks++;
+        }
+      }
+      if (emptyBlocks > MAX_EMPTY_BLOCKS_PER_POOL) {
+        destroyBlock(block);
+      }
+    }
+  }
+
+  allocation = VKAllocation{};
+}
+
+VKMemoryBlock* VKMemoryAllocator::createBlock(
+    uint32_t poolIndex,
+    uint32_t memoryTypeIndex,
+    VkDeviceSize size,
+    bool dedicated
+) {
+  if (m_liveDeviceAllocations >= m_maxAllocationCount) {
+    throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+  }
+
+  auto block = std::make_unique<VKMemoryBlock>();
+  block->size = size;
+  block->memoryTypeIndex = memoryTypeIndex;
+  block->poolIndex = poolIndex;
+  block->dedicated = dedicated;
+  block->freeRanges.emplace(0, size);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  if (vkAllocateMemory(m_device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate device memory block!");
+  }
+
+  if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(m_device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+      vkFreeMemory(m_device, block->memory, nullptr);
+      throw std::runtime_error("failed to map device memory block!");
+    }
+  }
+
+  m_liveDeviceAllocations++;
+  m_totalDeviceAllocations++;
+
+  VKMemoryBlock* result = block.get();
+  m_pools[poolIndex].blocks.push_back(std::move(block));
+  return result;
+}
+
+void VKMemoryAllocator::destroyBlock(VKMemoryBlock* block) {
+  auto& blocks = m_pools[block->poolIndex].blocks;
+  auto it = std::find_if(blocks.begin(), blocks.end(), [block](const auto& candidate) {
+    return candidate.get() == block;
+  });
+  assert(it != blocks.end() && "Memory block not found in its pool");
+
+  if (block->mapped) {
+    vkUnmapMemory(m_device, block->memory);
+  }
+  vkFreeMemory(m_device, block->memory, nullptr);
+  m_liveDeviceAllocations--;
+
+  blocks.erase(it);
+}
+
+bool VKMemoryAllocator::suballocate(
+    VKMemoryBlock &block,
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    VkDeviceSize &offset
+) {
+  for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+    VkDeviceSize rangeStart = it->first;
+    VkDeviceSize rangeEnd = it->first + it->second;
+    VkDeviceSize alignedStart = alignUp(rangeStart, alignment);
+    if (alignedStart + size > rangeEnd) {
+      continue;
+    }
+
+    block.freeRanges.erase(it);
+    // The alignment padding stays free and gets coalesced back on release
+    if (alignedStart > rangeStart) {
+      block.freeRanges.emplace(rangeStart, alignedStart - rangeStart);
+    }
+    if (alignedStart + size < rangeEnd) {
+      block.freeRanges.emplace(alignedStart + size, rangeEnd - (alignedStart + size));
+    }
+
+    offset = alignedStart;
+    return true;
+  }
+  return false;
+}
+
+void VKMemoryAllocator::releaseRange(VKMemoryBlock &block, VkDeviceSize offset, VkDeviceSize size) {
+  auto next = block.freeRanges.lower_bound(offset);
+
+  // Merge with the following free range
+  if (next != block.freeRanges.end() && offset + size == next->first) {
+    size += next->second;
+    next = block.freeRanges.erase(next);
+  }
+
+  // Merge with the preceding free range
+  if (next != block.freeRanges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+
+  block.freeRanges.emplace_hint(next, offset, size);
+}
+
+VkMappedMemoryRange VKMemoryAllocator::mappedRange(
+    const VKAllocation &allocation,
+    VkDeviceSize size,
+    VkDeviceSize offset
+) const {
+  VkDeviceSize start = allocation.offset + offset;
+  VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : start + size;
+
+  VkMappedMemoryRange range = {};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = allocation.memory;
+  range.offset = alignDown(start, m_nonCoherentAtomSize);
+  range.size = std::min(alignUp(end, m_nonCoherentAtomSize), allocation.block->size) - range.offset;
+  return range;
+}
+
+VkResult VKMemoryAllocator::flush(const VKAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+  if (isCoherent(allocation.block->memoryTypeIndex)) {
+    return VK_SUCCESS;
+  }
+  VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+  return vkFlushMappedMemoryRanges(m_device, 1, &range);
+}
+
+VkResult VKMemoryAllocator::invalidate(const VKAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+  if (isCoherent(allocation.block->memoryTypeIndex)) {
+    return VK_SUCCESS;
+  }
+  VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+  return vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+}
+
+bool VKMemoryAllocator::isRelocationCandidate(const VKAllocation &allocation, float maxBlockUsage) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const VKMemoryBlock* block = allocation.block;
+  if (!block || block->dedicated) {
+    return false;
+  }
+  return static_cast<float>(block->used) < maxBlockUsage * static_cast<float>(block->size);
+}
+
+uint32_t VKMemoryAllocator::releaseEmptyBlocks() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  uint32_t released = 0;
+  for (Pool& pool : m_pools) {
+    std::vector<VKMemoryBlock*> empty;
+    for (auto& block : pool.blocks) {
+      if (block->allocationCount == 0) {
+        empty.push_back(block.get());
+      }
+    }
+    for (VKMemoryBlock* block : empty) {
+      destroyBlock(block);
+      released++;
+    }
+  }
+  return released;
+}
+
+VKMemoryStats VKMemoryAllocator::getStats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  VKMemoryStats stats{};
+  stats.deviceAllocations = m_totalDeviceAllocations;
+  for (const Pool& pool : m_pools) {
+    for (const auto& block : pool.blocks) {
+      stats.blockCount++;
+      if (block->dedicated) {
+        stats.dedicatedBlockCount++;
+      }
+      stats.allocationCount += block->allocationCount;
+      stats.bytesReserved += block->size;
+      stats.bytesUsed += block->used;
+      for (const auto& [offset, size] : block->freeRanges) {
+        stats.largestFreeRange = std::max(stats.largestFreeRange, size);
+      }
+    }
+  }
+  return stats;
+}
+
+void VKMemoryAllocator::printStats(std::ostream &out) const {
+  constexpr double MiB = 1024.0 * 1024.0;
+  VKMemoryStats stats = getStats();
+  out << "GPU memory: " << stats.allocationCount << " allocations in "
+      << stats.blockCount << " blocks (" << stats.dedicatedBlockCount << " dedicated), "
+      << stats.bytesUsed / MiB << " / " << stats.bytesReserved / MiB << " MiB used, "
+      << "largest free range " << stats.largestFreeRange / MiB << " MiB, "
+      << stats.deviceAllocations << " vkAllocateMemory calls" << std::endl;
+}
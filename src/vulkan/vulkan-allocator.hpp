@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// One vkAllocateMemory'd chunk that is carved up between many resources
+struct VKMemoryBlock {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize size = 0;
+  VkDeviceSize used = 0;
+  uint32_t allocationCount = 0;
+  uint32_t memoryTypeIndex = 0;
+  uint32_t poolIndex = 0;
+  // Persistently mapped base pointer, null unless the memory type is host visible
+  void* mapped = nullptr;
+  // Holds exactly one oversized resource and is released together with it
+  bool dedicated = false;
+  // offset -> size, kept coalesced
+  std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+};
+
+// A sub-range of a memory block, handed out by VKMemoryAllocator. Resources
+// bind to (memory, offset) rather than owning a VkDeviceMemory of their own.
+struct VKAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // Points at offset within the block's persistent mapping, or null
+  void* mapped = nullptr;
+  VKMemoryBlock* block = nullptr;
+
+  bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+struct VKMemoryStats {
+  uint32_t blockCount = 0;
+  uint32_t dedicatedBlockCount = 0;
+  uint32_t allocationCount = 0;
+  VkDeviceSize bytesReserved = 0;
+  VkDeviceSize bytesUsed = 0;
+  VkDeviceSize largestFreeRange = 0;
+  // vkAllocateMemory calls over the allocator's lifetime
+  uint64_t deviceAllocations = 0;
+};
+
+// Block-based device memory sub-allocator.
+//
+// Memory is reserved from the driver in large blocks per memory type and
+// handed out with an alignment-aware first-fit free list. Buffers and
+// optimally tiled images are kept in separate pools so neighbours never need
+// to be padded out to bufferImageGranularity. Host-visible blocks are mapped
+// once when created and stay mapped until released.
+class VKMemoryAllocator {
+ public:
+  static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+  // Keep one empty block per pool around so streaming maze blocks in and out
+  // doesn't bounce memory back and forth with the driver
+  static constexpr uint32_t MAX_EMPTY_BLOCKS_PER_POOL = 1;
+
+  VKMemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+  ~VKMemoryAllocator();
+
+  VKMemoryAllocator(const VKMemoryAllocator &) = delete;
+  VKMemoryAllocator &operator=(const VKMemoryAllocator &) = delete;
+
+  // linear: the resource is a buffer or a linearly tiled image
+  VKAllocation allocate(
+      const VkMemoryRequirements &requirements,
+      VkMemoryPropertyFlags properties,
+      bool linear);
+  void free(VKAllocation &allocation);
+
+  // Ranges are relative to the allocation and rounded out to
+  // nonCoherentAtomSize; no-ops on coherent memory
+  VkResult flush(const VKAllocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+  VkResult invalidate(const VKAllocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+  // Defragmentation hooks. The allocator can't move resources itself since it
+  // doesn't know what is bound where; instead owners ask whether an
+  // allocation sits in a mostly empty block, recreate it elsewhere, and the
+  // drained block is then handed back by releaseEmptyBlocks().
+  bool isRelocationCandidate(const VKAllocation &allocation, float maxBlockUsage = 0.25f) const;
+  // Returns the number of blocks freed
+  uint32_t releaseEmptyBlocks();
+
+  VKMemoryStats getStats() const;
+  void printStats(std::ostream &out) const;
+
+ private:
+  struct Pool {
+    std::vector<std::unique_ptr<VKMemoryBlock>> blocks;
+  };
+
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+  VkDeviceSize preferredBlockSize(uint32_t memoryTypeIndex) const;
+  VKMemoryBlock* createBlock(uint32_t poolIndex, uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated);
+  void destroyBlock(VKMemoryBlock* block);
+  bool suballocate(VKMemoryBlock &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+  void releaseRange(VKMemoryBlock &block, VkDeviceSize offset, VkDeviceSize size);
+  bool isCoherent(uint32_t memoryTypeIndex) const;
+  VkMappedMemoryRange mappedRange(const VKAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) const;
+
+  VkDevice m_device;
+  VkPhysicalDeviceMemoryProperties m_memoryProperties;
+  VkDeviceSize m_nonCoherentAtomSize;
+  uint32_t m_maxAllocationCount;
+
+  // Indexed by memoryTypeIndex * 2 + (linear ? 0 : 1)
+  std::vector<Pool> m_pools;
+  uint32_t m_liveDeviceAllocations = 0;
+  uint64_t m_totalDeviceAllocations = 0;
+
+  mutable std::mutex m_mutex;
+};
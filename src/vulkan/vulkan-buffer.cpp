@@ -48,12 +48,15 @@ VKBufferMgr::VKBufferMgr(
 VKBufferMgr::~VKBufferMgr() {
   unmap();
   vkDestroyBuffer(m_device.device(), buffer, nullptr);
-  vkFreeMemory(m_device.device(), memory, nullptr);
+  m_device.allocator().free(memory);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host-visible memory is persistently mapped by the allocator, so this only hands out a
+ * pointer into the existing mapping
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
@@ -61,20 +64,21 @@ VKBufferMgr::~VKBufferMgr() {
  * @return VkResult of the buffer mapping call
  */
 VkResult VKBufferMgr::map(VkDeviceSize size, VkDeviceSize offset) {
-  assert(buffer && memory && "Called map on buffer before create");
-  return vkMapMemory(m_device.device(), memory, offset, size, 0, &mapped);
+  assert(buffer && memory.isValid() && "Called map on buffer before create");
+  if (!memory.mapped) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  mapped = static_cast<char *>(memory.mapped) + offset;
+  return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The underlying block stays mapped; this only drops the buffer's pointer into it
  */
 void VKBufferMgr::unmap() {
-  if (mapped) {
-    vkUnmapMemory(m_device.device(), memory);
-    mapped = nullptr;
-  }
+  mapped = nullptr;
 }
 
 /**
@@ -110,12 +114,7 @@ void VKBufferMgr::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offs
  * @return VkResult of the flush call
  */
 VkResult VKBufferMgr::flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
-  return vkFlushMappedMemoryRanges(m_device.device(), 1, &mappedRange);
+  return m_device.allocator().flush(memory, size, offset);
 }
 
 /**
@@ -130,12 +129,7 @@ VkResult VKBufferMgr::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult VKBufferMgr::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
-  return vkInvalidateMappedMemoryRanges(m_device.device(), 1, &mappedRange);
+  return m_device.allocator().invalidate(memory, size, offset);
 }
 
 /**
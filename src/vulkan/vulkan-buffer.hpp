@@ -44,7 +44,7 @@ class VKBufferMgr {
   VKDeviceManager& m_device;
   void* mapped = nullptr;
   VkBuffer buffer = VK_NULL_HANDLE;
-  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VKAllocation memory;
 
   VkDeviceSize bufferSize;
   uint32_t instanceCount;
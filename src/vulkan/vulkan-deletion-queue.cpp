@@ -0,0 +1,29 @@
+#include "vulkan-deletion-queue.hpp"
+
+// std
+#include <cassert>
+#include <utility>
+
+void VKDeletionQueue::push(uint64_t submittedFrames, std::function<void()> deleter) {
+  assert(
+      (m_entries.empty() || m_entries.back().frame <= submittedFrames) &&
+      "Objects have to be retired in frame order");
+  m_entries.push_back({submittedFrames, std::move(deleter)});
+}
+
+void VKDeletionQueue::collect(uint64_t completedFrames) {
+  while (!m_entries.empty() && m_entries.front().frame <= completedFrames) {
+    // Pop before running, in case the deleter retires something itself
+    std::function<void()> deleter = std::move(m_entries.front().deleter);
+    m_entries.pop_front();
+    deleter();
+  }
+}
+
+void VKDeletionQueue::flush() {
+  while (!m_entries.empty()) {
+    std::function<void()> deleter = std::move(m_entries.front().deleter);
+    m_entries.pop_front();
+    deleter();
+  }
+}
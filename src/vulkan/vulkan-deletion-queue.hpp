@@ -0,0 +1,48 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+
+// Destroys GPU objects once the frames that might still use them are done,
+// instead of waiting for the whole device to go idle.
+//
+// Objects are tagged with the number of frames submitted so far when they
+// were retired; collect() runs every deleter whose frames have all
+// completed. The owner (VKRenderer) knows which frames that is from the
+// fences it waits on anyway, so nothing here ever waits itself.
+class VKDeletionQueue {
+ public:
+  VKDeletionQueue() = default;
+  ~VKDeletionQueue() { flush(); }
+
+  VKDeletionQueue(const VKDeletionQueue&) = delete;
+  VKDeletionQueue &operator=(const VKDeletionQueue&) = delete;
+
+  // deleter runs once every frame numbered below submittedFrames has completed
+  void push(uint64_t submittedFrames, std::function<void()> deleter);
+  // Keeps object alive until then
+  template <typename T>
+  void retire(uint64_t submittedFrames, std::shared_ptr<T> object) {
+    push(submittedFrames, [object]() mutable { object.reset(); });
+  }
+
+  // Runs the deleters of everything retired at or before completedFrames,
+  // i.e. all frames numbered below it have finished on the GPU
+  void collect(uint64_t completedFrames);
+  // Runs everything; only once the device is idle
+  void flush();
+
+  size_t size() const { return m_entries.size(); }
+
+ private:
+  struct Entry {
+    uint64_t frame;
+    std::function<void()> deleter;
+  };
+
+  // Ordered by frame, since frames only ever go up
+  std::deque<Entry> m_entries;
+};
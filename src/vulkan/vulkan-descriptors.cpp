@@ -10,7 +10,8 @@ VK_DSL_Mgr::Builder &VK_DSL_Mgr::Builder::addBinding(
     uint32_t binding,
     VkDescriptorType descriptorType,
     VkShaderStageFlags stageFlags,
-    uint32_t count
+    uint32_t count,
+    VkDescriptorBindingFlags bindingFlags
 ) {
   assert(m_bindings.count(binding) == 0 && "Binding already in use");
   VkDescriptorSetLayoutBinding layoutBinding{};
@@ -19,23 +20,33 @@ VK_DSL_Mgr::Builder &VK_DSL_Mgr::Builder::addBinding(
   layoutBinding.descriptorCount = count;
   layoutBinding.stageFlags = stageFlags;
   m_bindings[binding] = layoutBinding;
+  if (bindingFlags != 0) {
+    m_bindingFlags[binding] = bindingFlags;
+  }
   return *this;
 }
 
 std::unique_ptr<VK_DSL_Mgr> VK_DSL_Mgr::Builder::build() const {
-  return std::make_unique<VK_DSL_Mgr>(m_device, m_bindings);
+  return std::make_unique<VK_DSL_Mgr>(m_device, m_bindings, m_bindingFlags);
 }
 
 // *************** Descriptor Set Layout *********************
 
 VK_DSL_Mgr::VK_DSL_Mgr(
     VKDeviceManager &device,
-    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings
+    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+    std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags
   ) : m_device(device), m_bindings(bindings)
 {
   std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+  std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
+  bool updateAfterBind = false;
   for (auto kv : m_bindings) {
     setLayoutBindings.push_back(kv.second);
+
+    auto flags = bindingFlags.find(kv.first);
+    setLayoutBindingFlags.push_back(flags == bindingFlags.end() ? 0 : flags->second);
+    updateAfterBind |= (setLayoutBindingFlags.back() & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
   }
 
   VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
@@ -43,6 +54,19 @@ VK_DSL_Mgr::VK_DSL_Mgr(
   descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
   descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+  // Descriptor indexing flags (partially bound, update after bind, ...) are only
+  // chained in when some binding asks for them
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+  if (!bindingFlags.empty()) {
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+    descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+  }
+  if (updateAfterBind) {
+    descriptorSetLayoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  }
+
   if (vkCreateDescriptorSetLayout(
           m_device.device(),
           &descriptorSetLayoutInfo,
@@ -190,6 +214,32 @@ VKDescriptorWriter &VKDescriptorWriter::writeImage(
   return *this;
 }
 
+VKDescriptorWriter &VKDescriptorWriter::writeImages(
+    uint32_t binding,
+    VkDescriptorImageInfo *imageInfos,
+    uint32_t count,
+    uint32_t firstElement
+) {
+  assert(m_setLayout.m_bindings.count(binding) == 1 && "Layout does not contain specified binding");
+
+  auto &bindingDescription = m_setLayout.m_bindings[binding];
+
+  assert(
+      firstElement + count <= bindingDescription.descriptorCount &&
+      "Writing past the end of the binding's descriptor array");
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.descriptorType = bindingDescription.descriptorType;
+  write.dstBinding = binding;
+  write.dstArrayElement = firstElement;
+  write.pImageInfo = imageInfos;
+  write.descriptorCount = count;
+
+  m_writes.push_back(write);
+  return *this;
+}
+
 bool VKDescriptorWriter::build(VkDescriptorSet &set) {
   bool success = m_pool.allocateDescriptor(m_setLayout.getDescriptorSetLayout(), set);
   if (!success) {
@@ -17,17 +17,20 @@ class VK_DSL_Mgr {
         uint32_t binding,
         VkDescriptorType descriptorType,
         VkShaderStageFlags stageFlags,
-        uint32_t count = 1);
+        uint32_t count = 1,
+        VkDescriptorBindingFlags bindingFlags = 0);
     std::unique_ptr<VK_DSL_Mgr> build() const;
 
    private:
     VKDeviceManager& m_device;
     std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> m_bindings{};
+    std::unordered_map<uint32_t, VkDescriptorBindingFlags> m_bindingFlags{};
   };
 
   VK_DSL_Mgr(
       VKDeviceManager& device,
-      std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings
+      std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+      std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags = {}
   );
 
   ~VK_DSL_Mgr();
@@ -91,6 +94,12 @@ class VKDescriptorWriter {
 
   VKDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
   VKDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
+  // Writes count elements of an arrayed binding, starting at firstElement
+  VKDescriptorWriter& writeImages(
+      uint32_t binding,
+      VkDescriptorImageInfo *imageInfos,
+      uint32_t count,
+      uint32_t firstElement = 0);
 
   bool build(VkDescriptorSet &set);
   void overwrite(VkDescriptorSet &set);
@@ -1,6 +1,11 @@
 // Code lifted largely from https://github.com/blurrypiano/littleVulkanEngine
 
 #include "vulkan-device.hpp"
+#include "vulkan-geometry-pool.hpp"
+#include "vulkan-model.hpp"
+#include "vulkan-swapchain.hpp"
+#include "vulkan-textures.hpp"
+#include "vulkan-upload.hpp"
 
 // std headers
 #include <cstring>
@@ -48,20 +53,37 @@ void DestroyDebugUtilsMessengerEXT(
 ///////////////////////////////////////////////////////////////////////////////
 
 // class member functions
-VKDeviceManager::VKDeviceManager(GlfwWindow& window) : window(window), cur_texture(0) {
+VKDeviceManager::VKDeviceManager(GlfwWindow& window) : window(&window) {
+  init();
+}
+
+VKDeviceManager::VKDeviceManager() : window(nullptr) {
+  deviceExtensions.clear();
+  init();
+}
+
+void VKDeviceManager::init() {
   createInstance();
   setupDebugMessenger();
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  m_allocator = std::make_unique<VKMemoryAllocator>(device_, physicalDevice);
+  m_uploads = std::make_unique<VKUploadManager>(*this);
+  m_pipelineCache = std::make_unique<VKPipelineCache>(device_, properties);
+  m_geometry = std::make_unique<VKGeometryPool>(*this, sizeof(VKModel::CompactVertex));
+  m_textures = std::make_unique<VKTextureRegistry>(*this);
+  m_profiler = std::make_unique<VKProfiler>(*this, VKSwapChain::MAX_FRAMES_IN_FLIGHT);
 }
 
 VKDeviceManager::~VKDeviceManager() {
-  for (int32_t i = 0; i < MAX_TEXTURES; i++) {
-      vkDestroySampler(device_, textureSampler[i], nullptr);
-      vkDestroyImageView(device_, textureImageView[i], nullptr);
-  }
+  m_profiler.reset();
+  m_textures.reset();
+  m_geometry.reset();
+  m_pipelineCache.reset();
+  m_uploads.reset();
+  m_allocator.reset();
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -69,7 +91,9 @@ VKDeviceManager::~VKDeviceManager() {
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(instance, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance, surface_, nullptr);
+  }
   vkDestroyInstance(instance, nullptr);
 }
 
@@ -84,7 +108,8 @@ void VKDeviceManager::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // 1.2 for descriptor indexing (bindless textures)
+  appInfo.apiVersion = VK_API_VERSION_1_2;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -141,9 +166,11 @@ void VKDeviceManager::pickPhysicalDevice() {
 
 void VKDeviceManager::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  queueFamilies_ = indices;
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {
+      indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -158,8 +185,20 @@ void VKDeviceManager::createLogicalDevice() {
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+  // Descriptor indexing, for the bindless texture array
+  VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.descriptorIndexing = VK_TRUE;
+  vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+  vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+  vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  // Upload batches are tracked with a timeline semaphore
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = &vulkan12Features;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -183,6 +222,7 @@ void VKDeviceManager::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
 }
 
 void VKDeviceManager::createCommandPool() {
@@ -200,7 +240,8 @@ void VKDeviceManager::createCommandPool() {
 }
 
 void VKDeviceManager::createSurface() {
-    window.createWindowSurface(instance, &surface_);
+  if (isHeadless()) return;
+  window->createWindowSurface(instance, &surface_);
 }
 
 bool VKDeviceManager::isDeviceSuitable(VkPhysicalDevice device) {
@@ -208,8 +249,9 @@ bool VKDeviceManager::isDeviceSuitable(VkPhysicalDevice device) {
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  // Offscreen targets need no surface support at all
+  bool swapChainAdequate = isHeadless();
+  if (extensionsSupported && !isHeadless()) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -218,7 +260,29 @@ bool VKDeviceManager::isDeviceSuitable(VkPhysicalDevice device) {
   vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
   return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-         supportedFeatures.samplerAnisotropy;
+         supportedFeatures.samplerAnisotropy && checkVulkan12FeatureSupport(device);
+}
+
+bool VKDeviceManager::checkVulkan12FeatureSupport(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+    return false;
+  }
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &vulkan12Features;
+  vkGetPhysicalDeviceFeatures2(device, &features);
+
+  return vulkan12Features.descriptorIndexing &&
+         vulkan12Features.runtimeDescriptorArray &&
+         vulkan12Features.descriptorBindingPartiallyBound &&
+         vulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+         vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+         vulkan12Features.timelineSemaphore;
 }
 
 void VKDeviceManager::populateDebugMessengerCreateInfo(
@@ -270,11 +334,13 @@ bool VKDeviceManager::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> VKDeviceManager::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  std::vector<const char *> extensions;
+  if (!isHeadless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -338,23 +404,40 @@ QueueFamilyIndices VKDeviceManager::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT &&
+        !indices.graphicsFamilyHasValue) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
     }
+    // Headless devices never present; any graphics family will do
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (queueFamily.queueCount > 0 && presentSupport) {
+    if (isHeadless()) {
+      presentSupport = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+    } else {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    }
+    if (queueFamily.queueCount > 0 && presentSupport && !indices.presentFamilyHasValue) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
     }
-    if (indices.isComplete()) {
-      break;
+    // Prefer a pure transfer family (the copy engine) over one shared with compute
+    bool transferOnly = queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+                        !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+    bool noCompute = !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
+    if (queueFamily.queueCount > 0 && transferOnly &&
+        (!indices.transferFamilyHasValue || noCompute)) {
+      indices.transferFamily = i;
+      indices.transferFamilyHasValue = true;
     }
 
     i++;
   }
 
+  if (!indices.transferFamilyHasValue && indices.graphicsFamilyHasValue) {
+    indices.transferFamily = indices.graphicsFamily;
+    indices.transferFamilyHasValue = true;
+  }
+
   return indices;
 }
 
@@ -416,7 +499,7 @@ uint32_t VKDeviceManager::findMemoryType(
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
-VkImageView VKDeviceManager::createImageView(VkImage image, VkFormat format) {
+VkImageView VKDeviceManager::createImageView(VkImage image, VkFormat format, uint32_t mipLevels) {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
@@ -424,7 +507,7 @@ VkImageView VKDeviceManager::createImageView(VkImage image, VkFormat format) {
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -442,7 +525,7 @@ void VKDeviceManager::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory
+    VKAllocation &bufferMemory
 ) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -450,6 +533,15 @@ void VKDeviceManager::createBuffer(
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+  // Upload targets are written on the transfer queue and read on the graphics queue
+  QueueFamilyIndices indices = findPhysicalQueueFamilies();
+  uint32_t queueFamilies[] = {indices.graphicsFamily, indices.transferFamily};
+  if (usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT && indices.graphicsFamily != indices.transferFamily) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices = queueFamilies;
+  }
+
   if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to create vertex buffer!");
   }
@@ -457,16 +549,11 @@ void VKDeviceManager::createBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferMemory = m_allocator->allocate(memRequirements, properties, true);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind buffer memory!");
   }
-
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 }
 
 VkCommandBuffer VKDeviceManager::beginSingleTimeCommands() {
@@ -604,25 +691,30 @@ void VKDeviceManager::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory
+    VKAllocation &imageMemory
 ) {
-  if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+  VkImageCreateInfo createInfo = imageInfo;
+  QueueFamilyIndices indices = findPhysicalQueueFamilies();
+  uint32_t queueFamilies[] = {indices.graphicsFamily, indices.transferFamily};
+  if (createInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT &&
+      createInfo.sharingMode == VK_SHARING_MODE_EXCLUSIVE &&
+      indices.graphicsFamily != indices.transferFamily) {
+    createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    createInfo.queueFamilyIndexCount = 2;
+    createInfo.pQueueFamilyIndices = queueFamilies;
+  }
+
+  if (vkCreateImage(device_, &createInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
 
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
+  imageMemory = m_allocator->allocate(
+      memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+  if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
     throw std::runtime_error("failed to bind image memory!");
   }
 }
@@ -2,12 +2,20 @@
 
 #pragma once
 
+#include "vulkan-allocator.hpp"
+#include "vulkan-pipeline-cache.hpp"
+#include "vulkan-profiler.hpp"
 #include "window/glfw-window.hpp"
 
 #include <vulkan/vulkan.h>
+#include <memory>
 #include <string>
 #include <vector>
 
+class VKTextureRegistry;
+class VKUploadManager;
+class VKGeometryPool;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +25,11 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // A transfer-only family when the device has one, otherwise graphicsFamily
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -31,6 +42,9 @@ class VKDeviceManager {
 #endif
 
   VKDeviceManager(GlfwWindow& window);
+  // Headless: no surface, no swapchain extension and no present queue; render
+  // into a VKOffscreenTarget instead
+  VKDeviceManager();
   ~VKDeviceManager();
 
   // Not copyable or movable
@@ -41,13 +55,16 @@ class VKDeviceManager {
 
   VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
+  VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
+  bool isHeadless() const { return window == nullptr; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-  QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+  QueueFamilyIndices findPhysicalQueueFamilies() { return queueFamilies_; }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
@@ -57,7 +74,7 @@ class VKDeviceManager {
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      VKAllocation &bufferMemory);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
@@ -66,7 +83,7 @@ class VKDeviceManager {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      VKAllocation &imageMemory);
 
   void transitionImageLayout(
       VkImage image,
@@ -75,18 +92,34 @@ class VKDeviceManager {
       VkImageLayout newLayout
   );
 
-  VkImageView createImageView(VkImage image, VkFormat format);
+  VkImageView createImageView(VkImage image, VkFormat format, uint32_t mipLevels = 1);
+
+  // Records into a fresh command buffer; end submits it and waits for idle
+  VkCommandBuffer beginSingleTimeCommands();
+  void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
   VkPhysicalDeviceProperties properties;
 
-  // Texture hack
-  // JANKTEX
-  static constexpr int32_t MAX_TEXTURES = 8;
-  VkImageView textureImageView[MAX_TEXTURES];
-  VkSampler textureSampler[MAX_TEXTURES];
-  int32_t cur_texture;
+  // Sub-allocates buffer and image memory out of large per-type blocks
+  VKMemoryAllocator& allocator() { return *m_allocator; }
+
+  // Shared by every pipeline and persisted across runs
+  VKPipelineCache& pipelineCache() { return *m_pipelineCache; }
+
+  // Batched, non-blocking copies into device-local buffers and images
+  VKUploadManager& uploads() { return *m_uploads; }
+
+  // Vertices and indices of every VKModel, packed into a few shared buffers
+  VKGeometryPool& geometry() { return *m_geometry; }
+
+  // Every sampled texture, exposed to shaders as one bindless array
+  VKTextureRegistry& textures() { return *m_textures; }
+
+  // CPU phase and GPU timestamp zones; off unless enabled
+  VKProfiler& profiler() { return *m_profiler; }
 
  private:
+  void init();
   void createInstance();
   void setupDebugMessenger();
   void createSurface();
@@ -102,21 +135,32 @@ class VKDeviceManager {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool checkVulkan12FeatureSupport(VkPhysicalDevice device);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
-  VkCommandBuffer beginSingleTimeCommands();
-  void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  GlfwWindow& window;
+  // Null when headless
+  GlfwWindow* window;
   VkCommandPool commandPool;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  // Queried once when the logical device is created
+  QueueFamilyIndices queueFamilies_;
+
+  std::unique_ptr<VKMemoryAllocator> m_allocator;
+  std::unique_ptr<VKPipelineCache> m_pipelineCache;
+  std::unique_ptr<VKUploadManager> m_uploads;
+  std::unique_ptr<VKGeometryPool> m_geometry;
+  std::unique_ptr<VKTextureRegistry> m_textures;
+  std::unique_ptr<VKProfiler> m_profiler;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-  const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // Emptied in headless mode
+  std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 };
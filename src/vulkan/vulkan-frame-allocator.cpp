@@ -0,0 +1,62 @@
+#include "vulkan-frame-allocator.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+VKFrameAllocator::VKFrameAllocator(
+    VKDeviceManager& device,
+    VkDeviceSize capacityPerFrame,
+    uint32_t framesInFlight)
+    : m_device(device), m_capacity(capacityPerFrame), m_buffers(framesInFlight)
+{
+  // Every allocation may end up behind a uniform or storage descriptor; 16
+  // also keeps vec4 data aligned for the vertex input
+  const VkPhysicalDeviceLimits& limits = m_device.properties.limits;
+  m_alignment = std::max<VkDeviceSize>({
+      limits.minUniformBufferOffsetAlignment,
+      limits.minStorageBufferOffsetAlignment,
+      16});
+
+  for (auto& buffer : m_buffers) {
+    buffer = std::make_unique<VKBufferMgr>(
+        m_device,
+        m_capacity,
+        1,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (buffer->map() != VK_SUCCESS) {
+      throw std::runtime_error("failed to map frame allocator buffer!");
+    }
+  }
+}
+
+void VKFrameAllocator::beginFrame(int frameIndex) {
+  m_frameIndex = frameIndex;
+  m_head = 0;
+}
+
+VKFrameAllocator::Allocation VKFrameAllocator::allocate(VkDeviceSize size) {
+  VkDeviceSize offset = (m_head + m_alignment - 1) & ~(m_alignment - 1);
+  if (offset + size > m_capacity) {
+    throw std::runtime_error(
+        "frame allocator out of space: " + std::to_string(offset + size) + " of " +
+        std::to_string(m_capacity) + " bytes");
+  }
+  m_head = offset + size;
+  m_highWaterMark = std::max(m_highWaterMark, m_head);
+
+  VKBufferMgr& buffer = *m_buffers[m_frameIndex];
+  Allocation allocation{};
+  allocation.data = static_cast<char*>(buffer.getMappedMemory()) + offset;
+  allocation.buffer = buffer.getBuffer();
+  allocation.offset = offset;
+  allocation.size = size;
+  return allocation;
+}
+
+VkDescriptorBufferInfo VKFrameAllocator::descriptorInfo(int frameIndex, VkDeviceSize range) const {
+  return {m_buffers[frameIndex]->getBuffer(), 0, range};
+}
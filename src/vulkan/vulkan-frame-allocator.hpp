@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vulkan-buffer.hpp"
+#include "vulkan-device.hpp"
+
+// std
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Linear allocator for data that only lives for one frame: uniforms, light
+// lists, instance data.
+//
+// Each frame in flight owns one persistently mapped, host-coherent buffer
+// (a VKBufferMgr). beginFrame rewinds it once the slot's fence has been
+// waited on, and allocate just bumps an offset, so there is no allocation,
+// no map and no flush per call. Offsets are aligned for uniform and storage
+// buffer descriptors, which bind a fixed range of the frame's buffer and
+// get the offset as a dynamic offset; vertex data binds at the offset
+// directly.
+class VKFrameAllocator {
+ public:
+  struct Allocation {
+    void* data = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    uint32_t dynamicOffset() const { return static_cast<uint32_t>(offset); }
+  };
+
+  VKFrameAllocator(VKDeviceManager& device, VkDeviceSize capacityPerFrame, uint32_t framesInFlight);
+
+  VKFrameAllocator(const VKFrameAllocator&) = delete;
+  VKFrameAllocator& operator=(const VKFrameAllocator&) = delete;
+
+  // Called by VKRenderer once frameIndex's previous use has completed
+  void beginFrame(int frameIndex);
+
+  // Throws once the frame's buffer is full; raise the capacity instead of
+  // falling back to something slower
+  Allocation allocate(VkDeviceSize size);
+  Allocation push(const void* data, VkDeviceSize size) {
+    Allocation allocation = allocate(size);
+    std::memcpy(allocation.data, data, size);
+    return allocation;
+  }
+  template <typename T>
+  T* allocate(uint32_t count, Allocation& allocation) {
+    allocation = allocate(sizeof(T) * count);
+    return static_cast<T*>(allocation.data);
+  }
+
+  // A descriptor over [0, range) of frameIndex's buffer, to be moved with
+  // dynamic offsets
+  VkDescriptorBufferInfo descriptorInfo(int frameIndex, VkDeviceSize range) const;
+
+  VkDeviceSize getAlignment() const { return m_alignment; }
+  VkDeviceSize getCapacity() const { return m_capacity; }
+  VkDeviceSize getUsed() const { return m_head; }
+  // Most bytes any frame has used so far
+  VkDeviceSize getHighWaterMark() const { return m_highWaterMark; }
+
+ private:
+  VKDeviceManager& m_device;
+  VkDeviceSize m_capacity;
+  VkDeviceSize m_alignment;
+  std::vector<std::unique_ptr<VKBufferMgr>> m_buffers;
+
+  int m_frameIndex = 0;
+  VkDeviceSize m_head = 0;
+  VkDeviceSize m_highWaterMark = 0;
+};
@@ -2,14 +2,25 @@
 
 #include "renderer/camera.h"
 #include "game/lve_game_object.hpp"
+#include "vulkan/vulkan-frame-allocator.hpp"
 
 // lib
 #include <vulkan/vulkan.h>
 
-#define MAX_LIGHTS 10
+// std
+#include <array>
+#include <cstdint>
+
+// Capacity of the per-frame light storage buffer (see LightClusterSystem)
+#define MAX_LIGHTS 1024
+// Sun shadow atlas tiles, one per maze block (see SunShadowSystem)
+#define SHADOW_TILE_COUNT 9
+// Global set bindings 0-3 (the UBO and the light cluster buffers) are
+// dynamic, bound at offsets into the frame allocator
+#define GLOBAL_DYNAMIC_OFFSET_COUNT 4
 
 struct PointLight {
-  glm::vec4 position{};  // ignore w
+  glm::vec4 position{};  // w is the range the light is culled at
   glm::vec4 color{};     // w is intensity
 };
 
@@ -18,8 +29,15 @@ struct GlobalUbo {
   glm::mat4 view{1.f};
   glm::mat4 inverseView{1.f};
   glm::vec4 ambientLightColor{1.f, 1.f, 1.f, .02f};  // w is intensity
-  PointLight pointLights[MAX_LIGHTS];
-  int numLights;
+  glm::uvec4 clusterGrid{};  // xyz: clusters per axis, w: light count
+  glm::mat4 sunTileMatrices[SHADOW_TILE_COUNT];  // world -> light clip, per atlas tile
+  glm::mat4 sunDynamicMatrix{0.f};  // all zero when there are no dynamic casters
+  glm::vec4 sunTileRect{};  // xy: world xz of tile 0's corner, zw: tile size
+  // x, y: distances the hedge meshes start/finish handing over to impostors
+  // (y = 0: no impostors), zw: world xz of the maze grid's corner
+  glm::vec4 impostorFade{0.f};
+  glm::vec2 clusterDepth{};  // slice = log(view depth) * x + y
+  int sunLightIndex = -1;  // index into the light buffer, -1 for no shadows
 };
 
 struct FrameInfo {
@@ -29,4 +47,8 @@ struct FrameInfo {
   Camera& camera;
   VkDescriptorSet globalDescriptorSet;
   LveGameObject::Map &gameObjects;
+  VKFrameAllocator &frameAllocator;
+  // Dynamic offsets for globalDescriptorSet, in binding order; filled in
+  // during the update phase
+  std::array<uint32_t, GLOBAL_DYNAMIC_OFFSET_COUNT> globalOffsets{};
 };
@@ -0,0 +1,127 @@
+#include "vulkan-frame-pacer.hpp"
+
+// std
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+// Sleep until this close to a deadline, then spin; sleeps overshoot
+static constexpr auto SPIN_MARGIN = std::chrono::microseconds(1000);
+
+VKFramePacer::VKFramePacer(PacingMode mode, double targetHz)
+  : m_mode(mode), m_targetHz(targetHz) {}
+
+PacingMode VKFramePacer::parseMode(const std::string& name) {
+  for (size_t i = 0; i < MODE_COUNT; i++) {
+    PacingMode mode = static_cast<PacingMode>(i);
+    if (name == modeName(mode)) {
+      return mode;
+    }
+  }
+  throw std::runtime_error("unknown frame pacing mode: " + name);
+}
+
+const char* VKFramePacer::modeName(PacingMode mode) {
+  switch (mode) {
+    case PacingMode::Balanced: return "balanced";
+    case PacingMode::LowLatency: return "low-latency";
+    case PacingMode::Throughput: return "throughput";
+    case PacingMode::Limited: return "limited";
+  }
+  return "unknown";
+}
+
+void VKFramePacer::setMode(PacingMode mode) {
+  m_mode = mode;
+  m_nextDeadline = Clock::time_point{};
+  m_lastPresent = Clock::time_point{};
+}
+
+PacingMode VKFramePacer::nextMode() const {
+  return static_cast<PacingMode>((static_cast<size_t>(m_mode) + 1) % MODE_COUNT);
+}
+
+SwapChainPacing VKFramePacer::swapChainPacing() const {
+  SwapChainPacing pacing{};
+  switch (m_mode) {
+    case PacingMode::Balanced:
+    case PacingMode::Limited:
+      pacing.framesInFlight = 2;
+      pacing.presentModes = {VK_PRESENT_MODE_MAILBOX_KHR};
+      break;
+    case PacingMode::LowLatency:
+      // Tearing is the price of not queueing behind vsync
+      pacing.framesInFlight = 1;
+      pacing.presentModes = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+      break;
+    case PacingMode::Throughput:
+      pacing.framesInFlight = 3;
+      pacing.presentModes = {VK_PRESENT_MODE_MAILBOX_KHR};
+      break;
+  }
+  return pacing;
+}
+
+bool VKFramePacer::waitsBeforeInput() const {
+  return m_mode == PacingMode::LowLatency || m_mode == PacingMode::Limited;
+}
+
+void VKFramePacer::waitForNextFrame() {
+  if (m_mode != PacingMode::Limited || m_targetHz <= 0.0) {
+    return;
+  }
+  const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / m_targetHz));
+  auto now = Clock::now();
+  // Start over after a stall (or idle) instead of rushing to catch up
+  if (m_nextDeadline == Clock::time_point{} || now > m_nextDeadline + period) {
+    m_nextDeadline = now;
+  }
+  if (m_nextDeadline - now > SPIN_MARGIN) {
+    std::this_thread::sleep_until(m_nextDeadline - SPIN_MARGIN);
+  }
+  while (Clock::now() < m_nextDeadline) {
+    std::this_thread::yield();
+  }
+  m_nextDeadline += period;
+}
+
+void VKFramePacer::markPresented() {
+  auto now = Clock::now();
+  ModeStats& stats = m_stats[static_cast<size_t>(m_mode)];
+  if (stats.latencyMs.size() < MAX_SAMPLES && m_inputTime != Clock::time_point{}) {
+    stats.latencyMs.push_back(std::chrono::duration<float, std::milli>(now - m_inputTime).count());
+  }
+  if (stats.intervalMs.size() < MAX_SAMPLES && m_lastPresent != Clock::time_point{}) {
+    stats.intervalMs.push_back(std::chrono::duration<float, std::milli>(now - m_lastPresent).count());
+  }
+  m_lastPresent = now;
+}
+
+void VKFramePacer::printReport(std::ostream& out) const {
+  auto percentile = [](std::vector<float> samples, float p) {
+    if (samples.empty()) return 0.f;
+    size_t index = static_cast<size_t>(p * (samples.size() - 1) + 0.5f);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+  };
+
+  out << "Frame pacing (ms, input to present / present interval):" << std::endl;
+  out << "\t" << std::left << std::setw(14) << "mode" << std::right << std::setw(8) << "frames"
+      << std::setw(10) << "lat p50" << std::setw(10) << "lat p95" << std::setw(10) << "lat p99"
+      << std::setw(10) << "int p50" << std::setw(10) << "int p95" << std::endl;
+  for (size_t i = 0; i < MODE_COUNT; i++) {
+    const ModeStats& stats = m_stats[i];
+    if (stats.latencyMs.empty()) continue;
+    out << "\t" << std::left << std::setw(14) << modeName(static_cast<PacingMode>(i))
+        << std::right << std::setw(8) << stats.latencyMs.size()
+        << std::fixed << std::setprecision(3)
+        << std::setw(10) << percentile(stats.latencyMs, 0.5f)
+        << std::setw(10) << percentile(stats.latencyMs, 0.95f)
+        << std::setw(10) << percentile(stats.latencyMs, 0.99f)
+        << std::setw(10) << percentile(stats.intervalMs, 0.5f)
+        << std::setw(10) << percentile(stats.intervalMs, 0.95f) << std::endl;
+  }
+  out.unsetf(std::ios::floatfield);
+}
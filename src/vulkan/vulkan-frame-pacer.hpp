@@ -0,0 +1,78 @@
+#pragma once
+
+#include "vulkan-swapchain.hpp"
+
+// std
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum class PacingMode {
+  // 2 frames in flight, mailbox; the old fixed behaviour
+  Balanced,
+  // 1 frame in flight, waits for the GPU before sampling input
+  LowLatency,
+  // 3 frames in flight so the CPU never waits on a single slow frame
+  Throughput,
+  // Balanced, capped at a target rate by sleeping before input sampling
+  Limited,
+};
+
+// Picks frames in flight and present modes for a PacingMode, runs the frame
+// limiter, and measures input-to-present latency and present intervals per
+// mode so they can be compared in one session.
+//
+// Latency here is from the last input sample to vkQueuePresentKHR returning:
+// the part that differs between modes (where the fence wait sits, how far the
+// CPU runs ahead). GPU execution and scanout come on top and are the same for
+// every mode.
+class VKFramePacer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t MODE_COUNT = 4;
+  // Cap on stored samples per mode
+  static constexpr size_t MAX_SAMPLES = 100000;
+
+  explicit VKFramePacer(PacingMode mode = PacingMode::Balanced, double targetHz = 60.0);
+
+  // "balanced", "low-latency", "throughput" or "limited"
+  static PacingMode parseMode(const std::string& name);
+  static const char* modeName(PacingMode mode);
+
+  void setMode(PacingMode mode);
+  PacingMode getMode() const { return m_mode; }
+  PacingMode nextMode() const;
+  void setTargetHz(double hz) { m_targetHz = hz; }
+  double getTargetHz() const { return m_targetHz; }
+
+  // What VKRenderer::setFramePacing needs for the current mode
+  SwapChainPacing swapChainPacing() const;
+  bool waitsBeforeInput() const;
+
+  // Frame limiter: sleeps until the next frame is due (Limited only)
+  void waitForNextFrame();
+  // Call right after polling input, and right after endFrame
+  void markInputSampled() { m_inputTime = Clock::now(); }
+  void markPresented();
+  // No frame this iteration (idle); the next present interval starts over
+  void markSkipped() { m_lastPresent = Clock::time_point{}; }
+
+  void printReport(std::ostream& out = std::cout) const;
+
+ private:
+  struct ModeStats {
+    std::vector<float> latencyMs;
+    std::vector<float> intervalMs;
+  };
+
+  PacingMode m_mode;
+  double m_targetHz;
+  Clock::time_point m_nextDeadline{};
+  Clock::time_point m_inputTime{};
+  Clock::time_point m_lastPresent{};
+  std::array<ModeStats, MODE_COUNT> m_stats;
+};
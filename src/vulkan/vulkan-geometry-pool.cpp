@@ -0,0 +1,176 @@
+#include "vulkan-geometry-pool.hpp"
+#include "vulkan-upload.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+VKGeometryPool::RangeAllocator::RangeAllocator(uint32_t capacity) {
+  m_free.emplace(0, capacity);
+}
+
+bool VKGeometryPool::RangeAllocator::allocate(uint32_t count, uint32_t& offset) {
+  for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+    if (it->second < count) {
+      continue;
+    }
+    offset = it->first;
+    uint32_t remaining = it->second - count;
+    m_free.erase(it);
+    if (remaining > 0) {
+      m_free.emplace(offset + count, remaining);
+    }
+    m_used += count;
+    return true;
+  }
+  return false;
+}
+
+void VKGeometryPool::RangeAllocator::release(uint32_t offset, uint32_t count) {
+  m_used -= count;
+
+  auto next = m_free.lower_bound(offset);
+  if (next != m_free.end() && offset + count == next->first) {
+    count += next->second;
+    next = m_free.erase(next);
+  }
+  if (next != m_free.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += count;
+      return;
+    }
+  }
+  m_free.emplace_hint(next, offset, count);
+}
+
+VKGeometryPool::VKGeometryPool(VKDeviceManager& device, VkDeviceSize vertexStride)
+    : m_device(device), m_vertexStride(vertexStride) {}
+
+VKGeometryPool::~VKGeometryPool() {}
+
+VKGeometryPool::Page& VKGeometryPool::createPage(uint32_t vertexCapacity, uint32_t indexCapacity) {
+  auto page = std::make_unique<Page>(Page{
+      std::make_unique<VKBufferMgr>(
+          m_device,
+          m_vertexStride,
+          vertexCapacity,
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+      std::make_unique<VKBufferMgr>(
+          m_device,
+          sizeof(uint32_t),
+          indexCapacity,
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+      RangeAllocator{vertexCapacity},
+      RangeAllocator{indexCapacity}});
+
+  m_pages.push_back(std::move(page));
+  return *m_pages.back();
+}
+
+GeometryRange VKGeometryPool::allocate(
+    const void* vertices,
+    uint32_t vertexCount,
+    const uint32_t* indices,
+    uint32_t indexCount
+) {
+  assert(vertexCount > 0 && "Cannot allocate empty geometry");
+
+  GeometryRange range{};
+  range.vertexCount = vertexCount;
+  range.indexCount = indexCount;
+
+  bool placed = false;
+  for (uint32_t i = 0; i < m_pages.size() && !placed; i++) {
+    Page& page = *m_pages[i];
+    if (!page.vertices.allocate(vertexCount, range.vertexOffset)) {
+      continue;
+    }
+    if (indexCount > 0 && !page.indices.allocate(indexCount, range.firstIndex)) {
+      page.vertices.release(range.vertexOffset, vertexCount);
+      continue;
+    }
+    range.page = i;
+    placed = true;
+  }
+
+  if (!placed) {
+    // Oversized models get a page of their own
+    Page& page = createPage(
+        std::max(VERTICES_PER_PAGE, vertexCount),
+        std::max(INDICES_PER_PAGE, indexCount));
+    range.page = static_cast<uint32_t>(m_pages.size() - 1);
+    page.vertices.allocate(vertexCount, range.vertexOffset);
+    if (indexCount > 0) {
+      page.indices.allocate(indexCount, range.firstIndex);
+    }
+  }
+
+  Page& page = *m_pages[range.page];
+  VKUploadManager& uploads = m_device.uploads();
+  uploads.uploadBuffer(
+      page.vertexBuffer->getBuffer(),
+      vertices,
+      m_vertexStride * vertexCount,
+      m_vertexStride * range.vertexOffset);
+  if (indexCount > 0) {
+    uploads.uploadBuffer(
+        page.indexBuffer->getBuffer(),
+        indices,
+        sizeof(uint32_t) * indexCount,
+        sizeof(uint32_t) * range.firstIndex);
+  }
+
+  return range;
+}
+
+void VKGeometryPool::free(const GeometryRange& range) {
+  if (range.vertexCount == 0) {
+    return;
+  }
+  Page& page = *m_pages[range.page];
+  page.vertices.release(range.vertexOffset, range.vertexCount);
+  if (range.indexCount > 0) {
+    page.indices.release(range.firstIndex, range.indexCount);
+  }
+}
+
+void VKGeometryPool::bind(VkCommandBuffer commandBuffer, uint32_t page) {
+  VkBuffer buffers[] = {m_pages[page]->vertexBuffer->getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, m_pages[page]->indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+void VKGeometryPool::draw(VkCommandBuffer commandBuffer, const GeometryRange& range, uint32_t instanceCount) {
+  if (range.isIndexed()) {
+    vkCmdDrawIndexed(
+        commandBuffer,
+        range.indexCount,
+        instanceCount,
+        range.firstIndex,
+        static_cast<int32_t>(range.vertexOffset),
+        0);
+  } else {
+    vkCmdDraw(commandBuffer, range.vertexCount, instanceCount, range.vertexOffset, 0);
+  }
+}
+
+uint32_t VKGeometryPool::getUsedVertices() const {
+  uint32_t used = 0;
+  for (const auto& page : m_pages) {
+    used += page->vertices.getUsed();
+  }
+  return used;
+}
+
+uint32_t VKGeometryPool::getUsedIndices() const {
+  uint32_t used = 0;
+  for (const auto& page : m_pages) {
+    used += page->indices.getUsed();
+  }
+  return used;
+}
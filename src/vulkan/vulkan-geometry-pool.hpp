@@ -0,0 +1,81 @@
+#pragma once
+
+#include "vulkan-buffer.hpp"
+#include "vulkan-device.hpp"
+
+// std
+#include <map>
+#include <memory>
+#include <vector>
+
+// Where a model's geometry lives inside the pool
+struct GeometryRange {
+  uint32_t page = 0;
+  uint32_t vertexOffset = 0;
+  uint32_t vertexCount = 0;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+
+  bool isIndexed() const { return indexCount > 0; }
+};
+
+// Packs the vertices and indices of every model into a few large device-local
+// buffers ("pages"), so a frame binds vertex/index buffers once per page
+// instead of once per object.
+//
+// Space inside a page is handed out from first-fit free lists (in elements,
+// not bytes) so that unloading and reloading maze blocks reuses the holes. A
+// new page is only created when nothing existing fits.
+class VKGeometryPool {
+ public:
+  static constexpr uint32_t VERTICES_PER_PAGE = 1 << 20;
+  static constexpr uint32_t INDICES_PER_PAGE = 1 << 22;
+
+  VKGeometryPool(VKDeviceManager& device, VkDeviceSize vertexStride);
+  ~VKGeometryPool();
+
+  VKGeometryPool(const VKGeometryPool &) = delete;
+  VKGeometryPool &operator=(const VKGeometryPool &) = delete;
+
+  // Copies the data in through the upload manager
+  GeometryRange allocate(
+      const void* vertices,
+      uint32_t vertexCount,
+      const uint32_t* indices,
+      uint32_t indexCount);
+  void free(const GeometryRange& range);
+
+  void bind(VkCommandBuffer commandBuffer, uint32_t page);
+  void draw(VkCommandBuffer commandBuffer, const GeometryRange& range, uint32_t instanceCount = 1);
+
+  uint32_t getPageCount() const { return static_cast<uint32_t>(m_pages.size()); }
+  uint32_t getUsedVertices() const;
+  uint32_t getUsedIndices() const;
+
+ private:
+  // First-fit free list over [0, capacity), coalesced on release
+  class RangeAllocator {
+   public:
+    RangeAllocator(uint32_t capacity);
+    bool allocate(uint32_t count, uint32_t& offset);
+    void release(uint32_t offset, uint32_t count);
+    uint32_t getUsed() const { return m_used; }
+
+   private:
+    std::map<uint32_t, uint32_t> m_free;
+    uint32_t m_used = 0;
+  };
+
+  struct Page {
+    std::unique_ptr<VKBufferMgr> vertexBuffer;
+    std::unique_ptr<VKBufferMgr> indexBuffer;
+    RangeAllocator vertices;
+    RangeAllocator indices;
+  };
+
+  Page& createPage(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+  VKDeviceManager& m_device;
+  VkDeviceSize m_vertexStride;
+  std::vector<std::unique_ptr<Page>> m_pages;
+};
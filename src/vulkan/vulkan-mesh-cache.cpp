@@ -0,0 +1,231 @@
+#include "vulkan-mesh-cache.hpp"
+
+#include "utils/file_cache.h"
+
+// std
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef MESH_CACHE_DIR
+#define MESH_CACHE_DIR "../cache/meshes/"
+#endif
+
+namespace {
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+  uint64_t sourceHash;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t lodCount;
+  uint32_t hasTexture;
+  uint32_t textureNameSize;
+  uint32_t vertexSize;
+};
+// Followed by lodCount index counts, the texture name, the vertices, the
+// indices and then every LOD's indices
+
+constexpr uint32_t MAGIC = 0x534D4C48;  // "HLMS"
+constexpr uint32_t VERSION = 1;
+
+static_assert(std::is_trivially_copyable_v<VKModel::Vertex>, "vertices are stored as raw bytes");
+
+// Read-only view of a whole file; mmap where there is one
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+#if defined(_WIN32)
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    if (!file.is_open()) return;
+    m_buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(m_buffer.data(), m_buffer.size())) return;
+    m_data = reinterpret_cast<const uint8_t*>(m_buffer.data());
+    m_size = m_buffer.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat info{};
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        m_data = static_cast<const uint8_t*>(mapping);
+        m_size = static_cast<size_t>(info.st_size);
+      }
+    }
+    // The mapping outlives the descriptor
+    close(fd);
+#endif
+  }
+
+  ~MappedFile() {
+#if !defined(_WIN32)
+    if (m_data) {
+      munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+#endif
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+ private:
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+#if defined(_WIN32)
+  std::vector<char> m_buffer;
+#endif
+};
+
+struct SourceStamp {
+  uint64_t size = 0;
+  int64_t mtime = 0;
+};
+
+bool stampSource(const std::string& sourcePath, SourceStamp& stamp) {
+  std::error_code ec;
+  stamp.size = std::filesystem::file_size(sourcePath, ec);
+  if (ec) return false;
+  stamp.mtime = std::filesystem::last_write_time(sourcePath, ec).time_since_epoch().count();
+  return !ec;
+}
+
+uint64_t hashSource(const std::string& sourcePath) {
+  MappedFile source(sourcePath);
+  return source.data() ? hashBytes(source.data(), source.size()) : 0;
+}
+
+std::string cacheFilePath(const std::string& sourcePath, const std::string& variant) {
+  std::string key = sourcePath + '\0' + variant;
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.mesh",
+      static_cast<unsigned long long>(hashBytes(key.data(), key.size())));
+  return std::string(MESH_CACHE_DIR) + name;
+}
+
+// Bounds-checked cursor over the mapped file
+class Reader {
+ public:
+  Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+  bool read(void* dst, size_t size) {
+    if (size > m_size - m_offset) return false;
+    if (size > 0) std::memcpy(dst, m_data + m_offset, size);
+    m_offset += size;
+    return true;
+  }
+
+  template <typename T>
+  bool readArray(std::vector<T>& dst, size_t count) {
+    if (count > (m_size - m_offset) / sizeof(T)) return false;
+    dst.resize(count);
+    return read(dst.data(), count * sizeof(T));
+  }
+
+ private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_offset = 0;
+};
+
+}  // namespace
+
+bool loadMeshCache(const std::string& sourcePath, const std::string& variant, VKModel::Builder& builder) {
+  SourceStamp stamp;
+  if (!stampSource(sourcePath, stamp)) {
+    return false;
+  }
+  MappedFile file(cacheFilePath(sourcePath, variant));
+  if (!file.data()) {
+    return false;
+  }
+
+  Reader reader(file.data(), file.size());
+  FileHeader header{};
+  if (!reader.read(&header, sizeof(header)) ||
+      header.magic != MAGIC || header.version != VERSION ||
+      header.vertexSize != sizeof(VKModel::Vertex) || header.sourceSize != stamp.size) {
+    return false;
+  }
+  // Touched but maybe not changed (e.g. a fresh checkout): compare content
+  if (header.sourceMtime != stamp.mtime && header.sourceHash != hashSource(sourcePath)) {
+    return false;
+  }
+
+  VKModel::Builder cached{};
+  std::vector<uint32_t> lodSizes;
+  std::vector<char> textureName;
+  if (!reader.readArray(lodSizes, header.lodCount) ||
+      !reader.readArray(textureName, header.textureNameSize) ||
+      !reader.readArray(cached.vertices, header.vertexCount) ||
+      !reader.readArray(cached.indices, header.indexCount)) {
+    std::cout << "mesh cache: entry for " << sourcePath << " is truncated" << std::endl;
+    return false;
+  }
+  cached.lods.resize(header.lodCount);
+  for (uint32_t lod = 0; lod < header.lodCount; lod++) {
+    if (!reader.readArray(cached.lods[lod], lodSizes[lod])) {
+      std::cout << "mesh cache: entry for " << sourcePath << " is truncated" << std::endl;
+      return false;
+    }
+  }
+  cached.has_texture = header.hasTexture != 0;
+  cached.tex_filename.assign(textureName.begin(), textureName.end());
+
+  builder = std::move(cached);
+  return true;
+}
+
+void saveMeshCache(const std::string& sourcePath, const std::string& variant, const VKModel::Builder& builder) {
+  SourceStamp stamp;
+  if (!stampSource(sourcePath, stamp)) {
+    return;
+  }
+
+  FileHeader header{};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.sourceSize = stamp.size;
+  header.sourceMtime = stamp.mtime;
+  header.sourceHash = hashSource(sourcePath);
+  header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+  header.indexCount = static_cast<uint32_t>(builder.indices.size());
+  header.lodCount = static_cast<uint32_t>(builder.lods.size());
+  header.hasTexture = builder.has_texture ? 1 : 0;
+  header.textureNameSize = static_cast<uint32_t>(builder.tex_filename.size());
+  header.vertexSize = sizeof(VKModel::Vertex);
+
+  std::vector<uint32_t> lodSizes;
+  for (const std::vector<uint32_t>& lod : builder.lods) {
+    lodSizes.push_back(static_cast<uint32_t>(lod.size()));
+  }
+
+  // In the order FileHeader describes
+  std::vector<FileBlob> blobs = {
+      {lodSizes.data(), lodSizes.size() * sizeof(uint32_t)},
+      {builder.tex_filename.data(), builder.tex_filename.size()},
+      {builder.vertices.data(), builder.vertices.size() * sizeof(VKModel::Vertex)},
+      {builder.indices.data(), builder.indices.size() * sizeof(uint32_t)}};
+  for (const std::vector<uint32_t>& lod : builder.lods) {
+    blobs.push_back({lod.data(), lod.size() * sizeof(uint32_t)});
+  }
+  writeFileAtomically("mesh cache", cacheFilePath(sourcePath, variant), header, blobs);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "vulkan-model.hpp"
+
+// std
+#include <string>
+
+// Finished VKModel::Builders (parsed, recoloured, optimized, with LODs)
+// cached on disk (MESH_CACHE_DIR) so later runs skip tinyobj, the vertex
+// dedup, the optimizer and the simplifier.
+//
+// One file per source path and variant (the colour override, which is
+// baked into the vertices). An entry is used as is when the source's size
+// and mtime match; otherwise its bytes are hashed and the entry still
+// counts if the content is unchanged. A material (.mtl) edit alone is not
+// noticed; bump VERSION in the .cpp when the mesh pipeline changes.
+//
+// Files are memory-mapped and the blobs copied straight into the builder.
+bool loadMeshCache(const std::string& sourcePath, const std::string& variant, VKModel::Builder& builder);
+void saveMeshCache(const std::string& sourcePath, const std::string& variant, const VKModel::Builder& builder);
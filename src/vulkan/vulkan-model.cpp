@@ -1,5 +1,9 @@
 #include "utils/debug.h"
 #include "vulkan-model.hpp"
+#include "vulkan-mesh-cache.hpp"
+#include "vulkan-textures.hpp"
+#include "mesh/mesh_optimize.hpp"
+#include "mesh/mesh_simplify.hpp"
 
 // libs
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -8,11 +12,15 @@
 #include <extern/stb_image.h>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <glm/glm.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <unordered_map>
 #include <filesystem>
@@ -43,268 +51,198 @@ VKModel::VKModel(
     const VKModel::Builder& builder)
     : m_device(device)
 {
-    if (m_device.cur_texture >= VKDeviceManager::MAX_TEXTURES) {
-        throw std::runtime_error("TOO MANY TEXTURES!!!");
+    // Shared textures (e.g. the default) are only uploaded once
+    texture_id = static_cast<int32_t>(m_device.textures().loadTexture(texturePath(builder)));
+
+    assert(builder.vertices.size() >= 3 && "Vertex count must be at least 3");
+    std::vector<CompactVertex> compact = compressVertices(builder.vertices);
+
+    // One allocation for all levels so every LOD shares the vertex range
+    std::vector<uint32_t> indices = builder.indices;
+    std::vector<uint32_t> lodIndexCounts{static_cast<uint32_t>(builder.indices.size())};
+    for (const std::vector<uint32_t>& lod : builder.lods) {
+        if (lodIndexCounts.size() == MAX_LODS) break;
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        lodIndexCounts.push_back(static_cast<uint32_t>(lod.size()));
     }
+
+    m_geometry = m_device.geometry().allocate(
+        compact.data(),
+        static_cast<uint32_t>(compact.size()),
+        indices.data(),
+        static_cast<uint32_t>(indices.size()));
+
+    uint32_t firstIndex = m_geometry.firstIndex;
+    for (uint32_t indexCount : lodIndexCounts) {
+        GeometryRange lod = m_geometry;
+        lod.firstIndex = firstIndex;
+        lod.indexCount = indexCount;
+        m_lods.push_back(lod);
+        firstIndex += indexCount;
+    }
+}
+
+std::string VKModel::texturePath(const Builder& builder) {
     if (builder.has_texture) {
-        tex_filename = "../resources/models/" + builder.tex_filename;
-    } else {
-        tex_filename = "../resources/textures/andyVanDam.jpg";
+        return "../resources/models/" + builder.tex_filename;
     }
-    createTextureImage();
-    createTextureImageView();
-    createTextureSampler();
-    createVertexBuffers(builder.vertices);
-    createIndexBuffers(builder.indices);
-
-    texture_id = m_device.cur_texture;
-    m_device.cur_texture++;
+    return "../resources/textures/andyVanDam.jpg";
 }
 
 VKModel::~VKModel() {
-    vkDestroyImage(m_device.device(), textureImage, nullptr);
-    vkFreeMemory(m_device.device(), textureImageMemory, nullptr);
+    m_device.geometry().free(m_geometry);
 }
 
-void VKModel::createImage(
-    uint32_t width,
-    uint32_t height,
-    VkFormat format,
-    VkImageTiling tiling,
-    VkImageUsageFlags usage,
-    VkMemoryPropertyFlags properties,
-    VkImage& image,
-    VkDeviceMemory& imageMemory
-) {
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = width;
-    imageInfo.extent.height = height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = format;
-    imageInfo.tiling = tiling;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = usage;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    m_device.createImageWithInfo(
-        imageInfo,
-        properties,
-        image,
-        imageMemory
-    );
+static int16_t toSnorm16(float v) {
+    return static_cast<int16_t>(std::round(std::clamp(v, -1.f, 1.f) * 32767.f));
 }
 
-void VKModel::createTextureImage(void) {
-    int texWidth, texHeight, texChannels;
-
-    stbi_uc* pixels = nullptr;
-
-    // JANKTEX
-
-    pixels = stbi_load(tex_filename.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+static uint16_t toUnorm16(float v) {
+    return static_cast<uint16_t>(std::round(std::clamp(v, 0.f, 1.f) * 65535.f));
+}
 
-    if (!pixels) {
-        throw std::runtime_error("failed to load texture image: " + tex_filename);
+// Octahedral normal encoding (Cigolle et al. 2014); decoded in simple_shader.vert
+static glm::vec2 octEncode(glm::vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p{n.x, n.y};
+    if (n.z < 0.f) {
+        p = {
+            (1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f),
+            (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f),
+        };
     }
-
-    VKBufferMgr stagingBuffer{
-        m_device,
-        imageSize,
-        1,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-    };
-
-    // Copy image data to a buffer
-    stagingBuffer.map();
-    stagingBuffer.writeToBuffer(pixels);
-    stagingBuffer.unmap();
-
-    stbi_image_free(pixels);
-
-    createImage(
-        texWidth,
-        texHeight,
-        VK_FORMAT_R8G8B8A8_SRGB,
-        VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        textureImage,
-        textureImageMemory
-    );
-
-    // Change the texture image layout
-    m_device.transitionImageLayout(textureImage,
-                                   VK_FORMAT_R8G8B8A8_SRGB,
-                                   VK_IMAGE_LAYOUT_UNDEFINED,
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    // Copy to the destination buffer
-    m_device.copyBufferToImage(stagingBuffer.getBuffer(),
-                               textureImage,
-                               static_cast<uint32_t>(texWidth),
-                               static_cast<uint32_t>(texHeight),
-                               1);
-
-    // Cleanup
-    m_device.transitionImageLayout(textureImage,
-                                   VK_FORMAT_R8G8B8A8_SRGB,
-                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    return p;
 }
 
-void VKModel::createTextureSampler(void) {
-    VkSamplerCreateInfo samplerInfo{};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-    samplerInfo.anisotropyEnable = VK_TRUE;
-    samplerInfo.maxAnisotropy = m_device.properties.limits.maxSamplerAnisotropy;
-
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-
-    if (vkCreateSampler(m_device.device(), &samplerInfo, nullptr, &m_device.textureSampler[m_device.cur_texture]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create texture sampler!");
+std::vector<VKModel::CompactVertex> VKModel::compressVertices(const std::vector<Vertex>& vertices) {
+    glm::vec3 boundsMax{-INFINITY};
+    m_boundsMin = glm::vec3{INFINITY};
+    glm::vec3 colorSum{0.f};
+    for (const Vertex& vertex : vertices) {
+        m_boundsMin = glm::min(m_boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+        colorSum += vertex.color;
     }
+    // Flat meshes (e.g. quad.obj) have a zero extent along one axis
+    m_boundsExtent = glm::max(boundsMax - m_boundsMin, glm::vec3{1e-6f});
+    m_boundsRadius = 0.5f * glm::length(m_boundsExtent);
+    // Per-vertex colours are either uniform (override_color) or tinyobj's
+    // default white, so the average is exact for every mesh we load
+    m_color = colorSum / static_cast<float>(vertices.size());
+
+    std::vector<CompactVertex> compact(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex& vertex = vertices[i];
+        CompactVertex& out = compact[i];
+
+        glm::vec3 p = (vertex.position - m_boundsMin) / m_boundsExtent;
+        out.position[0] = toUnorm16(p.x);
+        out.position[1] = toUnorm16(p.y);
+        out.position[2] = toUnorm16(p.z);
+        out.position[3] = 0;
+
+        glm::vec3 n = vertex.normal;
+        glm::vec2 oct = glm::dot(n, n) > 0.f ? octEncode(glm::normalize(n)) : glm::vec2{0.f};
+        out.normal[0] = toSnorm16(oct.x);
+        out.normal[1] = toSnorm16(oct.y);
+
+        out.uv[0] = glm::packHalf1x16(vertex.uv.x);
+        out.uv[1] = glm::packHalf1x16(vertex.uv.y);
+    }
+    return compact;
 }
 
-void VKModel::createTextureImageView() {
-    m_device.textureImageView[m_device.cur_texture] =
-        m_device.createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB);
+glm::mat4 VKModel::getPositionMatrix(const glm::mat4& modelMatrix) const {
+    // modelMatrix * translate(min) * scale(extent), without the full multiply
+    glm::mat4 result = modelMatrix;
+    result[0] *= m_boundsExtent.x;
+    result[1] *= m_boundsExtent.y;
+    result[2] *= m_boundsExtent.z;
+    result[3] = modelMatrix * glm::vec4(m_boundsMin, 1.f);
+    return result;
 }
 
-std::unique_ptr<VKModel> VKModel::createModelFromFile(
-    VKDeviceManager& device,
+VKModel::Builder VKModel::loadBuilderFromFile(
     const std::string& filepath,
     bool override_color,
     glm::vec3 color
 ) {
     Builder builder{};
+    const std::string path = ENGINE_DIR + filepath;
+
+    // The override is baked into the vertices, so it picks the cache entry
+    std::string variant;
+    if (override_color) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%a,%a,%a", color.r, color.g, color.b);
+        variant = buffer;
+    }
+    if (loadMeshCache(path, variant, builder)) {
+        return builder;
+    }
 
     // Use specified color if override is enabled
-    builder.loadModel(ENGINE_DIR + filepath);
+    builder.loadModel(path);
     if (override_color) {
         for (Vertex &vertex : builder.vertices) {
             vertex.color = color;
         }
     }
 
-    return std::make_unique<VKModel>(device, builder);
+    builder.optimize(filepath);
+    builder.buildLods();
+    saveMeshCache(path, variant, builder);
+    return builder;
 }
 
-void VKModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
-  vertexCount = static_cast<uint32_t>(vertices.size());
-  assert(vertexCount >= 3 && "Vertex count must be at least 3");
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-  uint32_t vertexSize = sizeof(vertices[0]);
-
-  VKBufferMgr stagingBuffer{
-      m_device,
-      vertexSize,
-      vertexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)vertices.data());
-
-  vertexBuffer = std::make_unique<VKBufferMgr>(
-      m_device,
-      vertexSize,
-      vertexCount,
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  m_device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+std::unique_ptr<VKModel> VKModel::createModelFromFile(
+    VKDeviceManager& device,
+    const std::string& filepath,
+    bool override_color,
+    glm::vec3 color
+) {
+    return std::make_unique<VKModel>(device, loadBuilderFromFile(filepath, override_color, color));
 }
 
-void VKModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
-  indexCount = static_cast<uint32_t>(indices.size());
-  hasIndexBuffer = indexCount > 0;
+// Screen-height fractions below which LOD 1, 2 and 3 take over
+static constexpr float LOD_SCREEN_FRACTIONS[VKModel::MAX_LODS - 1] = {0.25f, 0.1f, 0.04f};
+static constexpr float LOD_HYSTERESIS = 0.15f;
 
-  if (!hasIndexBuffer) {
-    return;
-  }
-
-  VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-  uint32_t indexSize = sizeof(indices[0]);
-
-  VKBufferMgr stagingBuffer{
-      m_device,
-      indexSize,
-      indexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)indices.data());
-
-  indexBuffer = std::make_unique<VKBufferMgr>(
-      m_device,
-      indexSize,
-      indexCount,
-      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  m_device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+uint32_t VKModel::selectLod(float screenFraction, uint32_t currentLod) const {
+    uint32_t lod = 0;
+    while (lod + 1 < m_lods.size() && screenFraction < LOD_SCREEN_FRACTIONS[lod]) {
+        lod++;
+    }
+    // Only refine once the model is clearly past the threshold it crossed
+    if (lod < currentLod && currentLod < m_lods.size() &&
+        screenFraction < LOD_SCREEN_FRACTIONS[currentLod - 1] * (1.f + LOD_HYSTERESIS)) {
+        lod = currentLod;
+    }
+    return lod;
 }
 
-void VKModel::draw(VkCommandBuffer commandBuffer) {
-  if (hasIndexBuffer) {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
-  } else {
-    vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
-  }
+void VKModel::draw(VkCommandBuffer commandBuffer, uint32_t lod) {
+  m_device.geometry().draw(commandBuffer, m_lods[std::min<size_t>(lod, m_lods.size() - 1)]);
 }
 
 void VKModel::bind(VkCommandBuffer commandBuffer) {
-  VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-
-  if (hasIndexBuffer) {
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
-  }
+  m_device.geometry().bind(commandBuffer, m_geometry.page);
 }
 
-std::vector<VkVertexInputBindingDescription> VKModel::Vertex::getBindingDescriptions() {
+std::vector<VkVertexInputBindingDescription> VKModel::CompactVertex::getBindingDescriptions() {
   std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
   bindingDescriptions[0].binding = 0;
-  bindingDescriptions[0].stride = sizeof(Vertex);
+  bindingDescriptions[0].stride = sizeof(CompactVertex);
   bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
   return bindingDescriptions;
 }
 
-std::vector<VkVertexInputAttributeDescription> VKModel::Vertex::getAttributeDescriptions() {
+std::vector<VkVertexInputAttributeDescription> VKModel::CompactVertex::getAttributeDescriptions() {
   std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
-  attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
-  attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
-  attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
-  attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)});
+  attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(CompactVertex, position)});
+  attributeDescriptions.push_back({1, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal)});
+  attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv)});
 
   return attributeDescriptions;
 }
@@ -398,6 +336,102 @@ static void printVertex(const VKModel::Vertex& v, int32_t idx) {
     return;
 }
 
+void VKModel::Builder::optimize(const std::string &name) {
+    VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        positions[i] = vertices[i].position;
+    }
+
+    std::vector<uint32_t> clusters;
+    optimizeVertexCache(indices, vertices.size(), &clusters);
+    optimizeOverdraw(indices, clusters, positions);
+
+    std::vector<uint32_t> remap = optimizeVertexFetch(indices, vertices.size());
+    std::vector<Vertex> reordered(vertices.size());
+    size_t used = 0;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (remap[i] != UINT32_MAX) {
+            reordered[remap[i]] = vertices[i];
+            used++;
+        }
+    }
+    reordered.resize(used);
+    vertices = std::move(reordered);
+
+    VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+    std::cout << name << ": ACMR " << before.acmr << " -> " << after.acmr
+              << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+// Small meshes are cheap enough already and simplify badly
+static constexpr size_t LOD_MIN_TRIANGLES = 512;
+// Each level's share of the LOD 0 triangles and its error budget (fraction of
+// the mesh's largest dimension)
+static constexpr float LOD_TRIANGLE_RATIOS[VKModel::MAX_LODS - 1] = {0.5f, 0.25f, 0.1f};
+static constexpr float LOD_MAX_ERRORS[VKModel::MAX_LODS - 1] = {0.005f, 0.015f, 0.04f};
+
+void VKModel::Builder::buildLods() {
+    lods.clear();
+    if (indices.size() / 3 < LOD_MIN_TRIANGLES) {
+        return;
+    }
+
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        positions[i] = vertices[i].position;
+    }
+
+    const std::vector<uint32_t>* previous = &indices;
+    for (uint32_t level = 0; level < MAX_LODS - 1; level++) {
+        size_t target = static_cast<size_t>(indices.size() / 3 * LOD_TRIANGLE_RATIOS[level]) * 3;
+        std::vector<uint32_t> lod = simplifyMesh(positions, *previous, target, LOD_MAX_ERRORS[level]);
+        // Not worth a level if the error budget stopped it early
+        if (lod.size() > previous->size() * 0.85f) {
+            break;
+        }
+        optimizeVertexCache(lod, vertices.size());
+        lods.push_back(std::move(lod));
+        previous = &lods.back();
+    }
+}
+
+void VKModel::Builder::appendTransformed(
+    const Builder &source,
+    const glm::mat4 &transform,
+    const glm::mat3 &normalMatrix
+) {
+    const bool first = vertices.empty();
+    assert((first || lods.size() == source.lods.size()) && "Batched meshes need matching LOD counts");
+    if (first) {
+        lods.resize(source.lods.size());
+        has_texture = source.has_texture;
+        tex_filename = source.tex_filename;
+    }
+
+    const uint32_t base = static_cast<uint32_t>(vertices.size());
+    for (const Vertex& vertex : source.vertices) {
+        Vertex out = vertex;
+        out.position = glm::vec3(transform * glm::vec4(vertex.position, 1.f));
+        glm::vec3 n = normalMatrix * vertex.normal;
+        out.normal = glm::dot(n, n) > 0.f ? glm::normalize(n) : n;
+        vertices.push_back(out);
+    }
+
+    // Each copy keeps its own cache-optimized order, so the merged lists
+    // stay as cache friendly as the source
+    auto appendIndices = [base](std::vector<uint32_t>& to, const std::vector<uint32_t>& from) {
+        for (uint32_t index : from) {
+            to.push_back(base + index);
+        }
+    };
+    appendIndices(indices, source.indices);
+    for (size_t level = 0; level < lods.size(); level++) {
+        appendIndices(lods[level], source.lods[level]);
+    }
+}
+
 void VKModel::Builder::loadModel(const std::string &filepath) {
     namespace fs = std::filesystem;
     fs::path obj_path(filepath);
@@ -1,7 +1,7 @@
 #pragma once
 
-#include "vulkan-buffer.hpp"
 #include "vulkan-device.hpp"
+#include "vulkan-geometry-pool.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -14,76 +14,118 @@
 
 class VKModel {
   public:
+    // Full-precision vertex produced by the loaders
     struct Vertex {
         glm::vec3 position{};
         glm::vec3 color{};
         glm::vec3 normal{};
         glm::vec2 uv{};
 
-        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-
         bool operator==(const Vertex &other) const {
             return position == other.position && color == other.color && normal == other.normal &&
                    uv == other.uv;
         }
     };
 
+    // What actually lives in the geometry pool (16 bytes instead of 44):
+    //  - position: unorm16 within the mesh AABB (dequantized via the model matrix)
+    //  - normal: octahedral-encoded snorm16
+    //  - uv: half floats
+    // Colour is constant per model and travels in the push constants instead.
+    struct CompactVertex {
+        uint16_t position[4];
+        int16_t normal[2];
+        uint16_t uv[2];
+
+        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+    };
+    static_assert(sizeof(CompactVertex) == 16, "CompactVertex must stay 16 bytes");
+
     struct Builder {
         std::vector<Vertex> vertices{};
         std::vector<uint32_t> indices{};
 
+        // Simplified index lists (LOD 1..n) over the same vertices, coarsest last
+        std::vector<std::vector<uint32_t>> lods{};
+
         bool has_texture = false;
         std::string tex_filename;
 
         void loadModelWithMaterial(const std::string &filepath);
         void loadModel(const std::string &filepath);
+        // Reorders indices for the post-transform cache and overdraw, then
+        // vertices for fetch locality (see mesh/mesh_optimize.hpp), and prints
+        // the before/after ACMR and ATVR under the given name
+        void optimize(const std::string &name);
+        // Fills lods by repeatedly simplifying indices (see mesh/mesh_simplify.hpp)
+        void buildLods();
+        // Appends a copy of source with transform baked into its positions and
+        // normalMatrix into its normals, LODs included, for static batching.
+        // Every source appended to one builder needs the same LOD count.
+        void appendTransformed(
+            const Builder &source,
+            const glm::mat4 &transform,
+            const glm::mat3 &normalMatrix);
     };
 
+    static constexpr uint32_t MAX_LODS = 4;
+
     VKModel(VKDeviceManager& device, const VKModel::Builder &builder);
     ~VKModel();
 
     VKModel(const VKModel&) = delete;
     VKModel &operator=(const VKModel &) = delete;
 
+  // Loads, recolours, optimizes and simplifies a mesh without uploading it
+  static Builder loadBuilderFromFile(
+      const std::string& filepath,
+      bool override_color = false,
+      glm::vec3 color = glm::vec3(0.f,0.f,0.f)
+  );
   static std::unique_ptr<VKModel> createModelFromFile(
       VKDeviceManager& device,
       const std::string& filepath,
       bool override_color = false,
       glm::vec3 color = glm::vec3(0.f,0.f,0.f)
   );
+  // The texture a model made from builder samples (its material's, or the
+  // default)
+  static std::string texturePath(const Builder& builder);
 
+    // Binds the shared geometry page this model lives in; consecutive models
+    // in the same page only need to bind once
     void bind(VkCommandBuffer commandBuffer);
-    void draw(VkCommandBuffer commandBuffer);
+    void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
+    uint32_t getGeometryPage() const { return m_geometry.page; }
+    uint32_t getLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+    // Picks an LOD from the fraction of the screen height the model's bounding
+    // sphere covers. Switching back to a finer level needs a margin past the
+    // threshold so objects sitting on a boundary do not pop every frame.
+    uint32_t selectLod(float screenFraction, uint32_t currentLod) const;
+    // Object-space bounding sphere (scaled by the model matrix for world space)
+    glm::vec3 getBoundsCenter() const { return m_boundsMin + 0.5f * m_boundsExtent; }
+    float getBoundsRadius() const { return m_boundsRadius; }
+    // Folds the position dequantization (AABB min + extent) into modelMatrix
+    glm::mat4 getPositionMatrix(const glm::mat4& modelMatrix) const;
+    const glm::vec3& getColor() const { return m_color; }
+    const GeometryRange& getGeometry() const { return m_geometry; }
+    // Index into the bindless texture array (see VKTextureRegistry)
     int32_t texture_id;
   private:
-    void createImage(
-        uint32_t width,
-        uint32_t height,
-        VkFormat format,
-        VkImageTiling tiling,
-        VkImageUsageFlags usage,
-        VkMemoryPropertyFlags properties,
-        VkImage& image,
-        VkDeviceMemory& imageMemory
-    );
-
-    void createTextureImage(void);
-    void createTextureImageView(void);
-    void createTextureSampler(void);
-    void createVertexBuffers(const std::vector<Vertex>& vertices);
-    void createIndexBuffers(const std::vector<uint32_t>& indices);
+    // Also computes the bounds and model colour
+    std::vector<CompactVertex> compressVertices(const std::vector<Vertex>& vertices);
 
     VKDeviceManager& m_device;
 
-    std::unique_ptr<VKBufferMgr> vertexBuffer;
-    uint32_t vertexCount;
-
-    bool hasIndexBuffer = false;
-    std::unique_ptr<VKBufferMgr> indexBuffer;
-    uint32_t indexCount;
+    // Vertices and indices are suballocated from the device's geometry pool.
+    // Every LOD's indices follow LOD 0's in the same allocation; m_lods holds
+    // the per-level slices of m_geometry.
+    GeometryRange m_geometry;
+    std::vector<GeometryRange> m_lods;
 
-    std::string tex_filename;
-    VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
+    glm::vec3 m_boundsMin{0.f};
+    glm::vec3 m_boundsExtent{1.f};
+    float m_boundsRadius = 0.f;
+    glm::vec3 m_color{1.f};
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "vulkan-device.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+// Stand-in for VKSwapChain when there is no window: one colour + depth image
+// pair per frame in flight, rendered into and left in TRANSFER_SRC layout so a
+// finished frame can be read back. Image index == frame slot, so acquiring
+// only waits for the slot's previous submission.
+class VKOffscreenTarget {
+ public:
+  VKOffscreenTarget(VKDeviceManager& deviceRef, VkExtent2D extent);
+  ~VKOffscreenTarget();
+
+  VKOffscreenTarget(const VKOffscreenTarget&) = delete;
+  VKOffscreenTarget &operator=(const VKOffscreenTarget&) = delete;
+
+  VkFramebuffer getFrameBuffer(int index) { return framebuffers[index]; }
+  VkRenderPass getRenderPass() { return renderPass; }
+  VkFormat getColorFormat() { return colorFormat; }
+  VkExtent2D getExtent() { return extent; }
+
+  float extentAspectRatio() {
+    return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+  }
+
+  // Images exist for MAX_FRAMES_IN_FLIGHT slots; only the first n are used.
+  // The caller makes sure the GPU is idle before changing it.
+  void setFramesInFlight(uint32_t n);
+  void waitForFrameSlot();
+  VkResult acquireNextImage(uint32_t *imageIndex);
+  VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+
+  // Waits for the image's last frame and copies it out as tightly packed RGBA8
+  void readback(uint32_t imageIndex, std::vector<uint8_t>& rgba);
+
+ private:
+  void createRenderPass();
+  void createImages();
+  void createFramebuffers();
+  void createSyncObjects();
+
+  VKDeviceManager& m_device;
+  VkExtent2D extent;
+  VkFormat colorFormat = VK_FORMAT_R8G8B8A8_SRGB;
+  VkFormat depthFormat;
+
+  VkRenderPass renderPass;
+  std::vector<VkFramebuffer> framebuffers;
+
+  std::vector<VkImage> colorImages;
+  std::vector<VKAllocation> colorImageMemorys;
+  std::vector<VkImageView> colorImageViews;
+  std::vector<VkImage> depthImages;
+  std::vector<VKAllocation> depthImageMemorys;
+  std::vector<VkImageView> depthImageViews;
+
+  std::vector<VkFence> inFlightFences;
+  size_t currentFrame = 0;
+  uint32_t framesInFlight = 2;
+};
@@ -0,0 +1,132 @@
+#include "vulkan-pipeline-cache.hpp"
+
+#include "utils/file_cache.h"
+
+// std
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#ifndef PIPELINE_CACHE_DIR
+#define PIPELINE_CACHE_DIR "../cache/"
+#endif
+
+VKPipelineCache::VKPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties)
+    : m_device(device), m_properties(properties) {
+  std::string data;
+  m_warm = load(data);
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = m_warm ? data.size() : 0;
+  cacheInfo.pInitialData = m_warm ? data.data() : nullptr;
+
+  if (vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_cache) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+VKPipelineCache::~VKPipelineCache() {
+  save();
+  vkDestroyPipelineCache(m_device, m_cache, nullptr);
+}
+
+std::string VKPipelineCache::cachePath() const {
+  return std::string(PIPELINE_CACHE_DIR) + "pipeline_cache.bin";
+}
+
+VKPipelineCache::FileHeader VKPipelineCache::makeHeader() const {
+  FileHeader header{};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.vendorID = m_properties.vendorID;
+  header.deviceID = m_properties.deviceID;
+  header.driverVersion = m_properties.driverVersion;
+  memcpy(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+  return header;
+}
+
+bool VKPipelineCache::load(std::string& data) {
+  std::ifstream file{cachePath(), std::ios::binary};
+  if (!file.is_open()) {
+    return false;
+  }
+  std::string contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+  FileHeader header;
+  if (contents.size() < sizeof(header)) {
+    std::cout << "pipeline cache: truncated file, starting cold" << std::endl;
+    return false;
+  }
+  memcpy(&header, contents.data(), sizeof(header));
+
+  FileHeader expected = makeHeader();
+  if (header.magic != expected.magic || header.version != expected.version ||
+      header.vendorID != expected.vendorID || header.deviceID != expected.deviceID ||
+      header.driverVersion != expected.driverVersion ||
+      memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    std::cout << "pipeline cache: device or driver changed, starting cold" << std::endl;
+    return false;
+  }
+
+  data = contents.substr(sizeof(header));
+  // The checksum only catches truncated or corrupted files
+  if (data.size() != header.dataSize || hashBytes(data.data(), data.size()) != header.dataHash) {
+    std::cout << "pipeline cache: checksum mismatch, starting cold" << std::endl;
+    return false;
+  }
+
+  // The driver's own header: length, version, vendorID, deviceID, UUID
+  const size_t driverHeaderSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (data.size() < driverHeaderSize) {
+    return false;
+  }
+  uint32_t driverVendorID, driverDeviceID;
+  memcpy(&driverVendorID, data.data() + 2 * sizeof(uint32_t), sizeof(uint32_t));
+  memcpy(&driverDeviceID, data.data() + 3 * sizeof(uint32_t), sizeof(uint32_t));
+  if (driverVendorID != expected.vendorID || driverDeviceID != expected.deviceID ||
+      memcmp(data.data() + 4 * sizeof(uint32_t), expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+    std::cout << "pipeline cache: blob was built for another device, starting cold" << std::endl;
+    return false;
+  }
+
+  m_coldCreateMicros = header.coldCreateMicros;
+  return true;
+}
+
+void VKPipelineCache::save() {
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(m_device, m_cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+    return;
+  }
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(m_device, m_cache, &dataSize, data.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  FileHeader header = makeHeader();
+  header.dataSize = dataSize;
+  header.dataHash = hashBytes(data.data(), dataSize);
+  header.coldCreateMicros = m_warm ? m_coldCreateMicros : m_createMicros;
+
+  writeFileAtomically("pipeline cache", cachePath(), header, {{data.data(), dataSize}});
+}
+
+void VKPipelineCache::recordPipelineCreation(int64_t micros) {
+  m_createMicros += micros;
+  m_pipelineCount++;
+}
+
+void VKPipelineCache::printReport() const {
+  double createMs = m_createMicros / 1000.0;
+  std::cout << "pipeline cache: " << (m_warm ? "warm" : "cold") << ", created "
+            << m_pipelineCount << " pipelines in " << createMs << " ms";
+  if (m_warm && m_coldCreateMicros > 0) {
+    std::cout << " (cold start took " << m_coldCreateMicros / 1000.0 << " ms, saved "
+              << (m_coldCreateMicros - m_createMicros) / 1000.0 << " ms)";
+  }
+  std::cout << std::endl;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <string>
+
+// A VkPipelineCache persisted to disk between runs and shared by every
+// VulkanPipeline.
+//
+// The blob is wrapped in a small header recording the device, driver version
+// and pipelineCacheUUID it was produced on; anything that doesn't match (or
+// fails its checksum) is discarded and the cache starts cold. The header also
+// remembers how long pipeline creation took on the last cold start, so warm
+// starts can report how much time the cache saved.
+class VKPipelineCache {
+ public:
+  VKPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties);
+  // Writes the cache back to disk
+  ~VKPipelineCache();
+
+  VKPipelineCache(const VKPipelineCache &) = delete;
+  VKPipelineCache &operator=(const VKPipelineCache &) = delete;
+
+  VkPipelineCache getCache() const { return m_cache; }
+  bool isWarm() const { return m_warm; }
+
+  // Called by VulkanPipeline with the time spent in vkCreateGraphicsPipelines
+  void recordPipelineCreation(int64_t micros);
+  void printReport() const;
+
+ private:
+  struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t dataHash;
+    // Pipeline creation time of the run that first populated the cache
+    int64_t coldCreateMicros;
+  };
+
+  static constexpr uint32_t MAGIC = 0x50434C48;  // "HLCP"
+  static constexpr uint32_t VERSION = 1;
+
+  std::string cachePath() const;
+  bool load(std::string& data);
+  void save();
+  FileHeader makeHeader() const;
+
+  VkDevice m_device;
+  VkPhysicalDeviceProperties m_properties;
+  VkPipelineCache m_cache = VK_NULL_HANDLE;
+
+  bool m_warm = false;
+  int64_t m_coldCreateMicros = 0;
+  int64_t m_createMicros = 0;
+  uint32_t m_pipelineCount = 0;
+};
@@ -6,6 +6,7 @@
 
 // std
 #include <cassert>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -79,7 +80,7 @@ void VulkanPipeline::createGraphicsPipeline(
   shaderStages[1].pName = "main";
   shaderStages[1].flags = 0;
   shaderStages[1].pNext = nullptr;
-  shaderStages[1].pSpecializationInfo = nullptr;
+  shaderStages[1].pSpecializationInfo = configInfo.fragmentSpecializationInfo;
 
   auto& bindingDescriptions = configInfo.bindingDescriptions;
   auto& attributeDescriptions = configInfo.attributeDescriptions;
@@ -111,15 +112,20 @@ void VulkanPipeline::createGraphicsPipeline(
   pipelineInfo.basePipelineIndex = -1;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+  VKPipelineCache& pipelineCache = m_device.pipelineCache();
+  auto startTime = std::chrono::steady_clock::now();
   if (vkCreateGraphicsPipelines(
           m_device.device(),
-          VK_NULL_HANDLE,
+          pipelineCache.getCache(),
           1,
           &pipelineInfo,
           nullptr,
           &graphicsPipeline) != VK_SUCCESS) {
     throw std::runtime_error("failed to create graphics pipeline");
   }
+  auto elapsed = std::chrono::steady_clock::now() - startTime;
+  pipelineCache.recordPipelineCreation(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
 }
 
 void VulkanPipeline::createShaderModule(
@@ -210,8 +216,8 @@ void VulkanPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
       static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
   configInfo.dynamicStateInfo.flags = 0;
 
-  configInfo.bindingDescriptions = VKModel::Vertex::getBindingDescriptions();
-  configInfo.attributeDescriptions = VKModel::Vertex::getAttributeDescriptions();
+  configInfo.bindingDescriptions = VKModel::CompactVertex::getBindingDescriptions();
+  configInfo.attributeDescriptions = VKModel::CompactVertex::getAttributeDescriptions();
 }
 
 void VulkanPipeline::enableAlphaBlending(PipelineConfigInfo& configInfo) {
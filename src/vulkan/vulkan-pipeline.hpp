@@ -27,6 +27,8 @@ struct PipelineConfigInfo {
   VkPipelineLayout pipelineLayout = nullptr;
   VkRenderPass renderPass = nullptr;
   uint32_t subpass = 0;
+  // Optional; has to stay alive until the pipeline is created
+  const VkSpecializationInfo* fragmentSpecializationInfo = nullptr;
 };
 
 class VulkanPipeline {
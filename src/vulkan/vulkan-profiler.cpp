@@ -0,0 +1,249 @@
+#include "vulkan-profiler.hpp"
+#include "vulkan-device.hpp"
+
+// std
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+static const char* FRAME_ZONE = "frame";
+
+VKProfiler::CpuScope::CpuScope(VKProfiler& profiler, const char* name)
+    : profiler(profiler.isEnabled() ? &profiler : nullptr), name(name) {
+  if (this->profiler) {
+    start = Clock::now();
+  }
+}
+
+VKProfiler::CpuScope::~CpuScope() {
+  if (profiler) {
+    profiler->recordCpuZone(name, start, Clock::now());
+  }
+}
+
+VKProfiler::GpuScope::GpuScope(VKProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+    : profiler(&profiler), commandBuffer(commandBuffer), query(UINT32_MAX) {
+  query = profiler.beginGpuZone(commandBuffer, name);
+}
+
+VKProfiler::GpuScope::~GpuScope() {
+  if (query != UINT32_MAX) {
+    profiler->endGpuZone(commandBuffer, query);
+  }
+}
+
+void VKProfiler::Zone::add(float ms) {
+  if (samples.size() < STATS_WINDOW) {
+    samples.push_back(ms);
+  } else {
+    samples[next] = ms;
+  }
+  next = (next + 1) % STATS_WINDOW;
+}
+
+VKProfiler::VKProfiler(VKDeviceManager& device, uint32_t framesInFlight)
+    : m_device(device), m_slots(framesInFlight), m_epoch(Clock::now()) {
+  // Timestamps have to be supported on the graphics queue we record into
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(m_device.getPhysicalDevice(), &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(m_device.getPhysicalDevice(), &familyCount, families.data());
+  uint32_t validBits = families[m_device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+
+  m_timestampPeriod = m_device.properties.limits.timestampPeriod;
+  m_gpuSupported = validBits > 0 && m_timestampPeriod > 0.f;
+  if (!m_gpuSupported) {
+    std::cout << "VKProfiler: GPU timestamps not supported, CPU zones only" << std::endl;
+    return;
+  }
+  m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = framesInFlight * MAX_GPU_ZONES_PER_FRAME * 2;
+  if (vkCreateQueryPool(m_device.device(), &poolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+}
+
+VKProfiler::~VKProfiler() {
+  if (m_queryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(m_device.device(), m_queryPool, nullptr);
+  }
+}
+
+double VKProfiler::toUs(Clock::time_point t) const {
+  return std::chrono::duration<double, std::micro>(t - m_epoch).count();
+}
+
+void VKProfiler::beginFrame(uint32_t frameIndex, VkCommandBuffer commandBuffer) {
+  m_currentSlot = frameIndex;
+  FrameSlot& slot = m_slots[frameIndex];
+
+  // The renderer waited on this slot's fence, so its queries are done
+  if (slot.queryCount > 0) {
+    collectGpuResults(slot, frameIndex);
+  }
+  slot.queryCount = 0;
+  slot.names.clear();
+
+  m_frameOpen = false;
+  if (!m_enabled) {
+    return;
+  }
+  slot.frame = ++m_frame;
+  if (!m_gpuSupported) {
+    return;
+  }
+  m_frameOpen = true;
+
+  uint32_t firstQuery = frameIndex * MAX_GPU_ZONES_PER_FRAME * 2;
+  vkCmdResetQueryPool(commandBuffer, m_queryPool, firstQuery, MAX_GPU_ZONES_PER_FRAME * 2);
+  beginGpuZone(commandBuffer, FRAME_ZONE);
+}
+
+void VKProfiler::endFrame(VkCommandBuffer commandBuffer) {
+  if (!m_frameOpen) {
+    return;
+  }
+  // Zone 0 is the whole frame
+  endGpuZone(commandBuffer, m_currentSlot * MAX_GPU_ZONES_PER_FRAME * 2);
+  m_slots[m_currentSlot].submitUs = toUs(Clock::now());
+  m_frameOpen = false;
+}
+
+uint32_t VKProfiler::beginGpuZone(VkCommandBuffer commandBuffer, const char* name) {
+  FrameSlot& slot = m_slots[m_currentSlot];
+  if (!m_frameOpen || slot.queryCount >= MAX_GPU_ZONES_PER_FRAME * 2) {
+    return UINT32_MAX;
+  }
+  uint32_t query = m_currentSlot * MAX_GPU_ZONES_PER_FRAME * 2 + slot.queryCount;
+  slot.queryCount += 2;
+  slot.names.push_back(name);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, query);
+  return query;
+}
+
+void VKProfiler::endGpuZone(VkCommandBuffer commandBuffer, uint32_t query) {
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, query + 1);
+}
+
+void VKProfiler::collectGpuResults(FrameSlot& slot, uint32_t frameIndex) {
+  std::vector<uint64_t> ticks(slot.queryCount);
+  VkResult result = vkGetQueryPoolResults(
+      m_device.device(),
+      m_queryPool,
+      frameIndex * MAX_GPU_ZONES_PER_FRAME * 2,
+      slot.queryCount,
+      ticks.size() * sizeof(uint64_t),
+      ticks.data(),
+      sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) {
+    return;
+  }
+
+  // GPU and CPU clocks are not calibrated against each other; line the
+  // frame's first timestamp up with the CPU submit time for the trace
+  uint64_t base = ticks[0] & m_timestampMask;
+  double usPerTick = m_timestampPeriod / 1000.0;
+  for (size_t zone = 0; zone < slot.names.size(); zone++) {
+    uint64_t begin = ticks[zone * 2] & m_timestampMask;
+    uint64_t end = ticks[zone * 2 + 1] & m_timestampMask;
+    double durationUs = double(end - begin) * usPerTick;
+
+    Zone& stats = m_zones[std::string("gpu:") + slot.names[zone]];
+    stats.gpu = true;
+    stats.add(static_cast<float>(durationUs / 1000.0));
+    addEvent({slot.frame, slot.names[zone], true, slot.submitUs + double(begin - base) * usPerTick, durationUs});
+  }
+}
+
+void VKProfiler::recordCpuZone(const char* name, Clock::time_point start, Clock::time_point end) {
+  if (!m_enabled) {
+    return;
+  }
+  double startUs = toUs(start);
+  double durationUs = std::chrono::duration<double, std::micro>(end - start).count();
+  m_zones[std::string("cpu:") + name].add(static_cast<float>(durationUs / 1000.0));
+  addEvent({m_frame, name, false, startUs, durationUs});
+}
+
+void VKProfiler::addEvent(const Event& event) {
+  if (m_events.size() < MAX_TRACE_EVENTS) {
+    m_events.push_back(event);
+  }
+}
+
+std::vector<VKProfiler::ZoneSummary> VKProfiler::getSummary() const {
+  std::vector<ZoneSummary> summary;
+  for (const auto& [key, zone] : m_zones) {
+    if (zone.samples.empty()) continue;
+    std::vector<float> sorted = zone.samples;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](float p) {
+      size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5f);
+      return sorted[index];
+    };
+    summary.push_back({key.substr(4), zone.gpu, percentile(0.5f), percentile(0.95f), percentile(0.99f)});
+  }
+  std::sort(summary.begin(), summary.end(), [](const ZoneSummary& l, const ZoneSummary& r) {
+    return l.gpu != r.gpu ? !l.gpu : l.name < r.name;
+  });
+  return summary;
+}
+
+void VKProfiler::printSummary(std::ostream& out) const {
+  out << "Profile (ms, last " << STATS_WINDOW << " frames):" << std::endl;
+  out << "\t" << std::left << std::setw(24) << "zone"
+      << std::right << std::setw(10) << "p50" << std::setw(10) << "p95"
+      << std::setw(10) << "p99" << std::endl;
+  for (const ZoneSummary& zone : getSummary()) {
+    out << "\t" << std::left << std::setw(24) << ((zone.gpu ? "gpu " : "cpu ") + zone.name)
+        << std::right << std::fixed << std::setprecision(3)
+        << std::setw(10) << zone.p50 << std::setw(10) << zone.p95
+        << std::setw(10) << zone.p99 << std::endl;
+  }
+  out.unsetf(std::ios::floatfield);
+}
+
+void VKProfiler::exportCsv(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out) {
+    throw std::runtime_error("failed to open " + path);
+  }
+  out << "frame,type,zone,start_us,duration_ms\n";
+  for (const Event& event : m_events) {
+    out << event.frame << ',' << (event.gpu ? "gpu" : "cpu") << ',' << event.name << ','
+        << event.startUs << ',' << event.durationUs / 1000.0 << '\n';
+  }
+}
+
+void VKProfiler::exportChromeTrace(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out) {
+    throw std::runtime_error("failed to open " + path);
+  }
+  // Trace Event Format: complete ("X") events, CPU on tid 0, GPU on tid 1
+  out << "{\"traceEvents\":[\n";
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+  out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+  out << std::fixed << std::setprecision(3);
+  for (const Event& event : m_events) {
+    out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu")
+        << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << (event.gpu ? 1 : 0)
+        << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs
+        << ",\"args\":{\"frame\":" << event.frame << "}}";
+  }
+  out << "\n]}\n";
+}
+
+void VKProfiler::exportAll(const std::string& directory) const {
+  std::filesystem::create_directories(directory);
+  exportCsv(directory + "/profile.csv");
+  exportChromeTrace(directory + "/profile_trace.json");
+}
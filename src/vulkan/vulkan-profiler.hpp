@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class VKDeviceManager;
+
+// Compile the scope macros out entirely with -DHL_PROFILING=0
+#ifndef HL_PROFILING
+#define HL_PROFILING 1
+#endif
+
+#define HL_PROFILE_CONCAT_(a, b) a##b
+#define HL_PROFILE_CONCAT(a, b) HL_PROFILE_CONCAT_(a, b)
+
+#if HL_PROFILING
+// Times the rest of the enclosing block on the CPU
+#define PROFILE_CPU_SCOPE(profiler, name) \
+  VKProfiler::CpuScope HL_PROFILE_CONCAT(cpuScope_, __LINE__){profiler, name}
+// Brackets the commands recorded in the rest of the block with timestamps
+#define PROFILE_GPU_SCOPE(profiler, commandBuffer, name) \
+  VKProfiler::GpuScope HL_PROFILE_CONCAT(gpuScope_, __LINE__){profiler, commandBuffer, name}
+#else
+#define PROFILE_CPU_SCOPE(profiler, name) ((void)0)
+#define PROFILE_GPU_SCOPE(profiler, commandBuffer, name) ((void)0)
+#endif
+
+// CPU phase timers and GPU timestamp queries, aggregated into rolling
+// p50/p95/p99 per zone and exportable as CSV or a Chrome trace
+// (chrome://tracing, Perfetto).
+//
+// Disabled by default; while disabled every scope is a single branch. GPU
+// results are read back one frame-in-flight later, when VKRenderer has already
+// waited on that slot's fence, so reading them never stalls.
+class VKProfiler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr uint32_t MAX_GPU_ZONES_PER_FRAME = 32;
+  // Frames of samples kept per zone for the percentiles
+  static constexpr size_t STATS_WINDOW = 300;
+  // Cap on stored events for the CSV/trace exports (stats keep going)
+  static constexpr size_t MAX_TRACE_EVENTS = 1 << 20;
+
+  struct CpuScope {
+    CpuScope(VKProfiler& profiler, const char* name);
+    ~CpuScope();
+    VKProfiler* profiler;
+    const char* name;
+    Clock::time_point start;
+  };
+
+  struct GpuScope {
+    GpuScope(VKProfiler& profiler, VkCommandBuffer commandBuffer, const char* name);
+    ~GpuScope();
+    VKProfiler* profiler;
+    VkCommandBuffer commandBuffer;
+    uint32_t query;
+  };
+
+  struct ZoneSummary {
+    std::string name;
+    bool gpu;
+    float p50;
+    float p95;
+    float p99;
+  };
+
+  VKProfiler(VKDeviceManager& device, uint32_t framesInFlight);
+  ~VKProfiler();
+
+  VKProfiler(const VKProfiler &) = delete;
+  VKProfiler &operator=(const VKProfiler &) = delete;
+
+  void setEnabled(bool enabled) { m_enabled = enabled; }
+  bool isEnabled() const { return m_enabled; }
+
+  // Called by VKRenderer right after vkBeginCommandBuffer / before
+  // vkEndCommandBuffer
+  void beginFrame(uint32_t frameIndex, VkCommandBuffer commandBuffer);
+  void endFrame(VkCommandBuffer commandBuffer);
+
+  void recordCpuZone(const char* name, Clock::time_point start, Clock::time_point end);
+
+  std::vector<ZoneSummary> getSummary() const;
+  void printSummary(std::ostream& out = std::cout) const;
+  // frame,type,zone,start_us,duration_ms
+  void exportCsv(const std::string& path) const;
+  void exportChromeTrace(const std::string& path) const;
+  // profile.csv and profile_trace.json in the given directory
+  void exportAll(const std::string& directory) const;
+
+ private:
+  struct Event {
+    uint64_t frame;
+    const char* name;
+    bool gpu;
+    double startUs;
+    double durationUs;
+  };
+
+  struct Zone {
+    std::vector<float> samples;  // ms, ring buffer of STATS_WINDOW
+    size_t next = 0;
+    bool gpu = false;
+
+    void add(float ms);
+  };
+
+  struct FrameSlot {
+    uint64_t frame = 0;
+    uint32_t queryCount = 0;
+    double submitUs = 0.0;
+    std::vector<const char*> names;  // per zone, query pair i*2, i*2+1
+  };
+
+  uint32_t beginGpuZone(VkCommandBuffer commandBuffer, const char* name);
+  void endGpuZone(VkCommandBuffer commandBuffer, uint32_t query);
+  void collectGpuResults(FrameSlot& slot, uint32_t frameIndex);
+  void addEvent(const Event& event);
+  double toUs(Clock::time_point t) const;
+
+  VKDeviceManager& m_device;
+  bool m_enabled = false;
+
+  bool m_gpuSupported = false;
+  float m_timestampPeriod = 1.f;  // ns per tick
+  uint64_t m_timestampMask = ~0ull;
+  VkQueryPool m_queryPool = VK_NULL_HANDLE;
+  std::vector<FrameSlot> m_slots;
+  uint32_t m_currentSlot = 0;
+  bool m_frameOpen = false;
+
+  uint64_t m_frame = 0;
+  Clock::time_point m_epoch;
+  std::unordered_map<std::string, Zone> m_zones;
+  std::vector<Event> m_events;
+};
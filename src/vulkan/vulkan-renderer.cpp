@@ -3,36 +3,94 @@
 // std
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <stdexcept>
 
+using Clock = std::chrono::steady_clock;
+
+static double millisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
 VKRenderer::VKRenderer(
     GlfwWindow& window,
     VKDeviceManager& device
-  ) : m_window(window), m_device(device)
+  ) : m_window(&window),
+      m_device(device),
+      m_frameAllocator(device, FRAME_ALLOCATOR_SIZE, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
 {
   recreateSwapChain();
   createCommandBuffers();
 }
 
-VKRenderer::~VKRenderer() { freeCommandBuffers(); }
+VKRenderer::VKRenderer(
+    VKDeviceManager& device,
+    VkExtent2D extent
+  ) : m_window(nullptr),
+      m_device(device),
+      m_frameAllocator(device, FRAME_ALLOCATOR_SIZE, VKSwapChain::MAX_FRAMES_IN_FLIGHT)
+{
+  m_offscreen = std::make_unique<VKOffscreenTarget>(m_device, extent);
+  createCommandBuffers();
+}
+
+VKRenderer::~VKRenderer() {
+  freeCommandBuffers();
+  m_deletionQueue.flush();
+}
 
 void VKRenderer::recreateSwapChain() {
-  auto extent = m_window.getExtent();
+  auto extent = m_window->getExtent();
   while (extent.width == 0 || extent.height == 0) {
-    extent = m_window.getExtent();
+    extent = m_window->getExtent();
     glfwWaitEvents();
   }
-  vkDeviceWaitIdle(m_device.device());
 
+  // No device-wide wait: the new swap chain takes over the frame fences, and
+  // the old one's framebuffers and depth images are only destroyed once the
+  // frames already submitted against them have completed
   if (m_swapChain == nullptr) {
-    m_swapChain = std::make_unique<VKSwapChain>(m_device, extent);
+    m_swapChain = std::make_unique<VKSwapChain>(m_device, extent, m_pacing);
   } else {
     std::shared_ptr<VKSwapChain> oldSwapChain = std::move(m_swapChain);
-    m_swapChain = std::make_unique<VKSwapChain>(m_device, extent, oldSwapChain);
+    m_swapChain = std::make_unique<VKSwapChain>(m_device, extent, oldSwapChain, m_pacing);
 
     if (!oldSwapChain->compareSwapFormats(*m_swapChain.get())) {
       throw std::runtime_error("Swap chain image(or depth) format has changed!");
     }
+    m_deletionQueue.retire(m_submittedFrames, std::move(oldSwapChain));
+  }
+
+  if (m_sceneTarget) {
+    createSceneTarget();
+  }
+}
+
+void VKRenderer::createSceneTarget() {
+  if (m_sceneTarget) {
+    m_deletionQueue.retire<VKSceneTarget>(m_submittedFrames, std::move(m_sceneTarget));
+  }
+  m_sceneTarget = std::make_unique<VKSceneTarget>(
+      m_device,
+      m_swapChain->getSwapChainExtent(),
+      m_swapChain->getSwapChainImageFormat(),
+      m_swapChain->findDepthFormat(),
+      VKSwapChain::MAX_FRAMES_IN_FLIGHT);
+}
+
+void VKRenderer::enableDynamicResolution(float gpuBudgetMs, float minScale) {
+  assert(!isFrameStarted && "Can't enable dynamic resolution while a frame is in progress");
+  if (m_offscreen) {
+    throw std::runtime_error("dynamic resolution needs a swap chain");
+  }
+  if (!m_scaler) {
+    m_scaler = std::make_unique<VKResolutionScaler>(
+        m_device, VKSwapChain::MAX_FRAMES_IN_FLIGHT, gpuBudgetMs);
+  }
+  m_scaler->setBudget(gpuBudgetMs);
+  m_scaler->setScaleRange(minScale, VKResolutionScaler::DEFAULT_MAX_SCALE);
+  if (!m_sceneTarget) {
+    createSceneTarget();
   }
 }
 
@@ -60,10 +118,51 @@ void VKRenderer::freeCommandBuffers() {
   m_commandBuffers.clear();
 }
 
+void VKRenderer::setFramePacing(const SwapChainPacing& pacing) {
+  assert(!isFrameStarted && "Can't change frame pacing while a frame is in progress");
+  if (pacing.framesInFlight < 1 || pacing.framesInFlight > VKSwapChain::MAX_FRAMES_IN_FLIGHT) {
+    throw std::runtime_error("frames in flight must be between 1 and MAX_FRAMES_IN_FLIGHT");
+  }
+
+  // Frame slots are renumbered, so nothing may be in flight
+  vkDeviceWaitIdle(m_device.device());
+  m_deletionQueue.flush();
+  m_pacing = pacing;
+  if (m_offscreen) {
+    currentFrameIndex = 0;
+    m_offscreen->setFramesInFlight(pacing.framesInFlight);
+  } else {
+    // The new swap chain carries its frame slot over the same way
+    currentFrameIndex %= pacing.framesInFlight;
+    recreateSwapChain();
+  }
+}
+
+void VKRenderer::waitForFrameSlot() {
+  auto waitStart = Clock::now();
+  if (m_offscreen) {
+    m_offscreen->waitForFrameSlot();
+  } else {
+    m_swapChain->waitForFrameSlot();
+  }
+  m_device.profiler().recordCpuZone("frame_slot_wait", waitStart, Clock::now());
+}
+
 VkCommandBuffer VKRenderer::beginFrame() {
   assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
-  auto result = m_swapChain->acquireNextImage(&currentImageIndex);
+  auto waitStart = Clock::now();
+  auto result = m_offscreen ? m_offscreen->acquireNextImage(&currentImageIndex)
+                            : m_swapChain->acquireNextImage(&currentImageIndex);
+  m_lastTimings.fenceWaitMs = millisSince(waitStart);
+  m_device.profiler().recordCpuZone("present_wait", waitStart, Clock::now());
+
+  // This slot's fence has been waited on: together with the slots before
+  // it, every frame up to framesInFlight back has completed
+  uint64_t completedFrames = m_submittedFrames + 1 >= m_pacing.framesInFlight
+      ? m_submittedFrames + 1 - m_pacing.framesInFlight
+      : 0;
+  m_deletionQueue.collect(completedFrames);
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     recreateSwapChain();
     return nullptr;
@@ -74,6 +173,7 @@ VkCommandBuffer VKRenderer::beginFrame() {
   }
 
   isFrameStarted = true;
+  m_frameAllocator.beginFrame(currentFrameIndex);
 
   auto commandBuffer = getCurrentCommandBuffer();
   VkCommandBufferBeginInfo beginInfo{};
@@ -82,27 +182,45 @@ VkCommandBuffer VKRenderer::beginFrame() {
   if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
     throw std::runtime_error("failed to begin recording command buffer!");
   }
+  m_device.profiler().beginFrame(currentFrameIndex, commandBuffer);
+  if (m_scaler) {
+    m_scaler->beginFrame(commandBuffer, currentFrameIndex);
+    m_sceneRenderExtent = m_scaler->scaledExtent(m_sceneTarget->getExtent());
+  }
   return commandBuffer;
 }
 
 void VKRenderer::endFrame() {
   assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
   auto commandBuffer = getCurrentCommandBuffer();
+  if (m_scaler) {
+    m_scaler->endFrame(commandBuffer, currentFrameIndex);
+  }
+  m_device.profiler().endFrame(commandBuffer);
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to record command buffer!");
   }
 
-  auto result = m_swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-      m_window.wasWindowResized()) {
-    m_window.resetWindowResizedFlag();
+  auto submitStart = Clock::now();
+  auto result = m_offscreen ? m_offscreen->submitCommandBuffers(&commandBuffer, &currentImageIndex)
+                            : m_swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+  m_lastTimings.submitMs = millisSince(submitStart);
+  m_device.profiler().recordCpuZone("submit", submitStart, Clock::now());
+  lastSubmittedImageIndex = currentImageIndex;
+  m_submittedFrames++;
+
+  if (m_offscreen) {
+    // Nothing to resize or recreate
+  } else if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+      m_window->wasWindowResized()) {
+    m_window->resetWindowResizedFlag();
     recreateSwapChain();
   } else if (result != VK_SUCCESS) {
     throw std::runtime_error("failed to present swap chain image!");
   }
 
   isFrameStarted = false;
-  currentFrameIndex = (currentFrameIndex + 1) % VKSwapChain::MAX_FRAMES_IN_FLIGHT;
+  currentFrameIndex = (currentFrameIndex + 1) % m_pacing.framesInFlight;
 }
 
 void VKRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
@@ -113,11 +231,12 @@ void VKRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
 
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  renderPassInfo.renderPass = m_swapChain->getRenderPass();
-  renderPassInfo.framebuffer = m_swapChain->getFrameBuffer(currentImageIndex);
+  renderPassInfo.renderPass = getSwapChainRenderPass();
+  renderPassInfo.framebuffer = getFrameBuffer(currentImageIndex);
 
+  VkExtent2D extent = getExtent();
   renderPassInfo.renderArea.offset = {0, 0};
-  renderPassInfo.renderArea.extent = m_swapChain->getSwapChainExtent();
+  renderPassInfo.renderArea.extent = extent;
 
   std::array<VkClearValue, 2> clearValues{};
   clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
@@ -130,11 +249,11 @@ void VKRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
   VkViewport viewport{};
   viewport.x = 0.0f;
   viewport.y = 0.0f;
-  viewport.width = static_cast<float>(m_swapChain->getSwapChainExtent().width);
-  viewport.height = static_cast<float>(m_swapChain->getSwapChainExtent().height);
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
-  VkRect2D scissor{{0, 0}, m_swapChain->getSwapChainExtent()};
+  VkRect2D scissor{{0, 0}, extent};
   vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
   vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
@@ -146,3 +265,43 @@ void VKRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
       "Can't end render pass on command buffer from a different frame");
   vkCmdEndRenderPass(commandBuffer);
 }
+
+void VKRenderer::beginScenePass(VkCommandBuffer commandBuffer) {
+  if (!m_sceneTarget) {
+    beginSwapChainRenderPass(commandBuffer);
+    return;
+  }
+  assert(isFrameStarted && "Can't call beginScenePass if frame is not in progress");
+  assert(
+      commandBuffer == getCurrentCommandBuffer() &&
+      "Can't begin render pass on command buffer from a different frame");
+  m_sceneTarget->beginPass(commandBuffer, currentFrameIndex, m_sceneRenderExtent);
+}
+
+void VKRenderer::endScenePass(VkCommandBuffer commandBuffer) {
+  if (!m_sceneTarget) {
+    endSwapChainRenderPass(commandBuffer);
+    return;
+  }
+  assert(isFrameStarted && "Can't call endScenePass if frame is not in progress");
+  m_sceneTarget->endPass(commandBuffer);
+}
+
+VkDescriptorImageInfo VKRenderer::getSceneImageInfo() {
+  assert(m_sceneTarget && "No scene target without dynamic resolution");
+  return m_sceneTarget->colorImageInfo(currentFrameIndex);
+}
+
+void VKRenderer::readbackLastFrame(std::vector<uint8_t>& rgba) {
+  assert(m_offscreen && "Frame readback needs an offscreen renderer");
+  m_offscreen->readback(lastSubmittedImageIndex, rgba);
+}
+
+VkFramebuffer VKRenderer::getFrameBuffer(uint32_t imageIndex) {
+  return m_offscreen ? m_offscreen->getFrameBuffer(imageIndex)
+                     : m_swapChain->getFrameBuffer(imageIndex);
+}
+
+VkExtent2D VKRenderer::getExtent() {
+  return m_offscreen ? m_offscreen->getExtent() : m_swapChain->getSwapChainExtent();
+}
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "vulkan/vulkan-deletion-queue.hpp"
 #include "vulkan/vulkan-device.hpp"
+#include "vulkan/vulkan-frame-allocator.hpp"
+#include "vulkan/vulkan-offscreen.hpp"
+#include "vulkan/vulkan-resolution-scaler.hpp"
+#include "vulkan/vulkan-scene-target.hpp"
 #include "vulkan/vulkan-swapchain.hpp"
 #include "window/glfw-window.hpp"
 
@@ -9,19 +14,68 @@
 #include <memory>
 #include <vector>
 
+// CPU-side cost of the last frame's begin/end, in milliseconds
+struct FrameTimings {
+  // Waiting for the frame slot's previous submission (plus image acquire)
+  double fenceWaitMs = 0.0;
+  // vkQueueSubmit (plus present when there is a swapchain)
+  double submitMs = 0.0;
+};
+
 class VKRenderer {
  public:
+  // Transient per-frame data, see VKFrameAllocator
+  static constexpr VkDeviceSize FRAME_ALLOCATOR_SIZE = 4 << 20;
+
   VKRenderer(GlfwWindow& window, VKDeviceManager& device);
+  // Headless: renders into a VKOffscreenTarget of the given size
+  VKRenderer(VKDeviceManager& device, VkExtent2D extent);
   ~VKRenderer();
 
   VKRenderer(const VKRenderer&) = delete;
   VKRenderer &operator=(const VKRenderer &) = delete;
 
+  // The offscreen target's render pass when headless
   VkRenderPass getSwapChainRenderPass() const {
-      return m_swapChain->getRenderPass();
+      return m_offscreen ? m_offscreen->getRenderPass() : m_swapChain->getRenderPass();
+  }
+  float getAspectRatio() const {
+      return m_offscreen ? m_offscreen->extentAspectRatio() : m_swapChain->extentAspectRatio();
   }
-  float getAspectRatio() const { return m_swapChain->extentAspectRatio(); }
   bool isFrameInProgress() const { return isFrameStarted; }
+  uint32_t getFramesInFlight() const { return m_pacing.framesInFlight; }
+
+  // Waits for the GPU, then switches frames in flight and (with a window)
+  // recreates the swap chain for the new present modes
+  void setFramePacing(const SwapChainPacing& pacing);
+  // Blocks until the next frame's slot is free, so the wait can happen
+  // before input is sampled instead of inside beginFrame
+  void waitForFrameSlot();
+  const FrameTimings& getLastFrameTimings() const { return m_lastTimings; }
+  // Rewound for each frame in beginFrame
+  VKFrameAllocator& frameAllocator() { return m_frameAllocator; }
+  // Keeps object alive until every frame submitted so far has completed,
+  // e.g. a model swapped out while earlier frames may still draw it
+  template <typename T>
+  void retire(std::shared_ptr<T> object) {
+    m_deletionQueue.retire(m_submittedFrames, std::move(object));
+  }
+
+  // Renders the scene into a VKSceneTarget at whatever scale keeps the GPU
+  // frame time under gpuBudgetMs (VKResolutionScaler); the caller then
+  // upscales it inside the swap chain pass. Needs a window.
+  void enableDynamicResolution(
+      float gpuBudgetMs,
+      float minScale = VKResolutionScaler::DEFAULT_MIN_SCALE);
+  bool hasSceneTarget() const { return m_sceneTarget != nullptr; }
+  float getRenderScale() const { return m_scaler ? m_scaler->getScale() : 1.f; }
+  // This frame's scene color and the part of it that was drawn
+  VkDescriptorImageInfo getSceneImageInfo();
+  VkExtent2D getSceneRenderExtent() const { return m_sceneRenderExtent; }
+  VkExtent2D getSceneTargetExtent() const { return m_sceneTarget->getExtent(); }
+
+  // Headless only: copies out the most recently submitted frame as RGBA8
+  void readbackLastFrame(std::vector<uint8_t>& rgba);
 
   VkCommandBuffer getCurrentCommandBuffer() const {
     assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
@@ -37,18 +91,38 @@ class VKRenderer {
   void endFrame();
   void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
   void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+  // Into the scene target with dynamic resolution, otherwise the same as
+  // the swap chain pass
+  void beginScenePass(VkCommandBuffer commandBuffer);
+  void endScenePass(VkCommandBuffer commandBuffer);
 
  private:
   void createCommandBuffers();
   void freeCommandBuffers();
   void recreateSwapChain();
+  void createSceneTarget();
+  VkFramebuffer getFrameBuffer(uint32_t imageIndex);
+  VkExtent2D getExtent();
 
-  GlfwWindow& m_window;
+  // Null when headless
+  GlfwWindow* m_window;
   VKDeviceManager& m_device;
   std::unique_ptr<VKSwapChain> m_swapChain;
+  std::unique_ptr<VKOffscreenTarget> m_offscreen;
+  // Only with dynamic resolution
+  std::unique_ptr<VKSceneTarget> m_sceneTarget;
+  std::unique_ptr<VKResolutionScaler> m_scaler;
+  VkExtent2D m_sceneRenderExtent{};
+  // Retired swap chains and scene targets, kept until their frames finish
+  VKDeletionQueue m_deletionQueue;
+  uint64_t m_submittedFrames = 0;
   std::vector<VkCommandBuffer> m_commandBuffers;
+  FrameTimings m_lastTimings;
+  VKFrameAllocator m_frameAllocator;
+  SwapChainPacing m_pacing;
 
   uint32_t currentImageIndex;
+  uint32_t lastSubmittedImageIndex = 0;
   int currentFrameIndex{0};
   bool isFrameStarted{false};
 };
@@ -0,0 +1,124 @@
+#include "vulkan-resolution-scaler.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+// Aim a little under the budget so noise doesn't push frames over it
+static constexpr float BUDGET_HEADROOM = 0.9f;
+// Only scale back up once frames are this far under the (headroom) target
+static constexpr float UPSCALE_THRESHOLD = 0.85f;
+// Largest change per measured frame; down fast, up slowly
+static constexpr float MAX_STEP_DOWN = 0.1f;
+static constexpr float MAX_STEP_UP = 0.02f;
+
+VKResolutionScaler::VKResolutionScaler(
+    VKDeviceManager& deviceRef,
+    uint32_t framesInFlight,
+    float budgetMs)
+    : m_device(deviceRef),
+      m_budgetMs(budgetMs),
+      m_pending(framesInFlight, false),
+      m_slotScales(framesInFlight, DEFAULT_MAX_SCALE) {
+  // Same requirements as VKProfiler's GPU zones
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(m_device.getPhysicalDevice(), &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(m_device.getPhysicalDevice(), &familyCount, families.data());
+  uint32_t validBits = families[m_device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+
+  m_timestampPeriod = m_device.properties.limits.timestampPeriod;
+  m_supported = validBits > 0 && m_timestampPeriod > 0.f;
+  if (!m_supported) {
+    std::cout << "VKResolutionScaler: GPU timestamps not supported, rendering at full scale" << std::endl;
+    return;
+  }
+  m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = framesInFlight * 2;
+  if (vkCreateQueryPool(m_device.device(), &poolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create resolution scaler query pool!");
+  }
+}
+
+VKResolutionScaler::~VKResolutionScaler() {
+  if (m_queryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(m_device.device(), m_queryPool, nullptr);
+  }
+}
+
+void VKResolutionScaler::setScaleRange(float minScale, float maxScale) {
+  if (minScale <= 0.f || minScale > maxScale || maxScale > 1.f) {
+    throw std::runtime_error("render scale range must satisfy 0 < min <= max <= 1");
+  }
+  m_minScale = minScale;
+  m_maxScale = maxScale;
+  m_scale = std::clamp(m_scale, m_minScale, m_maxScale);
+}
+
+void VKResolutionScaler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+  if (!m_supported) {
+    return;
+  }
+
+  if (m_pending[frameIndex]) {
+    uint64_t ticks[2];
+    VkResult result = vkGetQueryPoolResults(
+        m_device.device(),
+        m_queryPool,
+        frameIndex * 2,
+        2,
+        sizeof(ticks),
+        ticks,
+        sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+      uint64_t elapsed = (ticks[1] - ticks[0]) & m_timestampMask;
+      update(static_cast<float>(double(elapsed) * m_timestampPeriod / 1e6), m_slotScales[frameIndex]);
+    }
+    m_pending[frameIndex] = false;
+  }
+
+  vkCmdResetQueryPool(commandBuffer, m_queryPool, frameIndex * 2, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, frameIndex * 2);
+  m_slotScales[frameIndex] = m_scale;
+}
+
+void VKResolutionScaler::endFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+  if (!m_supported) {
+    return;
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, frameIndex * 2 + 1);
+  m_pending[frameIndex] = true;
+}
+
+void VKResolutionScaler::update(float gpuMs, float measuredScale) {
+  m_lastGpuMs = gpuMs;
+  if (gpuMs <= 0.f || m_budgetMs <= 0.f) {
+    return;
+  }
+
+  const float target = m_budgetMs * BUDGET_HEADROOM;
+  // The scale that frame would have needed, judged from the scale it ran at
+  // rather than the current one, which may already have moved
+  const float wanted = measuredScale * std::sqrt(target / gpuMs);
+  if (wanted < m_scale) {
+    m_scale = std::max(wanted, m_scale - MAX_STEP_DOWN);
+  } else if (gpuMs < target * UPSCALE_THRESHOLD) {
+    m_scale = std::min(wanted, m_scale + MAX_STEP_UP);
+  }
+  m_scale = std::clamp(m_scale, m_minScale, m_maxScale);
+}
+
+VkExtent2D VKResolutionScaler::scaledExtent(VkExtent2D full) const {
+  auto scaleAxis = [this](uint32_t size) {
+    uint32_t scaled = static_cast<uint32_t>(size * m_scale) & ~7u;
+    return std::clamp(scaled, std::min(size, 8u), size);
+  };
+  return {scaleAxis(full.width), scaleAxis(full.height)};
+}
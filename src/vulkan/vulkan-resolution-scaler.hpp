@@ -0,0 +1,66 @@
+#pragma once
+
+#include "vulkan-device.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+// Picks the scene's render scale from measured GPU frame time.
+//
+// Every frame is bracketed with a pair of timestamps (independent of
+// VKProfiler, which is usually off). A slot's pair is read back when the
+// slot comes round again, after the renderer has waited on its fence, so
+// reading never stalls; the scale therefore reacts framesInFlight frames
+// late.
+//
+// Pixel cost goes with scale^2, so a frame that took t ms at scale s would
+// fit the budget at s * sqrt(budget / t). The scale moves there quickly when
+// over budget and creeps back up when comfortably under it, so it does not
+// oscillate around the budget.
+class VKResolutionScaler {
+ public:
+  static constexpr float DEFAULT_MIN_SCALE = 0.5f;
+  static constexpr float DEFAULT_MAX_SCALE = 1.f;
+
+  VKResolutionScaler(VKDeviceManager& deviceRef, uint32_t framesInFlight, float budgetMs);
+  ~VKResolutionScaler();
+
+  VKResolutionScaler(const VKResolutionScaler&) = delete;
+  VKResolutionScaler &operator=(const VKResolutionScaler&) = delete;
+
+  void setBudget(float budgetMs) { m_budgetMs = budgetMs; }
+  void setScaleRange(float minScale, float maxScale);
+
+  // Right after vkBeginCommandBuffer, once the slot's fence has been waited on
+  void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+  // Right before vkEndCommandBuffer
+  void endFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+  float getScale() const { return m_scale; }
+  float getLastGpuMs() const { return m_lastGpuMs; }
+  // full scaled by the current scale, rounded down to a multiple of 8 so
+  // small corrections don't change the size every frame
+  VkExtent2D scaledExtent(VkExtent2D full) const;
+
+ private:
+  void update(float gpuMs, float measuredScale);
+
+  VKDeviceManager& m_device;
+  float m_budgetMs;
+  float m_minScale = DEFAULT_MIN_SCALE;
+  float m_maxScale = DEFAULT_MAX_SCALE;
+  float m_scale = DEFAULT_MAX_SCALE;
+  float m_lastGpuMs = 0.f;
+
+  bool m_supported = false;
+  float m_timestampPeriod = 1.f;  // ns per tick
+  uint64_t m_timestampMask = ~0ull;
+  VkQueryPool m_queryPool = VK_NULL_HANDLE;
+  // Per slot: whether its queries were written, and the scale they measured
+  std::vector<bool> m_pending;
+  std::vector<float> m_slotScales;
+};
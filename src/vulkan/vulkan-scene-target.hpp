@@ -0,0 +1,68 @@
+#pragma once
+
+#include "vulkan-device.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+// Color and depth images the scene is drawn into before being upscaled to
+// the swap chain, one pair per frame in flight.
+//
+// The images are allocated at the full swap chain size; a lower render scale
+// only draws into their top left corner, so changing the scale never
+// reallocates anything. The render pass uses the swap chain's formats, which
+// keeps it compatible with the swap chain render pass: the pipelines built
+// for that one draw into this one unchanged.
+//
+// The color image is left in SHADER_READ_ONLY_OPTIMAL for the upscale pass.
+class VKSceneTarget {
+ public:
+  VKSceneTarget(
+      VKDeviceManager& deviceRef,
+      VkExtent2D extent,
+      VkFormat colorFormat,
+      VkFormat depthFormat,
+      uint32_t framesInFlight);
+  ~VKSceneTarget();
+
+  VKSceneTarget(const VKSceneTarget&) = delete;
+  VKSceneTarget &operator=(const VKSceneTarget&) = delete;
+
+  VkRenderPass getRenderPass() { return renderPass; }
+  // Full size of the images
+  VkExtent2D getExtent() const { return extent; }
+
+  // Clears and begins the pass over [0, renderExtent), with the viewport
+  // and scissor set to it
+  void beginPass(VkCommandBuffer commandBuffer, int frameIndex, VkExtent2D renderExtent);
+  void endPass(VkCommandBuffer commandBuffer);
+
+  VkDescriptorImageInfo colorImageInfo(int frameIndex);
+
+ private:
+  void createRenderPass();
+  void createImages();
+  void createFramebuffers();
+  void createSampler();
+
+  VKDeviceManager& m_device;
+  VkExtent2D extent;
+  VkFormat colorFormat;
+  VkFormat depthFormat;
+
+  VkRenderPass renderPass;
+
+  std::vector<VkImage> colorImages;
+  std::vector<VKAllocation> colorImageMemorys;
+  std::vector<VkImageView> colorImageViews;
+  std::vector<VkImage> depthImages;
+  std::vector<VKAllocation> depthImageMemorys;
+  std::vector<VkImageView> depthImageViews;
+  std::vector<VkFramebuffer> framebuffers;
+
+  VkSampler sampler;
+};
@@ -0,0 +1,327 @@
+#include "vulkan-shadow-atlas.hpp"
+
+// std
+#include <array>
+#include <stdexcept>
+
+VKShadowAtlas::VKShadowAtlas(
+    VKDeviceManager& deviceRef,
+    uint32_t tilesPerSide,
+    uint32_t tileSize,
+    uint32_t dynamicSize,
+    uint32_t framesInFlight)
+    : m_device(deviceRef),
+      tilesPerSide(tilesPerSide),
+      tileSize(tileSize),
+      atlasSize(tilesPerSide * tileSize),
+      dynamicSize(dynamicSize),
+      dynamicImages(framesInFlight),
+      dynamicImageMemorys(framesInFlight),
+      dynamicImageViews(framesInFlight),
+      dynamicFramebuffers(framesInFlight) {
+  depthFormat = m_device.findSupportedFormat(
+      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM},
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+  createRenderPasses();
+  createImages();
+  createFramebuffers();
+  createSampler();
+}
+
+VKShadowAtlas::~VKShadowAtlas() {
+  vkDestroySampler(m_device.device(), sampler, nullptr);
+
+  for (size_t i = 0; i < dynamicImages.size(); i++) {
+    vkDestroyFramebuffer(m_device.device(), dynamicFramebuffers[i], nullptr);
+    vkDestroyImageView(m_device.device(), dynamicImageViews[i], nullptr);
+    vkDestroyImage(m_device.device(), dynamicImages[i], nullptr);
+    m_device.allocator().free(dynamicImageMemorys[i]);
+  }
+
+  vkDestroyFramebuffer(m_device.device(), atlasFramebuffer, nullptr);
+  vkDestroyImageView(m_device.device(), atlasImageView, nullptr);
+  vkDestroyImage(m_device.device(), atlasImage, nullptr);
+  m_device.allocator().free(atlasImageMemory);
+
+  vkDestroyRenderPass(m_device.device(), staticRenderPass, nullptr);
+  vkDestroyRenderPass(m_device.device(), dynamicRenderPass, nullptr);
+}
+
+void VKShadowAtlas::createRenderPasses() {
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = depthFormat;
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkAttachmentReference depthAttachmentRef{};
+  depthAttachmentRef.attachment = 0;
+  depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 0;
+  subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  // Earlier frames may still be sampling the map; and the frame's own lit
+  // pass samples it right after
+  std::array<VkSubpassDependency, 2> dependencies{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &depthAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  // Atlas: keep what is there, tiles are cleared individually
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  if (vkCreateRenderPass(m_device.device(), &renderPassInfo, nullptr, &staticRenderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow atlas render pass!");
+  }
+
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if (vkCreateRenderPass(m_device.device(), &renderPassInfo, nullptr, &dynamicRenderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create dynamic shadow render pass!");
+  }
+}
+
+void VKShadowAtlas::createDepthImage(
+    uint32_t size,
+    VkImage& image,
+    VKAllocation& memory,
+    VkImageView& view
+) {
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = size;
+  imageInfo.extent.height = size;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = depthFormat;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = depthFormat;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+  if (vkCreateImageView(m_device.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow map image view!");
+  }
+}
+
+void VKShadowAtlas::createImages() {
+  createDepthImage(atlasSize, atlasImage, atlasImageMemory, atlasImageView);
+  for (size_t i = 0; i < dynamicImages.size(); i++) {
+    createDepthImage(dynamicSize, dynamicImages[i], dynamicImageMemorys[i], dynamicImageViews[i]);
+  }
+
+  // Everything starts fully lit and in the layout the passes expect, so the
+  // maps are valid to sample before anything has been drawn into them
+  VkCommandBuffer commandBuffer = m_device.beginSingleTimeCommands();
+  std::vector<VkImage> images = dynamicImages;
+  images.push_back(atlasImage);
+
+  std::vector<VkImageMemoryBarrier> barriers(images.size());
+  for (size_t i = 0; i < images.size(); i++) {
+    VkImageMemoryBarrier& barrier = barriers[i];
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = images[i];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  }
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 0, nullptr, 0, nullptr,
+      static_cast<uint32_t>(barriers.size()), barriers.data());
+
+  VkClearDepthStencilValue clearValue{1.0f, 0};
+  for (VkImageMemoryBarrier& barrier : barriers) {
+    vkCmdClearDepthStencilImage(
+        commandBuffer,
+        barrier.image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        &clearValue,
+        1,
+        &barrier.subresourceRange);
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  }
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      0, 0, nullptr, 0, nullptr,
+      static_cast<uint32_t>(barriers.size()), barriers.data());
+  m_device.endSingleTimeCommands(commandBuffer);
+}
+
+void VKShadowAtlas::createFramebuffers() {
+  VkFramebufferCreateInfo framebufferInfo = {};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.layers = 1;
+
+  framebufferInfo.renderPass = staticRenderPass;
+  framebufferInfo.pAttachments = &atlasImageView;
+  framebufferInfo.width = atlasSize;
+  framebufferInfo.height = atlasSize;
+  if (vkCreateFramebuffer(m_device.device(), &framebufferInfo, nullptr, &atlasFramebuffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow atlas framebuffer!");
+  }
+
+  framebufferInfo.renderPass = dynamicRenderPass;
+  framebufferInfo.width = dynamicSize;
+  framebufferInfo.height = dynamicSize;
+  for (size_t i = 0; i < dynamicImages.size(); i++) {
+    framebufferInfo.pAttachments = &dynamicImageViews[i];
+    if (vkCreateFramebuffer(m_device.device(), &framebufferInfo, nullptr, &dynamicFramebuffers[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create dynamic shadow framebuffer!");
+    }
+  }
+}
+
+void VKShadowAtlas::createSampler() {
+  // Hardware 2x2 PCF; outside the map counts as lit
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 1.0f;
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+  samplerInfo.compareEnable = VK_TRUE;
+  samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = 0.0f;
+
+  if (vkCreateSampler(m_device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create shadow sampler!");
+  }
+}
+
+void VKShadowAtlas::setViewport(VkCommandBuffer commandBuffer, VkRect2D area) {
+  VkViewport viewport{};
+  viewport.x = static_cast<float>(area.offset.x);
+  viewport.y = static_cast<float>(area.offset.y);
+  viewport.width = static_cast<float>(area.extent.width);
+  viewport.height = static_cast<float>(area.extent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &area);
+}
+
+void VKShadowAtlas::beginStaticPass(VkCommandBuffer commandBuffer) {
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = staticRenderPass;
+  renderPassInfo.framebuffer = atlasFramebuffer;
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = {atlasSize, atlasSize};
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void VKShadowAtlas::beginTile(VkCommandBuffer commandBuffer, uint32_t tile) {
+  VkRect2D area{};
+  area.offset = {
+      static_cast<int32_t>((tile % tilesPerSide) * tileSize),
+      static_cast<int32_t>((tile / tilesPerSide) * tileSize)};
+  area.extent = {tileSize, tileSize};
+  setViewport(commandBuffer, area);
+
+  VkClearAttachment clear{};
+  clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  clear.clearValue.depthStencil = {1.0f, 0};
+  VkClearRect clearRect{};
+  clearRect.rect = area;
+  clearRect.baseArrayLayer = 0;
+  clearRect.layerCount = 1;
+  vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &clearRect);
+}
+
+void VKShadowAtlas::beginDynamicPass(VkCommandBuffer commandBuffer, int frameIndex) {
+  VkClearValue clearValue{};
+  clearValue.depthStencil = {1.0f, 0};
+
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = dynamicRenderPass;
+  renderPassInfo.framebuffer = dynamicFramebuffers[frameIndex];
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = {dynamicSize, dynamicSize};
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearValue;
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  setViewport(commandBuffer, renderPassInfo.renderArea);
+}
+
+void VKShadowAtlas::endPass(VkCommandBuffer commandBuffer) {
+  vkCmdEndRenderPass(commandBuffer);
+}
+
+VkDescriptorImageInfo VKShadowAtlas::staticImageInfo() {
+  return {sampler, atlasImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+}
+
+VkDescriptorImageInfo VKShadowAtlas::dynamicImageInfo(int frameIndex) {
+  return {sampler, dynamicImageViews[frameIndex], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+}
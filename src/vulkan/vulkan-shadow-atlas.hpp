@@ -0,0 +1,78 @@
+#pragma once
+
+#include "vulkan-device.hpp"
+
+// vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+// Depth targets for the sun's shadows:
+//  - one persistent atlas of tilesPerSide x tilesPerSide square tiles, which
+//    keeps its contents between frames so only dirty tiles are re-rendered
+//  - one small depth map per frame in flight for dynamic casters, cleared
+//    and re-rendered every frame
+//
+// Both are left in SHADER_READ_ONLY_OPTIMAL and sampled through a compare
+// sampler (sampler2DShadow). The two render passes are compatible, so one
+// depth-only pipeline draws into either.
+class VKShadowAtlas {
+ public:
+  VKShadowAtlas(
+      VKDeviceManager& deviceRef,
+      uint32_t tilesPerSide,
+      uint32_t tileSize,
+      uint32_t dynamicSize,
+      uint32_t framesInFlight);
+  ~VKShadowAtlas();
+
+  VKShadowAtlas(const VKShadowAtlas&) = delete;
+  VKShadowAtlas &operator=(const VKShadowAtlas&) = delete;
+
+  VkRenderPass getRenderPass() { return staticRenderPass; }
+  uint32_t getTilesPerSide() const { return tilesPerSide; }
+  uint32_t getTileSize() const { return tileSize; }
+
+  // Static atlas: begin, then beginTile for each dirty tile (clears it and
+  // sets viewport/scissor to it), then end
+  void beginStaticPass(VkCommandBuffer commandBuffer);
+  void beginTile(VkCommandBuffer commandBuffer, uint32_t tile);
+  // Dynamic map for the frame: cleared, viewport covers the whole map
+  void beginDynamicPass(VkCommandBuffer commandBuffer, int frameIndex);
+  void endPass(VkCommandBuffer commandBuffer);
+
+  VkDescriptorImageInfo staticImageInfo();
+  VkDescriptorImageInfo dynamicImageInfo(int frameIndex);
+
+ private:
+  void createRenderPasses();
+  void createImages();
+  void createFramebuffers();
+  void createSampler();
+  void createDepthImage(uint32_t size, VkImage& image, VKAllocation& memory, VkImageView& view);
+  void setViewport(VkCommandBuffer commandBuffer, VkRect2D area);
+
+  VKDeviceManager& m_device;
+  uint32_t tilesPerSide;
+  uint32_t tileSize;
+  uint32_t atlasSize;
+  uint32_t dynamicSize;
+  VkFormat depthFormat;
+
+  VkRenderPass staticRenderPass;   // loads, so untouched tiles survive
+  VkRenderPass dynamicRenderPass;  // clears
+
+  VkImage atlasImage;
+  VKAllocation atlasImageMemory;
+  VkImageView atlasImageView;
+  VkFramebuffer atlasFramebuffer;
+
+  std::vector<VkImage> dynamicImages;
+  std::vector<VKAllocation> dynamicImageMemorys;
+  std::vector<VkImageView> dynamicImageViews;
+  std::vector<VkFramebuffer> dynamicFramebuffers;
+
+  VkSampler sampler;
+};
@@ -1,6 +1,8 @@
 #include "vulkan-swapchain.hpp"
+#include "vulkan-upload.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -9,22 +11,26 @@
 #include <set>
 #include <stdexcept>
 
-VKSwapChain::VKSwapChain(VKDeviceManager& deviceRef, VkExtent2D extent)
-    : m_device(deviceRef), windowExtent(extent) {
+VKSwapChain::VKSwapChain(VKDeviceManager& deviceRef, VkExtent2D extent, const SwapChainPacing& pacing)
+    : m_device(deviceRef), windowExtent(extent), pacing(pacing) {
   init();
 }
 
 VKSwapChain::VKSwapChain(
     VKDeviceManager& deviceRef,
     VkExtent2D extent,
-    std::shared_ptr<VKSwapChain> previous
-  ) : m_device(deviceRef), windowExtent(extent), oldSwapChain(previous)
+    std::shared_ptr<VKSwapChain> previous,
+    const SwapChainPacing& pacing
+  ) : m_device(deviceRef), windowExtent(extent), oldSwapChain(previous), pacing(pacing)
 {
   init();
   oldSwapChain = nullptr;
 }
 
 void VKSwapChain::init() {
+  if (pacing.framesInFlight < 1 || pacing.framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+    throw std::runtime_error("frames in flight must be between 1 and MAX_FRAMES_IN_FLIGHT");
+  }
   createSwapChain();
   createImageViews();
   createRenderPass();
@@ -47,7 +53,7 @@ VKSwapChain::~VKSwapChain() {
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(m_device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(m_device.device(), depthImages[i], nullptr);
-    vkFreeMemory(m_device.device(), depthImageMemorys[i], nullptr);
+    m_device.allocator().free(depthImageMemorys[i]);
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
@@ -56,14 +62,24 @@ VKSwapChain::~VKSwapChain() {
 
   vkDestroyRenderPass(m_device.device(), renderPass, nullptr);
 
-  // cleanup synchronization objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  // cleanup synchronization objects, unless a newer swap chain took them
+  for (size_t i = 0; i < inFlightFences.size(); i++) {
     vkDestroySemaphore(m_device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(m_device.device(), imageAvailableSemaphores[i], nullptr);
     vkDestroyFence(m_device.device(), inFlightFences[i], nullptr);
   }
 }
 
+void VKSwapChain::waitForFrameSlot() {
+  vkWaitForFences(
+      m_device.device(),
+      1,
+      &inFlightFences[currentFrame],
+      VK_TRUE,
+      std::numeric_limits<uint64_t>::max()
+  );
+}
+
 VkResult VKSwapChain::acquireNextImage(uint32_t* imageIndex) {
   vkWaitForFences(
       m_device.device(),
@@ -96,12 +112,26 @@ VkResult VKSwapChain::submitCommandBuffers(
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
+  // Also wait (on the GPU) for any uploads this frame might read from
+  VKUploadManager& uploads = m_device.uploads();
+  uint64_t uploadTicket = uploads.flush();
+
+  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame], uploads.getTimelineSemaphore()};
+  VkPipelineStageFlags waitStages[] = {
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT};
+  // The binary semaphore's value is ignored
+  uint64_t waitValues[] = {0, uploadTicket};
+  submitInfo.waitSemaphoreCount = 2;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = 2;
+  timelineInfo.pWaitSemaphoreValues = waitValues;
+  submitInfo.pNext = &timelineInfo;
+
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = buffers;
 
@@ -129,7 +159,7 @@ VkResult VKSwapChain::submitCommandBuffers(
 
   auto result = vkQueuePresentKHR(m_device.presentQueue(), &presentInfo);
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % pacing.framesInFlight;
 
   return result;
 }
@@ -141,7 +171,8 @@ void VKSwapChain::createSwapChain() {
   VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+  // Enough images that every frame in flight can hold one
+  uint32_t imageCount = std::max(swapChainSupport.capabilities.minImageCount + 1, pacing.framesInFlight);
   if (swapChainSupport.capabilities.maxImageCount > 0 &&
       imageCount > swapChainSupport.capabilities.maxImageCount) {
     imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -339,10 +370,24 @@ void VKSwapChain::createDepthResources() {
 }
 
 void VKSwapChain::createSyncObjects() {
+  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+
+  if (oldSwapChain != nullptr) {
+    // Frames still in flight on the old swap chain signal these, so the
+    // renderer's frame slots carry on across the recreation without waiting
+    imageAvailableSemaphores = std::move(oldSwapChain->imageAvailableSemaphores);
+    renderFinishedSemaphores = std::move(oldSwapChain->renderFinishedSemaphores);
+    inFlightFences = std::move(oldSwapChain->inFlightFences);
+    oldSwapChain->imageAvailableSemaphores.clear();
+    oldSwapChain->renderFinishedSemaphores.clear();
+    oldSwapChain->inFlightFences.clear();
+    currentFrame = oldSwapChain->currentFrame % pacing.framesInFlight;
+    return;
+  }
+
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -376,20 +421,17 @@ VkSurfaceFormatKHR VKSwapChain::chooseSwapSurfaceFormat(
 
 VkPresentModeKHR VKSwapChain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
-  for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout << "Present mode: Mailbox" << std::endl;
-      return availablePresentMode;
+  for (VkPresentModeKHR wanted : pacing.presentModes) {
+    if (wanted == VK_PRESENT_MODE_FIFO_KHR) break;
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), wanted) ==
+        availablePresentModes.end()) {
+      continue;
     }
+    std::cout << "Present mode: "
+              << (wanted == VK_PRESENT_MODE_MAILBOX_KHR ? "Mailbox" : "Immediate") << std::endl;
+    return wanted;
   }
 
-  // for (const auto &availablePresentMode : availablePresentModes) {
-  //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-  //     std::cout << "Present mode: Immediate" << std::endl;
-  //     return availablePresentMode;
-  //   }
-  // }
-
   std::cout << "Present mode: V-Sync" << std::endl;
   return VK_PRESENT_MODE_FIFO_KHR;
 }
@@ -9,15 +9,29 @@
 #include <memory>
 #include <vector>
 
+// How the swap chain paces frames, see VKFramePacer
+struct SwapChainPacing {
+  // At most VKSwapChain::MAX_FRAMES_IN_FLIGHT
+  uint32_t framesInFlight = 2;
+  // Tried in order; FIFO is always supported and is the fallback
+  std::vector<VkPresentModeKHR> presentModes{VK_PRESENT_MODE_MAILBOX_KHR};
+};
+
 class VKSwapChain {
  public:
-  static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-  VKSwapChain(VKDeviceManager& deviceRef, VkExtent2D windowExtent);
+  // Per-frame resources everywhere are sized for this many frames; the
+  // renderer may cycle through fewer of them (SwapChainPacing)
+  static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+  VKSwapChain(VKDeviceManager& deviceRef, VkExtent2D windowExtent, const SwapChainPacing& pacing = {});
+  // Retires previous (oldSwapchain) and takes over its fences and
+  // semaphores, so frames in flight on it need not be waited for here;
+  // previous itself must stay alive until they complete
   VKSwapChain(
       VKDeviceManager &deviceRef,
       VkExtent2D windowExtent,
-      std::shared_ptr<VKSwapChain> previous
+      std::shared_ptr<VKSwapChain> previous,
+      const SwapChainPacing& pacing = {}
   );
 
   ~VKSwapChain();
@@ -39,6 +53,9 @@ class VKSwapChain {
   }
   VkFormat findDepthFormat();
 
+  // Blocks until the next frame slot's previous submission has finished;
+  // acquireNextImage then doesn't wait on it again
+  void waitForFrameSlot();
   VkResult acquireNextImage(uint32_t *imageIndex);
   VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
 
@@ -71,7 +88,7 @@ class VKSwapChain {
   VkRenderPass renderPass;
 
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
+  std::vector<VKAllocation> depthImageMemorys;
   std::vector<VkImageView> depthImageViews;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
@@ -81,6 +98,7 @@ class VKSwapChain {
 
   VkSwapchainKHR swapChain;
   std::shared_ptr<VKSwapChain> oldSwapChain;
+  SwapChainPacing pacing;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
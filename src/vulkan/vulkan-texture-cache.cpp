@@ -0,0 +1,210 @@
+#include "vulkan-texture-cache.hpp"
+
+#include "utils/file_cache.h"
+
+// std
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#ifndef TEXTURE_CACHE_DIR
+#define TEXTURE_CACHE_DIR "../cache/textures/"
+#endif
+
+namespace {
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t sourceHash;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+  uint32_t format;
+  uint64_t dataSize;
+};
+
+constexpr uint32_t MAGIC = 0x58544C48;  // "HLTX"
+constexpr uint32_t VERSION = 1;
+
+bool isSrgb(VkFormat format) {
+  return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+const std::array<float, 256>& srgbToLinearTable() {
+  static const std::array<float, 256> table = [] {
+    std::array<float, 256> values{};
+    for (int i = 0; i < 256; i++) {
+      float c = i / 255.f;
+      values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return values;
+  }();
+  return table;
+}
+
+uint8_t linearToSrgb(float c) {
+  c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+  return static_cast<uint8_t>(std::lround(std::clamp(c, 0.f, 1.f) * 255.f));
+}
+
+// Rows [rowBegin, rowEnd) of the level below src; odd edges reuse the last
+// texel
+void downsampleRows(
+    const uint8_t* src,
+    uint32_t srcWidth,
+    uint32_t srcHeight,
+    uint8_t* dst,
+    uint32_t dstWidth,
+    uint32_t rowBegin,
+    uint32_t rowEnd,
+    bool srgb
+) {
+  const std::array<float, 256>& toLinear = srgbToLinearTable();
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint32_t y0 = std::min(2 * y, srcHeight - 1);
+    const uint32_t y1 = std::min(2 * y + 1, srcHeight - 1);
+    for (uint32_t x = 0; x < dstWidth; x++) {
+      const uint32_t x0 = std::min(2 * x, srcWidth - 1);
+      const uint32_t x1 = std::min(2 * x + 1, srcWidth - 1);
+      const uint8_t* taps[4] = {
+          src + (size_t(y0) * srcWidth + x0) * 4,
+          src + (size_t(y0) * srcWidth + x1) * 4,
+          src + (size_t(y1) * srcWidth + x0) * 4,
+          src + (size_t(y1) * srcWidth + x1) * 4};
+      uint8_t* out = dst + (size_t(y) * dstWidth + x) * 4;
+      for (int c = 0; c < 4; c++) {
+        // Alpha is stored linearly even in sRGB formats
+        if (srgb && c < 3) {
+          float sum = toLinear[taps[0][c]] + toLinear[taps[1][c]] + toLinear[taps[2][c]] + toLinear[taps[3][c]];
+          out[c] = linearToSrgb(sum * 0.25f);
+        } else {
+          uint32_t sum = taps[0][c] + taps[1][c] + taps[2][c] + taps[3][c];
+          out[c] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+      }
+    }
+  }
+}
+
+std::string cacheFilePath(const std::string& sourcePath) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.tex",
+      static_cast<unsigned long long>(hashBytes(sourcePath.data(), sourcePath.size())));
+  return std::string(TEXTURE_CACHE_DIR) + name;
+}
+
+}  // namespace
+
+VkDeviceSize TextureMips::levelOffset(uint32_t level) const {
+  VkDeviceSize offset = 0;
+  for (uint32_t i = 0; i < level; i++) {
+    offset += VkDeviceSize(levelWidth(i)) * levelHeight(i) * 4;
+  }
+  return offset;
+}
+
+TextureMips buildTextureMips(
+    const void* rgba,
+    uint32_t width,
+    uint32_t height,
+    VkFormat format,
+    uint32_t maxLevels
+) {
+  TextureMips mips{};
+  mips.width = width;
+  mips.height = height;
+  mips.format = format;
+  uint32_t fullChain = 1;
+  while ((std::max(width, height) >> fullChain) > 0) {
+    fullChain++;
+  }
+  mips.levelCount = std::clamp(maxLevels, 1u, fullChain);
+  mips.texels.resize(mips.levelOffset(mips.levelCount));
+  std::copy_n(static_cast<const uint8_t*>(rgba), size_t(width) * height * 4, mips.texels.begin());
+
+  const bool srgb = isSrgb(format);
+  const uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  for (uint32_t level = 1; level < mips.levelCount; level++) {
+    const uint8_t* src = mips.texels.data() + mips.levelOffset(level - 1);
+    uint8_t* dst = mips.texels.data() + mips.levelOffset(level);
+    const uint32_t srcWidth = mips.levelWidth(level - 1);
+    const uint32_t srcHeight = mips.levelHeight(level - 1);
+    const uint32_t dstWidth = mips.levelWidth(level);
+    const uint32_t dstHeight = mips.levelHeight(level);
+
+    // Small levels aren't worth a thread each
+    const uint32_t workers = std::min(threadCount, std::max(dstHeight / 32, 1u));
+    if (workers == 1) {
+      downsampleRows(src, srcWidth, srcHeight, dst, dstWidth, 0, dstHeight, srgb);
+      continue;
+    }
+    std::vector<std::thread> threads;
+    const uint32_t rowsPerWorker = (dstHeight + workers - 1) / workers;
+    for (uint32_t i = 0; i < workers; i++) {
+      uint32_t rowBegin = i * rowsPerWorker;
+      uint32_t rowEnd = std::min(rowBegin + rowsPerWorker, dstHeight);
+      threads.emplace_back(downsampleRows, src, srcWidth, srcHeight, dst, dstWidth, rowBegin, rowEnd, srgb);
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+  return mips;
+}
+
+uint64_t hashTextureSource(const std::vector<char>& bytes) {
+  return bytes.empty() ? 0 : hashBytes(bytes.data(), bytes.size());
+}
+
+bool loadTextureCache(const std::string& sourcePath, uint64_t sourceHash, TextureMips& mips) {
+  const std::string path = cacheFilePath(sourcePath);
+  std::ifstream file{path, std::ios::binary};
+  if (!file.is_open()) {
+    return false;
+  }
+  FileHeader header{};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != MAGIC || header.version != VERSION || header.sourceHash != sourceHash) {
+    return false;
+  }
+
+  TextureMips cached{};
+  cached.width = header.width;
+  cached.height = header.height;
+  cached.levelCount = header.levelCount;
+  cached.format = static_cast<VkFormat>(header.format);
+  // No checksum over the texels: hashing them would cost about what the
+  // cache saves, so only the size is checked
+  if (cached.levelCount == 0 || cached.levelCount > 32 ||
+      header.dataSize != cached.levelOffset(cached.levelCount)) {
+    std::cout << "texture cache: " << path << " is corrupt" << std::endl;
+    return false;
+  }
+  cached.texels.resize(header.dataSize);
+  if (!file.read(reinterpret_cast<char*>(cached.texels.data()), cached.texels.size())) {
+    std::cout << "texture cache: " << path << " is truncated" << std::endl;
+    return false;
+  }
+  mips = std::move(cached);
+  return true;
+}
+
+void saveTextureCache(const std::string& sourcePath, uint64_t sourceHash, const TextureMips& mips) {
+  FileHeader header{};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.sourceHash = sourceHash;
+  header.width = mips.width;
+  header.height = mips.height;
+  header.levelCount = mips.levelCount;
+  header.format = static_cast<uint32_t>(mips.format);
+  header.dataSize = mips.texels.size();
+
+  writeFileAtomically("texture cache", cacheFilePath(sourcePath), header,
+      {{mips.texels.data(), mips.texels.size()}});
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decoded texels of one texture with its full mip chain, RGBA8, every level
+// tightly packed after the previous one (largest first) so the whole thing
+// is one upload.
+struct TextureMips {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t levelCount = 0;
+  VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+  std::vector<uint8_t> texels;
+
+  uint32_t levelWidth(uint32_t level) const { return std::max(width >> level, 1u); }
+  uint32_t levelHeight(uint32_t level) const { return std::max(height >> level, 1u); }
+  VkDeviceSize levelOffset(uint32_t level) const;
+};
+
+// Box-filters rgba down to 1x1, or to maxLevels levels, spreading the rows
+// of each level over the hardware threads. sRGB formats are averaged in
+// linear space so distant textures don't darken.
+TextureMips buildTextureMips(
+    const void* rgba,
+    uint32_t width,
+    uint32_t height,
+    VkFormat format,
+    uint32_t maxLevels = UINT32_MAX);
+
+// FNV-1a of the source file's bytes; what the cache is keyed on
+uint64_t hashTextureSource(const std::vector<char>& bytes);
+
+// Decoded, mipped textures cached on disk (TEXTURE_CACHE_DIR, one file per
+// source path) so later runs skip the PNG decode and the filtering. load
+// fails for a missing or truncated file or one made from other bytes.
+bool loadTextureCache(const std::string& sourcePath, uint64_t sourceHash, TextureMips& mips);
+void saveTextureCache(const std::string& sourcePath, uint64_t sourceHash, const TextureMips& mips);
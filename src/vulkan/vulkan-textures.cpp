@@ -0,0 +1,223 @@
+#include "vulkan-textures.hpp"
+#include "vulkan-upload.hpp"
+
+// libs
+#include <extern/stb_image.h>
+
+// std
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+VKTextureRegistry::VKTextureRegistry(VKDeviceManager& device) : m_device(device) {
+  VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+  indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &indexingProperties;
+  vkGetPhysicalDeviceProperties2(m_device.getPhysicalDevice(), &properties);
+
+  m_capacity = std::min({
+      MAX_BINDLESS_TEXTURES,
+      indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+      indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+  createSampler();
+  createDescriptors();
+}
+
+VKTextureRegistry::~VKTextureRegistry() {
+  for (Texture& texture : m_textures) {
+    vkDestroyImageView(m_device.device(), texture.view, nullptr);
+    vkDestroyImage(m_device.device(), texture.image, nullptr);
+    m_device.allocator().free(texture.memory);
+  }
+  vkDestroySampler(m_device.device(), m_sampler, nullptr);
+}
+
+void VKTextureRegistry::createSampler() {
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+
+  samplerInfo.anisotropyEnable = VK_TRUE;
+  samplerInfo.maxAnisotropy = m_device.properties.limits.maxSamplerAnisotropy;
+
+  samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(m_device.device(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture sampler!");
+  }
+}
+
+void VKTextureRegistry::createDescriptors() {
+  m_setLayout =
+      VK_DSL_Mgr::Builder(m_device)
+          .addBinding(
+              TEXTURE_BINDING,
+              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+              VK_SHADER_STAGE_FRAGMENT_BIT,
+              m_capacity,
+              VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                  VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                  VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT)
+          .build();
+
+  m_pool =
+      VK_DP_Mgr::Builder(m_device)
+          .setMaxSets(1)
+          .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_capacity)
+          .build();
+
+  if (!m_pool->allocateDescriptor(m_setLayout->getDescriptorSetLayout(), m_descriptorSet)) {
+    throw std::runtime_error("failed to allocate bindless texture descriptor set!");
+  }
+}
+
+uint32_t VKTextureRegistry::loadTexture(const std::string& filepath) {
+  auto it = m_indexByPath.find(filepath);
+  if (it != m_indexByPath.end()) {
+    return it->second;
+  }
+
+  if (m_textures.size() >= m_capacity) {
+    throw std::runtime_error("bindless texture array is full!");
+  }
+  return registerTexture(filepath, createTexture(decodeTexture(filepath)));
+}
+
+uint32_t VKTextureRegistry::addTexture(
+    const std::string& name,
+    const void* rgba,
+    uint32_t width,
+    uint32_t height,
+    VkFormat format,
+    uint32_t mipLevels
+) {
+  auto it = m_indexByPath.find(name);
+  if (it != m_indexByPath.end()) {
+    return it->second;
+  }
+  return addTexture(name, buildTextureMips(rgba, width, height, format, mipLevels));
+}
+
+uint32_t VKTextureRegistry::addTexture(const std::string& name, const TextureMips& mips) {
+  auto it = m_indexByPath.find(name);
+  if (it != m_indexByPath.end()) {
+    return it->second;
+  }
+
+  if (m_textures.size() >= m_capacity) {
+    throw std::runtime_error("bindless texture array is full!");
+  }
+  return registerTexture(name, createTexture(mips));
+}
+
+uint32_t VKTextureRegistry::registerTexture(const std::string& key, Texture texture) {
+  uint32_t index = static_cast<uint32_t>(m_textures.size());
+  m_textures.push_back(texture);
+  m_indexByPath.emplace(key, index);
+  writeDescriptor(index);
+
+  return index;
+}
+
+TextureMips VKTextureRegistry::decodeTexture(const std::string& filepath) {
+  std::ifstream file{filepath, std::ios::binary};
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to load texture image: " + filepath);
+  }
+  std::vector<char> bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  const uint64_t hash = hashTextureSource(bytes);
+
+  TextureMips mips{};
+  if (!loadTextureCache(filepath, hash, mips)) {
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load_from_memory(
+        reinterpret_cast<const stbi_uc*>(bytes.data()),
+        static_cast<int>(bytes.size()),
+        &texWidth,
+        &texHeight,
+        &texChannels,
+        STBI_rgb_alpha);
+    if (!pixels) {
+      throw std::runtime_error("failed to load texture image: " + filepath);
+    }
+    mips = buildTextureMips(
+        pixels,
+        static_cast<uint32_t>(texWidth),
+        static_cast<uint32_t>(texHeight),
+        VK_FORMAT_R8G8B8A8_SRGB);
+    stbi_image_free(pixels);
+    saveTextureCache(filepath, hash, mips);
+  }
+  return mips;
+}
+
+VKTextureRegistry::Texture VKTextureRegistry::createTexture(const TextureMips& mips) {
+  Texture texture{};
+  texture.width = mips.width;
+  texture.height = mips.height;
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = texture.width;
+  imageInfo.extent.height = texture.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = mips.levelCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = mips.format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  m_device.createImageWithInfo(
+      imageInfo,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      texture.image,
+      texture.memory);
+
+  // Every level in one copy; lands before the next frame that could sample it
+  m_device.uploads().uploadImage(
+      texture.image,
+      mips.texels.data(),
+      mips.texels.size(),
+      texture.width,
+      texture.height,
+      mips.levelCount);
+
+  texture.view = m_device.createImageView(texture.image, mips.format, mips.levelCount);
+  return texture;
+}
+
+void VKTextureRegistry::writeDescriptor(uint32_t index) {
+  VkDescriptorImageInfo imageInfo{
+      m_sampler,
+      m_textures[index].view,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+  };
+
+  VKDescriptorWriter(*m_setLayout, *m_pool)
+      .writeImages(TEXTURE_BINDING, &imageInfo, 1, index)
+      .overwrite(m_descriptorSet);
+}
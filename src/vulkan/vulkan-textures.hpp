@@ -0,0 +1,86 @@
+#pragma once
+
+#include "vulkan-descriptors.hpp"
+#include "vulkan-device.hpp"
+#include "vulkan-texture-cache.hpp"
+
+// std
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Owns every sampled texture and exposes them to shaders as one bindless
+// array (set 1, binding 0: `uniform sampler2D textures[]`).
+//
+// Textures are deduplicated by path and all share a single trilinear,
+// anisotropic sampler. Files get a full mip chain, decoded and filtered once
+// and then read back from the texture cache (see vulkan-texture-cache.hpp).
+// New textures are written straight into the (update-after-bind, partially
+// bound) descriptor set, so nothing else has to change when a texture is
+// added.
+class VKTextureRegistry {
+ public:
+  static constexpr uint32_t TEXTURE_SET = 1;
+  static constexpr uint32_t TEXTURE_BINDING = 0;
+  // Upper bound on the array size, clamped further by the device limits
+  static constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+
+  VKTextureRegistry(VKDeviceManager& device);
+  ~VKTextureRegistry();
+
+  VKTextureRegistry(const VKTextureRegistry &) = delete;
+  VKTextureRegistry &operator=(const VKTextureRegistry &) = delete;
+
+  // Returns the index to use in the shader; loading the same path twice
+  // returns the same index
+  uint32_t loadTexture(const std::string& filepath);
+  // Same for RGBA8 texels made at runtime (e.g. a baked atlas); name takes
+  // the place of the path. Up to mipLevels levels are filtered on the CPU.
+  uint32_t addTexture(
+      const std::string& name,
+      const void* rgba,
+      uint32_t width,
+      uint32_t height,
+      VkFormat format = VK_FORMAT_R8G8B8A8_SRGB,
+      uint32_t mipLevels = 1);
+
+  // A texture decoded ahead of time (see decodeTexture), registered under
+  // the path it came from so loadTexture finds it
+  uint32_t addTexture(const std::string& name, const TextureMips& mips);
+
+  // Reads filepath (or its cache entry) into texels with a full mip chain.
+  // Touches no Vulkan state, so any thread may call it.
+  static TextureMips decodeTexture(const std::string& filepath);
+
+  uint32_t getTextureCount() const { return static_cast<uint32_t>(m_textures.size()); }
+  uint32_t getCapacity() const { return m_capacity; }
+  VkDescriptorSetLayout getDescriptorSetLayout() const { return m_setLayout->getDescriptorSetLayout(); }
+  VkDescriptorSet getDescriptorSet() const { return m_descriptorSet; }
+
+ private:
+  struct Texture {
+    VkImage image = VK_NULL_HANDLE;
+    VKAllocation memory;
+    VkImageView view = VK_NULL_HANDLE;
+    uint32_t width = 0;
+    uint32_t height = 0;
+  };
+
+  void createSampler();
+  void createDescriptors();
+  Texture createTexture(const TextureMips& mips);
+  uint32_t registerTexture(const std::string& key, Texture texture);
+  void writeDescriptor(uint32_t index);
+
+  VKDeviceManager& m_device;
+
+  uint32_t m_capacity = 0;
+  VkSampler m_sampler = VK_NULL_HANDLE;
+  std::vector<Texture> m_textures;
+  std::unordered_map<std::string, uint32_t> m_indexByPath;
+
+  std::unique_ptr<VK_DSL_Mgr> m_setLayout;
+  std::unique_ptr<VK_DP_Mgr> m_pool;
+  VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+};
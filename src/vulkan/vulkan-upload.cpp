@@ -0,0 +1,354 @@
+#include "vulkan-upload.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+VKUploadManager::VKUploadManager(VKDeviceManager& device) : m_device(device) {
+  QueueFamilyIndices indices = m_device.findPhysicalQueueFamilies();
+  m_queue = m_device.transferQueue();
+  m_dedicatedQueue = indices.transferFamily != indices.graphicsFamily;
+
+  createCommandPool();
+  createTimeline();
+
+  m_alignment = std::max<VkDeviceSize>(
+      16, m_device.properties.limits.optimalBufferCopyOffsetAlignment);
+
+  m_ring = std::make_unique<VKBufferMgr>(
+      m_device,
+      1,
+      static_cast<uint32_t>(RING_SIZE),
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_ring->map();
+}
+
+VKUploadManager::~VKUploadManager() {
+  waitIdle();
+  for (Batch& batch : m_batches) {
+    batch.oversized.clear();
+  }
+  m_ring.reset();
+  vkDestroySemaphore(m_device.device(), m_timeline, nullptr);
+  vkDestroyCommandPool(m_device.device(), m_commandPool, nullptr);
+}
+
+void VKUploadManager::createCommandPool() {
+  QueueFamilyIndices indices = m_device.findPhysicalQueueFamilies();
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = indices.transferFamily;
+  poolInfo.flags =
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if (vkCreateCommandPool(m_device.device(), &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload command pool!");
+  }
+
+  std::array<VkCommandBuffer, MAX_BATCHES_IN_FLIGHT> commandBuffers;
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = m_commandPool;
+  allocInfo.commandBufferCount = MAX_BATCHES_IN_FLIGHT;
+
+  if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate upload command buffers!");
+  }
+  for (uint32_t i = 0; i < MAX_BATCHES_IN_FLIGHT; i++) {
+    m_batches[i].commandBuffer = commandBuffers[i];
+  }
+}
+
+void VKUploadManager::createTimeline() {
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(m_device.device(), &semaphoreInfo, nullptr, &m_timeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload timeline semaphore!");
+  }
+}
+
+VKUploadManager::Batch& VKUploadManager::currentBatch() {
+  Batch& batch = m_batches[m_currentBatch];
+  if (batch.recording) {
+    return batch;
+  }
+
+  // The slot is being reused; make sure its previous submission has landed
+  if (batch.ticket != 0) {
+    wait(batch.ticket);
+  }
+  retireCompleted();
+
+  vkResetCommandBuffer(batch.commandBuffer, 0);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin upload command buffer!");
+  }
+  batch.recording = true;
+  return batch;
+}
+
+void VKUploadManager::retireCompleted() {
+  uint64_t completed = 0;
+  vkGetSemaphoreCounterValue(m_device.device(), m_timeline, &completed);
+
+  // Slots are used round-robin, so the oldest submission sits in the current slot
+  for (uint32_t i = 0; i < MAX_BATCHES_IN_FLIGHT; i++) {
+    Batch& batch = m_batches[(m_currentBatch + i) % MAX_BATCHES_IN_FLIGHT];
+    if (batch.recording || batch.ticket == 0) {
+      continue;
+    }
+    if (batch.ticket > completed) {
+      break;
+    }
+    m_tail = batch.ringEnd;
+    batch.ticket = 0;
+    batch.oversized.clear();
+  }
+
+  if (m_head == m_tail) {
+    m_head = m_tail = 0;
+  }
+}
+
+void VKUploadManager::waitForOldest() {
+  for (uint32_t i = 0; i < MAX_BATCHES_IN_FLIGHT; i++) {
+    Batch& batch = m_batches[(m_currentBatch + i) % MAX_BATCHES_IN_FLIGHT];
+    if (!batch.recording && batch.ticket != 0) {
+      wait(batch.ticket);
+      break;
+    }
+  }
+  retireCompleted();
+}
+
+bool VKUploadManager::tryAllocate(VkDeviceSize size, VkDeviceSize& offset) {
+  VkDeviceSize aligned = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+
+  if (m_head >= m_tail) {
+    // Free space is [head, end) followed by [0, tail)
+    if (aligned + size <= RING_SIZE) {
+      offset = aligned;
+      m_head = aligned + size;
+      return true;
+    }
+    if (size < m_tail) {
+      offset = 0;
+      m_head = size;
+      return true;
+    }
+    return false;
+  }
+
+  if (aligned + size < m_tail) {
+    offset = aligned;
+    m_head = aligned + size;
+    return true;
+  }
+  return false;
+}
+
+void* VKUploadManager::stage(VkDeviceSize size, VkBuffer& srcBuffer, VkDeviceSize& srcOffset) {
+  if (size + m_alignment >= RING_SIZE) {
+    auto staging = std::make_unique<VKBufferMgr>(
+        m_device,
+        size,
+        1,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    staging->map();
+    void* mapped = staging->getMappedMemory();
+    srcBuffer = staging->getBuffer();
+    srcOffset = 0;
+    currentBatch().oversized.push_back(std::move(staging));
+    return mapped;
+  }
+
+  currentBatch();
+  while (!tryAllocate(size, srcOffset)) {
+    bool inFlight = std::any_of(m_batches.begin(), m_batches.end(), [](const Batch& batch) {
+      return batch.ticket != 0;
+    });
+    if (inFlight) {
+      waitForOldest();
+    } else {
+      // The ring is full of our own unsubmitted copies
+      flush();
+      currentBatch();
+    }
+  }
+
+  srcBuffer = m_ring->getBuffer();
+  return static_cast<char*>(m_ring->getMappedMemory()) + srcOffset;
+}
+
+void VKUploadManager::uploadBuffer(
+    VkBuffer dst,
+    const void* data,
+    VkDeviceSize size,
+    VkDeviceSize dstOffset
+) {
+  VkBuffer srcBuffer;
+  VkDeviceSize srcOffset;
+  void* staged = stage(size, srcBuffer, srcOffset);
+  memcpy(staged, data, size);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = srcOffset;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(currentBatch().commandBuffer, srcBuffer, dst, 1, &copyRegion);
+}
+
+void VKUploadManager::uploadImage(
+    VkImage dst,
+    const void* pixels,
+    VkDeviceSize size,
+    uint32_t width,
+    uint32_t height,
+    uint32_t mipLevels
+) {
+  VkBuffer srcBuffer;
+  VkDeviceSize srcOffset;
+  void* staged = stage(size, srcBuffer, srcOffset);
+  memcpy(staged, pixels, size);
+
+  VkCommandBuffer commandBuffer = currentBatch().commandBuffer;
+
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = dst;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = mipLevels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      1, &barrier);
+
+  // One region per level; 4-byte texels keep every level's offset aligned
+  std::vector<VkBufferImageCopy> regions(mipLevels);
+  VkDeviceSize levelOffset = srcOffset;
+  for (uint32_t level = 0; level < mipLevels; level++) {
+    uint32_t levelWidth = std::max(width >> level, 1u);
+    uint32_t levelHeight = std::max(height >> level, 1u);
+    VkBufferImageCopy& region = regions[level];
+    region.bufferOffset = levelOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {levelWidth, levelHeight, 1};
+    levelOffset += VkDeviceSize(levelWidth) * levelHeight * 4;
+  }
+
+  vkCmdCopyBufferToImage(
+      commandBuffer,
+      srcBuffer,
+      dst,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      static_cast<uint32_t>(regions.size()),
+      regions.data());
+
+  // The transfer queue can't name fragment shader stages, so the final
+  // transition only orders against the copy; the graphics submit's wait on
+  // the timeline semaphore makes the texels visible to the shaders
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = 0;
+
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      1, &barrier);
+}
+
+uint64_t VKUploadManager::flush() {
+  Batch& batch = m_batches[m_currentBatch];
+  if (!batch.recording) {
+    return m_lastSubmitted;
+  }
+
+  if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record upload command buffer!");
+  }
+
+  uint64_t ticket = m_lastSubmitted + 1;
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &ticket;
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &m_timeline;
+
+  if (vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload batch!");
+  }
+
+  m_lastSubmitted = ticket;
+  batch.recording = false;
+  batch.ticket = ticket;
+  batch.ringEnd = m_head;
+  m_currentBatch = (m_currentBatch + 1) % MAX_BATCHES_IN_FLIGHT;
+  return ticket;
+}
+
+bool VKUploadManager::isComplete(uint64_t ticket) {
+  uint64_t completed = 0;
+  vkGetSemaphoreCounterValue(m_device.device(), m_timeline, &completed);
+  return completed >= ticket;
+}
+
+void VKUploadManager::wait(uint64_t ticket) {
+  if (ticket == 0) {
+    return;
+  }
+
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &m_timeline;
+  waitInfo.pValues = &ticket;
+  vkWaitSemaphores(m_device.device(), &waitInfo, UINT64_MAX);
+}
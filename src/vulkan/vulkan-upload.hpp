@@ -0,0 +1,90 @@
+#pragma once
+
+#include "vulkan-buffer.hpp"
+#include "vulkan-device.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+// Streams buffer and image data to device-local memory without stalling.
+//
+// Source data is copied into a persistently mapped staging ring and the copy
+// commands are batched into one command buffer, which is submitted on the
+// dedicated transfer queue when the device has one. Every batch signals a
+// timeline semaphore value (its "ticket"); the swapchain makes each frame's
+// submission wait on the latest ticket, so freshly uploaded resources can be
+// used straight away without the host ever idling a queue.
+class VKUploadManager {
+ public:
+  static constexpr VkDeviceSize RING_SIZE = 32ull * 1024 * 1024;
+  static constexpr uint32_t MAX_BATCHES_IN_FLIGHT = 4;
+
+  VKUploadManager(VKDeviceManager& device);
+  ~VKUploadManager();
+
+  VKUploadManager(const VKUploadManager &) = delete;
+  VKUploadManager &operator=(const VKUploadManager &) = delete;
+
+  // Queue a copy into dst; data may be freed as soon as this returns
+  void uploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+  // Queue a copy of tightly packed RGBA8 texels into a colour image, leaving
+  // it in SHADER_READ_ONLY_OPTIMAL. With mipLevels > 1, pixels holds every
+  // level back to back, largest first (see TextureMips).
+  void uploadImage(
+      VkImage dst,
+      const void* pixels,
+      VkDeviceSize size,
+      uint32_t width,
+      uint32_t height,
+      uint32_t mipLevels = 1);
+
+  // Submit everything queued so far. Returns the ticket that will be
+  // signalled once it has landed (or the last ticket if nothing was queued)
+  uint64_t flush();
+  bool isComplete(uint64_t ticket);
+  void wait(uint64_t ticket);
+  void waitIdle() { wait(flush()); }
+
+  VkSemaphore getTimelineSemaphore() const { return m_timeline; }
+  uint64_t getLastSubmitted() const { return m_lastSubmitted; }
+
+ private:
+  struct Batch {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // 0 while recording or idle
+    uint64_t ticket = 0;
+    bool recording = false;
+    VkDeviceSize ringEnd = 0;
+    // Staging buffers for uploads too large for the ring, freed on retire
+    std::vector<std::unique_ptr<VKBufferMgr>> oversized;
+  };
+
+  void createCommandPool();
+  void createTimeline();
+  Batch& currentBatch();
+  void retireCompleted();
+  void waitForOldest();
+  // Returns a pointer into the ring and the buffer/offset to copy from
+  void* stage(VkDeviceSize size, VkBuffer& srcBuffer, VkDeviceSize& srcOffset);
+  bool tryAllocate(VkDeviceSize size, VkDeviceSize& offset);
+
+  VKDeviceManager& m_device;
+  VkQueue m_queue;
+  bool m_dedicatedQueue;
+
+  VkCommandPool m_commandPool = VK_NULL_HANDLE;
+  VkSemaphore m_timeline = VK_NULL_HANDLE;
+  uint64_t m_lastSubmitted = 0;
+
+  std::array<Batch, MAX_BATCHES_IN_FLIGHT> m_batches;
+  uint32_t m_currentBatch = 0;
+
+  std::unique_ptr<VKBufferMgr> m_ring;
+  VkDeviceSize m_alignment;
+  // Bytes [m_tail, m_head) (wrapping) belong to unfinished batches; the
+  // ring is empty when they are equal and is never allowed to fill up
+  VkDeviceSize m_head = 0;
+  VkDeviceSize m_tail = 0;
+};
@@ -27,6 +27,7 @@ void GlfwWindow::initWindow() {
   window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
   glfwSetWindowUserPointer(window, this);
   glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+  glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 }
 
 void GlfwWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR *surface) {
@@ -41,3 +42,8 @@ void GlfwWindow::framebufferResizeCallback(GLFWwindow *window, int width, int he
   lveWindow->width = width;
   lveWindow->height = height;
 }
+
+void GlfwWindow::windowRefreshCallback(GLFWwindow *window) {
+  auto lveWindow = reinterpret_cast<GlfwWindow *>(glfwGetWindowUserPointer(window));
+  lveWindow->refreshRequested = true;
+}
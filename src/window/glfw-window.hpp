@@ -20,17 +20,22 @@ class GlfwWindow {
   VkExtent2D getExtent() { return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)}; }
   bool wasWindowResized() { return framebufferResized; }
   void resetWindowResizedFlag() { framebufferResized = false; }
+  // Set when the window system needs the contents redrawn (exposed, restored)
+  bool wasRefreshRequested() { return refreshRequested; }
+  void resetRefreshRequestedFlag() { refreshRequested = false; }
   GLFWwindow *getGLFWwindow() const { return window; }
 
   void createWindowSurface(VkInstance instance, VkSurfaceKHR *surface);
 
  private:
   static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
+  static void windowRefreshCallback(GLFWwindow *window);
   void initWindow();
 
   int width;
   int height;
   bool framebufferResized = false;
+  bool refreshRequested = false;
 
   std::string windowName;
   GLFWwindow *window;